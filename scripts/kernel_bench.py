@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Golioth, Inc.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Collect and compare the cost per call of the pipeline's computation kernels.
+
+The Ztest suite in tests/kernels checks each kernel (NMEA parsing, coordinate
+conversions, track point encoding and JSON formatting, LightDB State parsing,
+battery level) and then prints one BENCH line with its cost. On qemu_cortex_m3
+the cost is counted in CPU cycles, which QEMU makes repeatable; on native_sim it
+is timed in host nanoseconds.
+
+Run on native_sim:
+
+    west build -p -b native_sim -d build_kernels app/tests/kernels
+    app/scripts/kernel_bench.py --exe build_kernels/zephyr/zephyr.exe --json native_sim.json
+
+Or collect the console output of another board:
+
+    west build -p -b qemu_cortex_m3 -d build_kernels app/tests/kernels
+    timeout 60 west build -d build_kernels -t run | tee kernels.log
+    app/scripts/kernel_bench.py --log kernels.log --json qemu_cortex_m3.json
+
+The JSON file has sorted keys and one kernel per line, so a change in cost
+shows up in a diff. Exits with status 1 if a test fails, or with --baseline, if
+a kernel costs more than --max-regression percent over the baseline.
+"""
+
+import argparse
+import json
+import re
+import subprocess
+import sys
+
+BENCH_RE = re.compile(r"^BENCH (\{.*\})\s*$", re.M)
+DONE_RE = re.compile(r"^PROJECT EXECUTION (SUCCESSFUL|FAILED)", re.M)
+FAIL_RE = re.compile(r"^\s*FAIL - (\w+)", re.M)
+
+
+def parse(output):
+    if DONE_RE.search(output) is None:
+        raise RuntimeError("no PROJECT EXECUTION line, the test suite did not complete")
+
+    results = [json.loads(m.group(1)) for m in BENCH_RE.finditer(output)]
+    board = results[0]["board"] if results else None
+
+    return {
+        "board": board,
+        "kernels": {
+            r["kernel"]: {
+                "cycles_per_call": r["cycles_per_call"],
+                "ns_per_call": r["ns_per_call"],
+            }
+            for r in results
+        },
+        # Failed tests print no BENCH line for the kernels they check
+        "failed": FAIL_RE.findall(output),
+    }
+
+
+def cost(kernel):
+    """Cycles when counted, as they are repeatable, host nanoseconds otherwise."""
+    if kernel["cycles_per_call"] is not None:
+        return kernel["cycles_per_call"], "cycles"
+    return kernel["ns_per_call"], "ns"
+
+
+def write_json(path, results):
+    # One kernel per line, so that results diff well
+    kernels = results["kernels"]
+    lines = [
+        f'    {json.dumps(name)}: {json.dumps(kernels[name], sort_keys=True)}'
+        for name in sorted(kernels)
+    ]
+    with open(path, "w") as f:
+        f.write("{\n")
+        f.write(f'  "board": {json.dumps(results["board"])},\n')
+        f.write('  "kernels": {\n' + ",\n".join(lines) + "\n  }\n}\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--exe", help="native_sim executable of tests/kernels")
+    source.add_argument("--log", help="console output of tests/kernels on any board")
+    parser.add_argument("--json", help="write the results to this file")
+    parser.add_argument("--baseline", help="results of a previous run to compare with")
+    parser.add_argument(
+        "--max-regression",
+        type=float,
+        default=10,
+        help="percent over the baseline that fails (default: %(default)s)",
+    )
+    args = parser.parse_args()
+
+    if args.exe:
+        proc = subprocess.run([args.exe], capture_output=True, text=True, timeout=600)
+        output = proc.stdout
+    else:
+        with open(args.log, errors="replace") as f:
+            output = f.read()
+
+    results = parse(output)
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)["kernels"]
+
+    failures = [f"{test}: failed" for test in results["failed"]]
+    print(f"{'kernel':<26} {'cost':>10} {'unit':>6} {'baseline':>10} {'change':>8}")
+    for name, kernel in sorted(results["kernels"].items()):
+        value, unit = cost(kernel)
+        base = cost(baseline[name])[0] if baseline and name in baseline else None
+        change = (value - base) * 100 / base if base else None
+        print(
+            f"{name:<26} {value:>10} {unit:>6} {'-' if base is None else base:>10} "
+            f"{'-' if change is None else f'{change:+.1f}%':>8}"
+        )
+
+        if change is not None and change > args.max_regression:
+            failures.append(f"{name}: {change:+.1f}% over the baseline")
+
+    if args.json:
+        write_json(args.json, results)
+
+    for failure in failures:
+        print(failure, file=sys.stderr)
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
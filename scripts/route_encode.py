@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Golioth, Inc.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Encode a recorded drive as a route for the route replay (src/route_replay.c).
+
+The input is either an NMEA file (RMC sentences, speed in knots) or a CSV file
+with one "lat,lon,speed_kmh" waypoint per line. Waypoints closer than
+--min-distance to the previous one are dropped, keeping the first and last.
+
+A route is the Encoded Polyline Algorithm Format (precision 5, as used by
+Google Maps) extended with a third value per waypoint: the speed in km/h when
+passing it. Latitude, longitude and speed are each delta-encoded from the
+previous waypoint, so a typical waypoint takes 6 to 10 characters:
+
+    app/scripts/route_encode.py app/src/sim/drive.nmea -o app/src/routes/drive.route
+
+The output can be built into the image (CONFIG_APP_ROUTE_REPLAY_FILE) or
+passed to the route_replay RPC.
+"""
+
+import argparse
+import math
+import sys
+
+EARTH_RADIUS_M = 6371008.8
+KNOTS_TO_KMH = 1.852
+
+
+def nmea_coord(value, hemisphere):
+    if not value:
+        return None
+    degrees_len = value.index(".") - 2
+    coord = int(value[:degrees_len]) + float(value[degrees_len:]) / 60
+    return -coord if hemisphere in ("S", "W") else coord
+
+
+def read_nmea(lines):
+    for line in lines:
+        fields = line.strip().split("*")[0].split(",")
+        if len(fields) < 8 or not fields[0].endswith("RMC") or fields[2] != "A":
+            continue
+        lat = nmea_coord(fields[3], fields[4])
+        lon = nmea_coord(fields[5], fields[6])
+        if lat is None or lon is None:
+            continue
+        speed = float(fields[7] or 0) * KNOTS_TO_KMH
+        yield lat, lon, speed
+
+
+def read_csv(lines):
+    for line in lines:
+        line = line.strip()
+        if not line or line.startswith("#"):
+            continue
+        lat, lon, speed = (float(v) for v in line.split(",")[:3])
+        yield lat, lon, speed
+
+
+def distance_m(a, b):
+    phi1 = math.radians(a[0])
+    phi2 = math.radians(b[0])
+    dphi = phi2 - phi1
+    dlambda = math.radians(b[1] - a[1])
+    h = math.sin(dphi / 2) ** 2 + math.cos(phi1) * math.cos(phi2) * math.sin(dlambda / 2) ** 2
+    return 2 * EARTH_RADIUS_M * math.asin(math.sqrt(min(h, 1.0)))
+
+
+def thin(waypoints, min_distance):
+    kept = []
+    for i, wp in enumerate(waypoints):
+        last = i == len(waypoints) - 1
+        if kept and distance_m(kept[-1], wp) < min_distance and not last:
+            continue
+        if kept and kept[-1][2] == 0 and wp[2] == 0:
+            # The vehicle never covers a segment between two stops, keep the first stop
+            continue
+        kept.append(wp)
+    return kept
+
+
+def encode_value(value):
+    value = ~(value << 1) if value < 0 else value << 1
+    chunks = []
+    while value >= 0x20:
+        chunks.append(chr((0x20 | (value & 0x1F)) + 63))
+        value >>= 5
+    chunks.append(chr(value + 63))
+    return "".join(chunks)
+
+
+def encode(waypoints):
+    out = []
+    prev = (0, 0, 0)
+    for lat, lon, speed in waypoints:
+        cur = (round(lat * 1e5), round(lon * 1e5), round(speed))
+        out.extend(encode_value(c - p) for c, p in zip(cur, prev))
+        prev = cur
+    return "".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="NMEA or CSV (lat,lon,speed_kmh) file")
+    parser.add_argument("-o", "--output", help="route file (default: standard output)")
+    parser.add_argument(
+        "--min-distance",
+        type=float,
+        default=25,
+        help="drop waypoints closer than this to the previous one, in meters (default: "
+        "%(default)s)",
+    )
+    parser.add_argument(
+        "--close", action="store_true", help="drive back to the first waypoint at the end"
+    )
+    args = parser.parse_args()
+
+    with open(args.input) as f:
+        lines = f.readlines()
+
+    is_nmea = any(line.startswith("$") for line in lines)
+    waypoints = list(read_nmea(lines) if is_nmea else read_csv(lines))
+    if args.close and waypoints:
+        waypoints.append(waypoints[0])
+
+    waypoints = thin(waypoints, args.min_distance)
+    if len(waypoints) < 2:
+        print("A route needs at least two waypoints", file=sys.stderr)
+        return 1
+
+    route = encode(waypoints)
+    length = sum(distance_m(a, b) for a, b in zip(waypoints, waypoints[1:]))
+
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(route + "\n")
+    else:
+        print(route)
+
+    print(
+        f"{len(waypoints)} waypoints, {length:.0f} m, {len(route)} characters",
+        file=sys.stderr,
+    )
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
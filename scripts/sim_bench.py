@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Golioth, Inc.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Benchmark the tracking pipeline on native_sim at increasing input rates.
+
+Runs a native_sim build (CONFIG_APP_SIM, see src/sim) once per NMEA replay
+speed-up, against a fresh local Golioth server (sim_cloud.py) on a network
+profile, and reports for each run:
+
+- input rate: RMC sentences replayed per second
+- throughput: track points uploaded per second, and upload bytes per second
+- drops: records lost in the device queues or uploads, and as a share of the
+  RMC sentences replayed
+- backlog: bytes still waiting in the track queue at the end of the run
+- latency: p99 of the RMC queue wait, p50/p99 of the age of track points when
+  their upload starts (capture to upload)
+
+The device runs in real time, so each run takes --duration seconds. Build
+and run:
+
+    west build -p -b native_sim app
+    app/scripts/sim_bench.py --exe build/zephyr/zephyr.exe
+
+Every RMC sentence is processed by default (GPS_DELAY_S=0). Exits with status
+1 if --max-drop-rate is given and any run drops more.
+"""
+
+import argparse
+import json
+import sys
+
+from sim_cloud import PROFILES, SimCloud, add_profile_arguments, profile_overrides, run_device
+
+DEFAULT_SETTINGS = ["GPS_DELAY_S=0"]
+
+
+def run(args, speedup):
+    cmd = [
+        args.exe,
+        f"-speedup={speedup}",
+        f"-duration={args.duration}",
+    ]
+    if args.ecu_delay_ms is not None:
+        cmd.append(f"-ecu_delay_ms={args.ecu_delay_ms}")
+
+    cloud = SimCloud(
+        profile=args.profile, settings=args.setting or DEFAULT_SETTINGS, **profile_overrides(args)
+    )
+    with cloud:
+        result, _ = run_device(cmd, cloud, args.timeout)
+
+    return result
+
+
+def summarize(result):
+    duration = max(result["duration_s"], 1)
+    uploads = result["cloud"]["uploads"]
+    latency = result.get("latency_us", {})
+    drops = sum(result["drops"].values())
+
+    def lat(stage, i):
+        # [n, mean, p50, p99, max]
+        return latency[stage][i] if stage in latency and latency[stage][0] else None
+
+    return {
+        "speedup": result["speedup"],
+        "rmc_per_s": result["rmc"] / duration,
+        "points_per_s": uploads.get("tracker", [0, 0])[0] / duration,
+        "bytes_per_s": sum(count_bytes[1] for count_bytes in uploads.values()) / duration,
+        "drops": drops,
+        "drop_rate": drops / max(result["rmc"], 1),
+        "uart_overrun_bytes": result["uart_overrun_bytes"],
+        "backlog_bytes": result["track_queue_bytes"],
+        "rmc_q_p99_us": lat("rmc_q", 3),
+        "age_p50_us": lat("age", 2),
+        "age_p99_us": lat("age", 3),
+    }
+
+
+def fmt(value, spec):
+    return "-" if value is None else format(value, spec)
+
+
+def print_table(rows):
+    header = (
+        f"{'speedup':>8} {'RMC/s':>8} {'points/s':>9} {'B/s':>8} {'drops':>7} {'drop %':>7} "
+        f"{'overrun':>8} {'backlog':>8} {'rmc_q p99':>10} {'age p50':>10} {'age p99':>10}"
+    )
+    print(header)
+    print("-" * len(header))
+    for row in rows:
+        print(
+            f"{row['speedup']:>8.2f} {row['rmc_per_s']:>8.2f} {row['points_per_s']:>9.3f} "
+            f"{row['bytes_per_s']:>8.1f} {row['drops']:>7} {row['drop_rate'] * 100:>7.2f} "
+            f"{row['uart_overrun_bytes']:>8} {row['backlog_bytes']:>8} "
+            f"{fmt(row['rmc_q_p99_us'], '>10')} {fmt(row['age_p50_us'], '>10')} "
+            f"{fmt(row['age_p99_us'], '>10')}"
+        )
+    print("Latencies in us, percentiles rounded up to a power of two")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", default="build/zephyr/zephyr.exe", help="native_sim executable")
+    parser.add_argument(
+        "--speedups",
+        default="1,2,5,10,20,50",
+        help="comma-separated NMEA replay speed-ups (default: %(default)s)",
+    )
+    parser.add_argument(
+        "--duration", type=int, default=600, help="seconds per run (default: %(default)s)"
+    )
+    parser.add_argument("--ecu-delay-ms", type=int, help="emulated ECU response time")
+    parser.add_argument(
+        "--profile", default="lte", choices=PROFILES, help="network profile (default: %(default)s)"
+    )
+    add_profile_arguments(parser)
+    parser.add_argument(
+        "--setting",
+        action="append",
+        metavar="NAME=VALUE",
+        help=f"Golioth setting, may be repeated (default: {' '.join(DEFAULT_SETTINGS)})",
+    )
+    parser.add_argument("--json", help="write the raw and summarized results to this file")
+    parser.add_argument("--max-drop-rate", type=float, help="fail if a run drops more (0-1)")
+    parser.add_argument(
+        "--timeout", type=int, help="wall-clock seconds per run (default: duration + 120)"
+    )
+    args = parser.parse_args()
+    if args.timeout is None:
+        args.timeout = args.duration + 120
+
+    results = []
+    rows = []
+    for speedup in (float(s) for s in args.speedups.split(",")):
+        result = run(args, speedup)
+        results.append(result)
+        rows.append(summarize(result))
+
+    print_table(rows)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"runs": results, "summary": rows}, f, indent=2)
+
+    if args.max_drop_rate is not None:
+        failed = [row["speedup"] for row in rows if row["drop_rate"] > args.max_drop_rate]
+        if failed:
+            print(f"Drop rate above {args.max_drop_rate} at speed-up {failed}", file=sys.stderr)
+            return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,1142 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Golioth, Inc.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Local stand-in for the Golioth cloud, for the native_sim build.
+
+A CoAP server over DTLS 1.2 PSK that speaks enough of the Golioth device API
+for the unmodified Golioth client of the native_sim build (CONFIG_APP_SIM, see
+src/sim) to run against it through the host sockets:
+
+- LightDB Stream (.s/<path>): records are counted per stream path, other
+  uploads per CoAP path
+- LightDB State (.d/<path>): set, get and observe. --lightdb values are served
+  as JSON or CBOR, as requested, and observers are notified of every change
+- Settings (.c): --setting values are sent to the device when it observes them
+- RPC (.rpc): each --rpc call is sent that many seconds after the device
+  starts observing RPCs, and its response is printed as a CLOUD_RPC line
+- Logging (logs): records are counted
+
+Every datagram goes through a network profile first: latency and jitter,
+packet loss, uplink throttling and periodic outages. The DTLS layer uses the
+system libssl through ctypes, so nothing needs to be installed.
+
+    west build -p -b native_sim app
+    app/scripts/sim_cloud.py --profile lte --setting GPS_DELAY_S=0 --rpc 30:follow:5
+    build/zephyr/zephyr.exe -speedup=10
+
+scripts/sim_bench.py and scripts/sim_soak.py start this server themselves.
+"""
+
+import argparse
+import asyncio
+import ctypes
+import ctypes.util
+import json
+import math
+import random
+import re
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+DEFAULT_PORT = 5684
+DEFAULT_PSK_ID = "sim@sim-cloud"
+DEFAULT_PSK = "sim-psk"
+
+# Round trip time and jitter in ms, loss in percent of the datagrams in each
+# direction, uplink throughput in bytes per second (0: unlimited), and an
+# outage of outage_s seconds at the end of every outage_every_s seconds
+PROFILES = {
+    "ideal": dict(latency_ms=0, jitter_ms=0, loss_pct=0, rate_bps=0, outage_every_s=0, outage_s=0),
+    "lte": dict(latency_ms=50, jitter_ms=20, loss_pct=0, rate_bps=0, outage_every_s=0, outage_s=0),
+    "lte_poor": dict(
+        latency_ms=300, jitter_ms=200, loss_pct=5, rate_bps=2000, outage_every_s=0, outage_s=0
+    ),
+    "nbiot": dict(
+        latency_ms=1500, jitter_ms=500, loss_pct=2, rate_bps=250, outage_every_s=0, outage_s=0
+    ),
+    "throttled": dict(
+        latency_ms=100, jitter_ms=20, loss_pct=0, rate_bps=200, outage_every_s=0, outage_s=0
+    ),
+    "outages": dict(
+        latency_ms=50, jitter_ms=20, loss_pct=0, rate_bps=0, outage_every_s=900, outage_s=120
+    ),
+}
+
+# Sessions silent for longer than this are forgotten, with their observations
+SESSION_IDLE_S = 600
+# Confirmable message transmission parameters of RFC 7252
+ACK_TIMEOUT_S = 2.0
+ACK_RANDOM_FACTOR = 1.5
+MAX_RETRANSMIT = 4
+EXCHANGE_LIFETIME_S = 247
+
+
+# CBOR (RFC 8949), only what the Golioth device API uses
+
+
+def cbor_encode(value):
+    def head(major, arg):
+        if arg < 24:
+            return bytes([major << 5 | arg])
+        for info, fmt in ((24, ">B"), (25, ">H"), (26, ">I"), (27, ">Q")):
+            if arg < 1 << (8 * struct.calcsize(fmt)):
+                return bytes([major << 5 | info]) + struct.pack(fmt, arg)
+        raise ValueError("integer too large")
+
+    if value is None:
+        return b"\xf6"
+    if value is True:
+        return b"\xf5"
+    if value is False:
+        return b"\xf4"
+    if isinstance(value, int):
+        return head(0, value) if value >= 0 else head(1, -1 - value)
+    if isinstance(value, float):
+        return b"\xfb" + struct.pack(">d", value)
+    if isinstance(value, str):
+        data = value.encode()
+        return head(3, len(data)) + data
+    if isinstance(value, (bytes, bytearray)):
+        return head(2, len(value)) + bytes(value)
+    if isinstance(value, (list, tuple)):
+        return head(4, len(value)) + b"".join(cbor_encode(v) for v in value)
+    if isinstance(value, dict):
+        return head(5, len(value)) + b"".join(
+            cbor_encode(k) + cbor_encode(v) for k, v in value.items()
+        )
+    raise TypeError(f"cannot encode {type(value).__name__} in CBOR")
+
+
+def cbor_decode(data):
+    def item(pos):
+        initial = data[pos]
+        major, info = initial >> 5, initial & 0x1F
+        pos += 1
+
+        if major == 7:
+            if info == 20:
+                return False, pos
+            if info == 21:
+                return True, pos
+            if info in (22, 23):
+                return None, pos
+            if info == 25:
+                return _half_to_float(struct.unpack_from(">H", data, pos)[0]), pos + 2
+            if info == 26:
+                return struct.unpack_from(">f", data, pos)[0], pos + 4
+            if info == 27:
+                return struct.unpack_from(">d", data, pos)[0], pos + 8
+            raise ValueError(f"unsupported CBOR simple value {info}")
+
+        if info < 24:
+            arg = info
+        elif info == 31:
+            arg = None
+        else:
+            size = 1 << (info - 24)
+            arg = int.from_bytes(data[pos : pos + size], "big")
+            pos += size
+
+        if major == 0:
+            return arg, pos
+        if major == 1:
+            return -1 - arg, pos
+        if major in (2, 3):
+            if arg is None:
+                chunks = []
+                while data[pos] != 0xFF:
+                    chunk, pos = item(pos)
+                    chunks.append(chunk)
+                pos += 1
+                return ("" if major == 3 else b"").join(chunks), pos
+            raw = bytes(data[pos : pos + arg])
+            return (raw.decode() if major == 3 else raw), pos + arg
+        if major == 4:
+            values = []
+            while (arg is None and data[pos] != 0xFF) or (arg is not None and len(values) < arg):
+                value, pos = item(pos)
+                values.append(value)
+            return values, pos + (1 if arg is None else 0)
+        if major == 5:
+            values = {}
+            while (arg is None and data[pos] != 0xFF) or (arg is not None and len(values) < arg):
+                key, pos = item(pos)
+                values[key], pos = item(pos)
+            return values, pos + (1 if arg is None else 0)
+        if major == 6:
+            # Tags are dropped, the tagged item is kept
+            return item(pos)
+        raise ValueError(f"unsupported CBOR major type {major}")
+
+    value, _ = item(0)
+    return value
+
+
+def _half_to_float(half):
+    exp = (half >> 10) & 0x1F
+    mant = half & 0x3FF
+    if exp == 0:
+        value = mant * 2**-24
+    elif exp == 31:
+        value = math.inf if mant == 0 else math.nan
+    else:
+        value = (mant + 1024) * 2 ** (exp - 25)
+    return -value if half & 0x8000 else value
+
+
+def json_safe(value):
+    """CBOR decoded value in a form json.dumps() takes, byte strings in hex."""
+    if isinstance(value, (bytes, bytearray)):
+        return value.hex()
+    if isinstance(value, list):
+        return [json_safe(v) for v in value]
+    if isinstance(value, dict):
+        return {str(k): json_safe(v) for k, v in value.items()}
+    return value
+
+
+# CoAP (RFC 7252, 7641 and 7959)
+
+CON, NON, ACK, RST = range(4)
+
+GET, POST, PUT, DELETE = 1, 2, 3, 4
+CREATED, DELETED, CHANGED, CONTENT, CONTINUE = 65, 66, 68, 69, 95
+BAD_REQUEST, NOT_FOUND, METHOD_NOT_ALLOWED, UNSUPPORTED_FORMAT = 128, 132, 133, 143
+
+OPT_OBSERVE = 6
+OPT_URI_PATH = 11
+OPT_CONTENT_FORMAT = 12
+OPT_ACCEPT = 17
+OPT_BLOCK1 = 27
+
+FORMAT_JSON = 50
+FORMAT_CBOR = 60
+
+
+def uint_option(value):
+    return value.to_bytes((value.bit_length() + 7) // 8, "big")
+
+
+class Message:
+    def __init__(self, mtype, code, mid, token=b"", options=None, payload=b""):
+        self.mtype = mtype
+        self.code = code
+        self.mid = mid
+        self.token = token
+        self.options = options or []
+        self.payload = payload
+
+    @classmethod
+    def decode(cls, data):
+        if len(data) < 4 or data[0] >> 6 != 1:
+            raise ValueError("not a CoAP message")
+        mtype = (data[0] >> 4) & 0x3
+        tkl = data[0] & 0xF
+        code = data[1]
+        mid = struct.unpack_from(">H", data, 2)[0]
+        token = bytes(data[4 : 4 + tkl])
+        pos = 4 + tkl
+        number = 0
+        options = []
+        payload = b""
+
+        while pos < len(data):
+            if data[pos] == 0xFF:
+                payload = bytes(data[pos + 1 :])
+                break
+            delta, length = data[pos] >> 4, data[pos] & 0xF
+            pos += 1
+            values = []
+            for nibble in (delta, length):
+                if nibble == 13:
+                    values.append(data[pos] + 13)
+                    pos += 1
+                elif nibble == 14:
+                    values.append(struct.unpack_from(">H", data, pos)[0] + 269)
+                    pos += 2
+                elif nibble == 15:
+                    raise ValueError("invalid option")
+                else:
+                    values.append(nibble)
+            number += values[0]
+            options.append((number, bytes(data[pos : pos + values[1]])))
+            pos += values[1]
+
+        return cls(mtype, code, mid, token, options, payload)
+
+    def encode(self):
+        def nibble(value):
+            if value < 13:
+                return value, b""
+            if value < 269:
+                return 13, bytes([value - 13])
+            return 14, struct.pack(">H", value - 269)
+
+        out = bytearray(
+            [0x40 | self.mtype << 4 | len(self.token), self.code]
+            + list(struct.pack(">H", self.mid))
+        )
+        out += self.token
+        number = 0
+        for opt, value in sorted(self.options, key=lambda o: o[0]):
+            delta, delta_ext = nibble(opt - number)
+            length, length_ext = nibble(len(value))
+            out.append(delta << 4 | length)
+            out += delta_ext + length_ext + value
+            number = opt
+        if self.payload:
+            out += b"\xff" + self.payload
+        return bytes(out)
+
+    def option(self, number, default=None):
+        for opt, value in self.options:
+            if opt == number:
+                return value
+        return default
+
+    def uint(self, number, default=None):
+        value = self.option(number)
+        return default if value is None else int.from_bytes(value, "big")
+
+    @property
+    def path(self):
+        return "/".join(v.decode() for opt, v in self.options if opt == OPT_URI_PATH)
+
+
+# DTLS 1.2 PSK server on the system libssl, one SSL object per peer with
+# memory BIOs: datagrams are fed in and the records written are sent out
+
+SSL_ERROR_WANT_READ = 2
+SSL_ERROR_WANT_WRITE = 3
+SSL_OP_NO_QUERY_MTU = 0x00001000
+SSL_CTRL_SET_MTU = 17
+DTLS_CTRL_HANDLE_TIMEOUT = 74
+BIO_C_SET_BUF_MEM_EOF_RETURN = 130
+DTLS_MTU = 1280
+
+PSK_SERVER_CB = ctypes.CFUNCTYPE(
+    ctypes.c_uint, ctypes.c_void_p, ctypes.c_char_p, ctypes.POINTER(ctypes.c_ubyte), ctypes.c_uint
+)
+
+
+def _load_libssl():
+    path = ctypes.util.find_library("ssl")
+    if path is None:
+        raise RuntimeError("libssl not found, install OpenSSL")
+    lib = ctypes.CDLL(path)
+    p, i, sz = ctypes.c_void_p, ctypes.c_int, ctypes.c_size_t
+    prototypes = {
+        "DTLS_server_method": (p, []),
+        "SSL_CTX_new": (p, [p]),
+        "SSL_CTX_free": (None, [p]),
+        "SSL_CTX_set_cipher_list": (i, [p, ctypes.c_char_p]),
+        "SSL_CTX_set_psk_server_callback": (None, [p, PSK_SERVER_CB]),
+        "SSL_new": (p, [p]),
+        "SSL_free": (None, [p]),
+        "SSL_set_bio": (None, [p, p, p]),
+        "SSL_set_accept_state": (None, [p]),
+        "SSL_set_options": (ctypes.c_uint64, [p, ctypes.c_uint64]),
+        "SSL_ctrl": (ctypes.c_long, [p, i, ctypes.c_long, p]),
+        "SSL_do_handshake": (i, [p]),
+        "SSL_is_init_finished": (i, [p]),
+        "SSL_read": (i, [p, p, i]),
+        "SSL_write": (i, [p, p, i]),
+        "SSL_get_error": (i, [p, i]),
+        "BIO_s_mem": (p, []),
+        "BIO_new": (p, [p]),
+        "BIO_ctrl": (ctypes.c_long, [p, i, ctypes.c_long, p]),
+        "BIO_ctrl_pending": (sz, [p]),
+        "BIO_read": (i, [p, p, i]),
+        "BIO_write": (i, [p, p, i]),
+        "ERR_clear_error": (None, []),
+    }
+    for name, (restype, argtypes) in prototypes.items():
+        func = getattr(lib, name)
+        func.restype = restype
+        func.argtypes = argtypes
+    return lib
+
+
+class DtlsServerContext:
+    def __init__(self, psk_id, psk):
+        self.lib = _load_libssl()
+        self._psk_id = psk_id.encode()
+        self._psk = psk.encode()
+        self.handshake_failures = 0
+
+        # Kept referenced, libssl calls it for every handshake
+        self._psk_cb = PSK_SERVER_CB(self._find_psk)
+        self.ctx = self.lib.SSL_CTX_new(self.lib.DTLS_server_method())
+        if not self.ctx or self.lib.SSL_CTX_set_cipher_list(self.ctx, b"PSK") != 1:
+            raise RuntimeError("unable to set up a DTLS PSK context")
+        self.lib.SSL_CTX_set_psk_server_callback(self.ctx, self._psk_cb)
+
+    def _find_psk(self, ssl, identity, psk, max_len):
+        if identity != self._psk_id or len(self._psk) > max_len:
+            self.handshake_failures += 1
+            return 0
+        ctypes.memmove(psk, self._psk, len(self._psk))
+        return len(self._psk)
+
+
+class DtlsSession:
+    def __init__(self, context):
+        lib = self._lib = context.lib
+        self.ssl = lib.SSL_new(context.ctx)
+        self._rbio = lib.BIO_new(lib.BIO_s_mem())
+        self._wbio = lib.BIO_new(lib.BIO_s_mem())
+        for bio in (self._rbio, self._wbio):
+            # Empty reads are retried instead of ending the session
+            lib.BIO_ctrl(bio, BIO_C_SET_BUF_MEM_EOF_RETURN, -1, None)
+        lib.SSL_set_bio(self.ssl, self._rbio, self._wbio)
+        lib.SSL_set_options(self.ssl, SSL_OP_NO_QUERY_MTU)
+        lib.SSL_ctrl(self.ssl, SSL_CTRL_SET_MTU, DTLS_MTU, None)
+        lib.SSL_set_accept_state(self.ssl)
+        self._buf = ctypes.create_string_buffer(65536)
+        self.failed = False
+
+    def close(self):
+        if self.ssl:
+            self._lib.SSL_free(self.ssl)
+            self.ssl = None
+
+    @property
+    def established(self):
+        return bool(self._lib.SSL_is_init_finished(self.ssl))
+
+    def _check(self, ret):
+        err = self._lib.SSL_get_error(self.ssl, ret)
+        if err not in (SSL_ERROR_WANT_READ, SSL_ERROR_WANT_WRITE):
+            self.failed = True
+        self._lib.ERR_clear_error()
+
+    def outgoing(self):
+        """Records written since the last call, sent as one datagram."""
+        pending = self._lib.BIO_ctrl_pending(self._wbio)
+        if pending == 0:
+            return None
+        n = self._lib.BIO_read(self._wbio, self._buf, min(pending, len(self._buf)))
+        return self._buf.raw[:n] if n > 0 else None
+
+    def feed(self, datagram):
+        """Process a datagram, return the application data it carried."""
+        self._lib.BIO_write(self._rbio, datagram, len(datagram))
+        if not self.established:
+            ret = self._lib.SSL_do_handshake(self.ssl)
+            if ret != 1:
+                self._check(ret)
+                return []
+        messages = []
+        while True:
+            n = self._lib.SSL_read(self.ssl, self._buf, len(self._buf))
+            if n <= 0:
+                self._check(n)
+                return messages
+            messages.append(self._buf.raw[:n])
+
+    def write(self, data):
+        ret = self._lib.SSL_write(self.ssl, data, len(data))
+        if ret <= 0:
+            self._check(ret)
+
+    def handle_timeout(self):
+        """Retransmit the last handshake flight if its timer expired."""
+        if not self.established:
+            self._lib.SSL_ctrl(self.ssl, DTLS_CTRL_HANDLE_TIMEOUT, 0, None)
+
+
+def is_client_hello(datagram):
+    # Handshake record of epoch 0 holding a ClientHello
+    return (
+        len(datagram) > 13 and datagram[0] == 22 and datagram[3:5] == b"\0\0" and datagram[13] == 1
+    )
+
+
+# Network profile applied to every datagram
+
+
+class Link:
+    def __init__(self, loop, profile, seed):
+        self.loop = loop
+        self.profile = profile
+        self.rand = random.Random(seed)
+        self.start = loop.time()
+        self.link_free = 0.0
+        self.stats = dict(
+            datagrams_up=0,
+            datagrams_down=0,
+            bytes_up=0,
+            bytes_down=0,
+            lost_up=0,
+            lost_down=0,
+            offline=0,
+            throttled_ms=0,
+        )
+
+    def _is_up(self, now):
+        every, length = self.profile["outage_every_s"], self.profile["outage_s"]
+        if every == 0 or length == 0:
+            return True
+        return (now - self.start) % every < every - length
+
+    def is_up(self):
+        return self._is_up(self.loop.time())
+
+    def outages(self):
+        every, length = self.profile["outage_every_s"], self.profile["outage_s"]
+        if every == 0 or length == 0:
+            return 0
+        elapsed = self.loop.time() - self.start
+        return int((elapsed + length) // every)
+
+    def _one_way_s(self):
+        rtt = self.profile["latency_ms"]
+        jitter = self.profile["jitter_ms"]
+        if jitter:
+            rtt += self.rand.uniform(-jitter, jitter)
+        return max(rtt, 0) / 2000
+
+    def _lost(self):
+        return self.profile["loss_pct"] and self.rand.uniform(0, 100) < self.profile["loss_pct"]
+
+    def uplink(self, datagram, deliver):
+        now = self.loop.time()
+        if not self._is_up(now):
+            self.stats["offline"] += 1
+            return
+        if self._lost():
+            self.stats["lost_up"] += 1
+            return
+
+        sent = now
+        rate = self.profile["rate_bps"]
+        if rate:
+            # Datagrams leave one after the other on a throttled uplink
+            start = max(now, self.link_free)
+            self.stats["throttled_ms"] += int((start - now) * 1000)
+            sent = self.link_free = start + len(datagram) / rate
+
+        self.stats["datagrams_up"] += 1
+        self.stats["bytes_up"] += len(datagram)
+        self.loop.call_at(sent + self._one_way_s(), deliver, datagram)
+
+    def downlink(self, datagram, send):
+        if not self.is_up():
+            self.stats["offline"] += 1
+            return
+        if self._lost():
+            self.stats["lost_down"] += 1
+            return
+        self.stats["datagrams_down"] += 1
+        self.stats["bytes_down"] += len(datagram)
+        self.loop.call_later(self._one_way_s(), send, datagram)
+
+
+# Golioth device API
+
+
+def parse_value(text):
+    """Setting or RPC parameter from the command line: bool, int, float or string."""
+    if text in ("true", "false"):
+        return text == "true"
+    for kind in (int, float):
+        try:
+            return kind(text)
+        except ValueError:
+            pass
+    return text
+
+
+class Observation:
+    def __init__(self, peer, token, path, accept):
+        self.peer = peer
+        self.token = token
+        self.path = path
+        self.accept = accept
+        self.seq = 2
+
+
+class Peer:
+    def __init__(self, addr, session):
+        self.addr = addr
+        self.session = session
+        self.last_seen = 0.0
+        self.next_mid = random.randrange(0x10000)
+        # Responses to recent confirmable requests, by message ID
+        self.responses = {}
+        # Confirmable notifications waiting for their ACK, by message ID
+        self.unacked = {}
+        # Block-wise uploads in progress, by path
+        self.blocks = {}
+
+    def mid(self):
+        self.next_mid = (self.next_mid + 1) & 0xFFFF
+        return self.next_mid
+
+
+class GoliothStandIn(asyncio.DatagramProtocol):
+    def __init__(self, options, loop):
+        self.options = options
+        self.loop = loop
+        self.lock = threading.Lock()
+        self.dtls = DtlsServerContext(options.psk_id, options.psk)
+        self.link = Link(loop, options.profile, options.seed)
+        self.transport = None
+        self.peers = {}
+        self.observations = {}
+        self.lightdb = {}
+        for item in options.lightdb:
+            path, _, value = item.partition("=")
+            self.lightdb[path] = json.loads(value)
+        self.settings = {}
+        for item in options.setting:
+            name, _, value = item.partition("=")
+            self.settings[name] = parse_value(value)
+        self.settings_version = int(time.time())
+        self.rpc_calls = [self._parse_rpc(call) for call in options.rpc]
+        self.rpc_pending = {}
+        self.rpc_observed_at = None
+        self.rpc_results = []
+        self.uploads = {}
+        self.counters = dict(
+            sessions=0, requests=0, duplicates=0, retransmissions=0, pings=0, errors=0
+        )
+
+    @staticmethod
+    def _parse_rpc(call):
+        delay, method, *params = call.split(":", 2)
+        params = params[0].split(",") if params and params[0] else []
+        return dict(delay_s=float(delay), method=method, params=[parse_value(p) for p in params])
+
+    def connection_made(self, transport):
+        self.transport = transport
+        self.loop.call_later(1, self._tick)
+
+    # Datagrams
+
+    def datagram_received(self, datagram, addr):
+        self.link.uplink(datagram, lambda d: self._from_device(d, addr))
+
+    def _to_device(self, peer, data):
+        if data:
+            self.link.downlink(data, lambda d: self.transport.sendto(d, peer.addr))
+
+    def _flush(self, peer):
+        self._to_device(peer, peer.session.outgoing())
+
+    def _from_device(self, datagram, addr):
+        peer = self.peers.get(addr)
+
+        if peer is None or (peer.session.established and is_client_hello(datagram)):
+            if not is_client_hello(datagram):
+                return
+            if peer is not None:
+                self._forget(peer)
+            peer = self.peers[addr] = Peer(addr, DtlsSession(self.dtls))
+
+        peer.last_seen = self.loop.time()
+        was_established = peer.session.established
+        messages = peer.session.feed(datagram)
+        self._flush(peer)
+
+        if peer.session.failed:
+            self._forget(peer)
+            return
+        if peer.session.established and not was_established:
+            with self.lock:
+                self.counters["sessions"] += 1
+
+        for data in messages:
+            try:
+                self._handle(peer, Message.decode(data))
+            except (ValueError, IndexError, struct.error):
+                with self.lock:
+                    self.counters["errors"] += 1
+            self._flush(peer)
+
+    def _send(self, peer, msg):
+        peer.session.write(msg.encode())
+        self._flush(peer)
+
+    def _forget(self, peer):
+        for key in [k for k, obs in self.observations.items() if obs.peer is peer]:
+            del self.observations[key]
+        for pending in peer.unacked.values():
+            pending["timer"].cancel()
+        peer.session.close()
+        self.peers.pop(peer.addr, None)
+
+    # CoAP messaging layer
+
+    def _handle(self, peer, msg):
+        if msg.mtype in (ACK, RST):
+            pending = peer.unacked.pop(msg.mid, None)
+            if pending:
+                pending["timer"].cancel()
+                if msg.mtype == RST:
+                    self.observations.pop((peer.addr, pending["token"]), None)
+            return
+
+        if msg.code == 0:
+            # CoAP ping
+            with self.lock:
+                self.counters["pings"] += 1
+            self._send(peer, Message(RST, 0, msg.mid))
+            return
+
+        if msg.mtype == CON and msg.mid in peer.responses:
+            # Retransmission of a request already answered
+            with self.lock:
+                self.counters["duplicates"] += 1
+            self._send(peer, peer.responses[msg.mid][1])
+            return
+
+        with self.lock:
+            self.counters["requests"] += 1
+        code, options, payload = self._request(peer, msg)
+
+        if msg.mtype == CON:
+            response = Message(ACK, code, msg.mid, msg.token, options, payload)
+            now = self.loop.time()
+            peer.responses[msg.mid] = (now, response)
+            for mid in [m for m, (t, _) in peer.responses.items() if now - t > EXCHANGE_LIFETIME_S]:
+                del peer.responses[mid]
+        else:
+            response = Message(NON, code, peer.mid(), msg.token, options, payload)
+        self._send(peer, response)
+
+    def _notify(self, obs, code, options, payload):
+        peer = self.peers.get(obs.peer)
+        if peer is None:
+            return
+        obs.seq = (obs.seq + 1) & 0xFFFFFF
+        msg = Message(
+            CON, code, peer.mid(), obs.token, [(OPT_OBSERVE, uint_option(obs.seq))] + options,
+            payload,
+        )
+        pending = {"token": obs.token, "tries": 0}
+        peer.unacked[msg.mid] = pending
+
+        def retransmit():
+            if peer.unacked.get(msg.mid) is not pending:
+                return
+            if pending["tries"] == MAX_RETRANSMIT:
+                # The device is gone, it observes again once reconnected
+                del peer.unacked[msg.mid]
+                self.observations.pop((peer.addr, obs.token), None)
+                return
+            pending["tries"] += 1
+            with self.lock:
+                self.counters["retransmissions"] += 1
+            self._send(peer, msg)
+            schedule()
+
+        def schedule():
+            timeout = ACK_TIMEOUT_S * random.uniform(1, ACK_RANDOM_FACTOR) * 2 ** pending["tries"]
+            pending["timer"] = self.loop.call_later(timeout, retransmit)
+
+        self._send(peer, msg)
+        schedule()
+
+    # Golioth resources
+
+    def _request(self, peer, msg):
+        path = msg.path
+        payload = msg.payload
+
+        block1 = msg.uint(OPT_BLOCK1)
+        if block1 is not None and msg.code in (POST, PUT):
+            if block1 >> 4 == 0:
+                peer.blocks[path] = []
+            peer.blocks.setdefault(path, []).append(payload)
+            if block1 & 0x8:
+                return CONTINUE, [(OPT_BLOCK1, uint_option(block1))], b""
+            payload = b"".join(peer.blocks.pop(path))
+
+        service, _, rest = path.partition("/")
+        fmt = msg.uint(OPT_CONTENT_FORMAT, FORMAT_JSON)
+        accept = msg.uint(OPT_ACCEPT, FORMAT_JSON)
+
+        if msg.code == GET:
+            if msg.option(OPT_OBSERVE) == b"":
+                obs = Observation(peer.addr, msg.token, path, accept)
+                self.observations[(peer.addr, msg.token)] = obs
+                options = [(OPT_OBSERVE, uint_option(obs.seq))]
+            else:
+                self.observations.pop((peer.addr, msg.token), None)
+                options = []
+            code, more_options, body = self._get(path, service, rest, accept)
+            if code != CONTENT:
+                self.observations.pop((peer.addr, msg.token), None)
+                options = []
+            return code, options + more_options, body
+
+        if msg.code in (POST, PUT):
+            self._count(rest if service == ".s" else path, len(payload))
+            if service == ".s" or path == "logs":
+                self._print_payload(path, fmt, payload)
+                return CHANGED, [], b""
+            if service == ".d":
+                self._print_payload(path, fmt, payload)
+                return self._set_state(rest, fmt, payload)
+            if path == ".rpc/status":
+                self._rpc_status(payload)
+                return CHANGED, [], b""
+            if path == ".c/status":
+                self._settings_status(payload)
+                return CHANGED, [], b""
+            return CHANGED, [], b""
+
+        if msg.code == DELETE and service == ".d":
+            self.lightdb.pop(rest, None)
+            self._state_changed(rest)
+            return DELETED, [], b""
+
+        return METHOD_NOT_ALLOWED, [], b""
+
+    def _get(self, path, service, rest, accept):
+        if service == ".d":
+            return self._content(self.lightdb.get(rest), accept)
+        if path == ".c":
+            doc = {"version": self.settings_version, "settings": self.settings}
+            return CONTENT, [(OPT_CONTENT_FORMAT, uint_option(FORMAT_CBOR))], cbor_encode(doc)
+        if path == ".rpc":
+            if self.rpc_observed_at is None:
+                self.rpc_observed_at = self.loop.time()
+            # Acknowledged by the SDK and otherwise ignored
+            return CONTENT, [(OPT_CONTENT_FORMAT, uint_option(FORMAT_CBOR))], cbor_encode("OK")
+        return NOT_FOUND, [], b""
+
+    @staticmethod
+    def _content(value, accept):
+        if accept == FORMAT_CBOR:
+            body = cbor_encode(value)
+        elif accept == FORMAT_JSON:
+            body = json.dumps(value, separators=(",", ":")).encode()
+        else:
+            return UNSUPPORTED_FORMAT, [], b""
+        return CONTENT, [(OPT_CONTENT_FORMAT, uint_option(accept))], body
+
+    def _set_state(self, path, fmt, payload):
+        try:
+            value = cbor_decode(payload) if fmt == FORMAT_CBOR else json.loads(payload)
+        except (ValueError, IndexError, struct.error):
+            return BAD_REQUEST, [], b""
+        self.lightdb[path] = json_safe(value)
+        self._state_changed(path)
+        return CHANGED, [], b""
+
+    def _state_changed(self, path):
+        for obs in [o for o in self.observations.values() if o.path == ".d/" + path]:
+            code, options, body = self._content(self.lightdb.get(path), obs.accept)
+            self._notify(obs, code, options, body)
+
+    def _count(self, path, size):
+        with self.lock:
+            count = self.uploads.setdefault(path, [0, 0])
+            count[0] += 1
+            count[1] += size
+
+    def _print_payload(self, path, fmt, payload):
+        if not self.options.payloads:
+            return
+        if fmt == FORMAT_CBOR:
+            text = json.dumps(json_safe(cbor_decode(payload)), separators=(",", ":"))
+        else:
+            text = payload.decode(errors="replace")
+        print(f"CLOUD_PAYLOAD {path} {text}", flush=True)
+
+    # RPC and settings
+
+    def _tick(self):
+        now = self.loop.time()
+
+        for peer in [p for p in self.peers.values() if now - p.last_seen > SESSION_IDLE_S]:
+            self._forget(peer)
+        for peer in self.peers.values():
+            peer.session.handle_timeout()
+            self._flush(peer)
+
+        if self.rpc_observed_at is not None:
+            for call in self.rpc_calls:
+                if "id" not in call and now - self.rpc_observed_at >= call["delay_s"]:
+                    self._call_rpc(call)
+
+        self.loop.call_later(0.25, self._tick)
+
+    def _call_rpc(self, call):
+        observers = [o for o in self.observations.values() if o.path == ".rpc"]
+        if not observers:
+            # Sent once the device observes RPCs again
+            return
+        call["id"] = str(self.rpc_calls.index(call) + 1)
+        self.rpc_pending[call["id"]] = call
+        request = {"id": call["id"], "method": call["method"], "params": call["params"]}
+        for obs in observers:
+            self._notify(
+                obs, CONTENT, [(OPT_CONTENT_FORMAT, uint_option(FORMAT_CBOR))], cbor_encode(request)
+            )
+
+    def _rpc_status(self, payload):
+        status = cbor_decode(payload)
+        call = self.rpc_pending.pop(status.get("id"), None)
+        if call is None:
+            # Response to a call sent more than once, or not sent at all
+            return
+        result = {
+            "method": call.get("method"),
+            "status": status.get("statusCode"),
+            "detail": json_safe(status.get("detail", {})),
+        }
+        with self.lock:
+            self.rpc_results.append(result)
+        print(f"CLOUD_RPC {json.dumps(result, separators=(',', ':'))}", flush=True)
+
+    def _settings_status(self, payload):
+        status = cbor_decode(payload)
+        for error in status.get("errors", []):
+            print(f"Setting {error.get('setting_key')} rejected: {error.get('error_code')}",
+                  file=sys.stderr)
+
+    # Reports, called from other threads
+
+    def snapshot(self):
+        with self.lock:
+            return {
+                "profile": self.options.profile_name,
+                "link_up": self.link.is_up(),
+                "outages": self.link.outages(),
+                "link": dict(self.link.stats),
+                "handshake_failures": self.dtls.handshake_failures,
+                **dict(self.counters),
+                "uploads": {path: list(count) for path, count in self.uploads.items()},
+                "rpc": list(self.rpc_results),
+            }
+
+    def upload_count(self, path):
+        with self.lock:
+            return self.uploads.get(path, [0, 0])[0]
+
+
+class SimCloud:
+    """The server, run on its own event loop thread."""
+
+    def __init__(self, **kwargs):
+        self.options = make_options(**kwargs)
+        self._loop = asyncio.new_event_loop()
+        self._thread = threading.Thread(target=self._loop.run_forever, daemon=True)
+        self.server = None
+        self._transport = None
+
+    def start(self):
+        self._thread.start()
+
+        async def bind():
+            return await self._loop.create_datagram_endpoint(
+                lambda: GoliothStandIn(self.options, self._loop),
+                local_addr=(self.options.host, self.options.port),
+            )
+
+        self._transport, self.server = asyncio.run_coroutine_threadsafe(bind(), self._loop).result()
+        return self
+
+    def stop(self):
+        self._loop.call_soon_threadsafe(self._transport.close)
+        self._loop.call_soon_threadsafe(self._loop.stop)
+        self._thread.join()
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, *exc):
+        self.stop()
+
+    def stats(self):
+        return self.server.snapshot()
+
+    def upload_count(self, path):
+        return self.server.upload_count(path)
+
+    def link_up(self):
+        return self.server.link.is_up()
+
+
+class Options(argparse.Namespace):
+    pass
+
+
+def make_options(
+    profile="lte",
+    host="127.0.0.1",
+    port=DEFAULT_PORT,
+    psk_id=DEFAULT_PSK_ID,
+    psk=DEFAULT_PSK,
+    seed=1,
+    settings=(),
+    lightdb=(),
+    rpc=(),
+    payloads=False,
+    **overrides,
+):
+    if profile not in PROFILES:
+        raise ValueError(f"unknown network profile {profile}, one of {', '.join(PROFILES)}")
+    values = dict(PROFILES[profile])
+    for key, value in overrides.items():
+        if key not in values:
+            raise TypeError(f"unknown option {key}")
+        if value is not None:
+            values[key] = value
+    if values["outage_s"] >= values["outage_every_s"]:
+        values["outage_s"] = 0
+
+    options = Options()
+    options.profile_name = profile
+    options.profile = values
+    options.host = host
+    options.port = port
+    options.psk_id = psk_id
+    options.psk = psk
+    options.seed = seed
+    options.setting = list(settings)
+    options.lightdb = list(lightdb)
+    options.rpc = list(rpc)
+    options.payloads = payloads
+    return options
+
+
+def add_profile_arguments(parser):
+    """Network profile options, shared with sim_bench.py and sim_soak.py."""
+    parser.add_argument("--latency-ms", type=int, help="round trip time, overrides the profile")
+    parser.add_argument("--jitter-ms", type=int, help="round trip jitter, overrides the profile")
+    parser.add_argument(
+        "--loss-pct", type=float, help="datagrams lost each way, overrides the profile"
+    )
+    parser.add_argument(
+        "--rate-bps", type=int, help="uplink bytes per second (0: unlimited), overrides the profile"
+    )
+    parser.add_argument(
+        "--outage-every-s", type=int, help="outage period (0: none), overrides the profile"
+    )
+    parser.add_argument("--outage-s", type=int, help="outage length, overrides the profile")
+    parser.add_argument("--seed", type=int, default=1, help="packet loss and jitter seed")
+
+
+def profile_overrides(args):
+    return dict(
+        latency_ms=args.latency_ms,
+        jitter_ms=args.jitter_ms,
+        loss_pct=args.loss_pct,
+        rate_bps=args.rate_bps,
+        outage_every_s=args.outage_every_s,
+        outage_s=args.outage_s,
+        seed=args.seed,
+    )
+
+
+SAMPLE_RE = re.compile(r"^SIM_SAMPLE (\{.*\})\s*$")
+RESULT_RE = re.compile(r"^SIM_RESULT (\{.*\})\s*$")
+
+
+def run_device(cmd, cloud, timeout):
+    """Run a native_sim executable against cloud until it prints its SIM_RESULT.
+
+    Returns the result, with the cloud statistics under "cloud", and the
+    SIM_SAMPLE lines, with the track points uploaded so far and the link state.
+    """
+    proc = subprocess.Popen(
+        cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, errors="replace"
+    )
+    timer = threading.Timer(timeout, proc.kill)
+    timer.start()
+    samples = []
+    result = None
+    tail = []
+
+    try:
+        for line in proc.stdout:
+            tail = (tail + [line])[-50:]
+            match = SAMPLE_RE.match(line)
+            if match:
+                sample = json.loads(match.group(1))
+                sample["uploads"] = cloud.upload_count("tracker")
+                sample["link_up"] = cloud.link_up()
+                samples.append(sample)
+                continue
+            match = RESULT_RE.match(line)
+            if match:
+                result = json.loads(match.group(1))
+                result["cloud"] = cloud.stats()
+    finally:
+        proc.kill()
+        proc.wait()
+        timer.cancel()
+
+    if result is None:
+        sys.stderr.write("".join(tail))
+        raise RuntimeError(f"no SIM_RESULT line from {' '.join(cmd)} (exit {proc.returncode})")
+
+    return result, samples
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument(
+        "--profile", default="lte", choices=PROFILES, help="network profile (default: %(default)s)"
+    )
+    add_profile_arguments(parser)
+    parser.add_argument("--host", default="127.0.0.1", help="address to listen on")
+    parser.add_argument("--port", type=int, default=DEFAULT_PORT, help="UDP port to listen on")
+    parser.add_argument("--psk-id", default=DEFAULT_PSK_ID, help="PSK ID of the device")
+    parser.add_argument("--psk", default=DEFAULT_PSK, help="PSK of the device")
+    parser.add_argument(
+        "--setting", action="append", default=[], metavar="NAME=VALUE",
+        help="setting sent to the device, may be repeated; use a decimal point for floats",
+    )
+    parser.add_argument(
+        "--lightdb", action="append", default=[], metavar="PATH=JSON",
+        help="LightDB State value, may be repeated",
+    )
+    parser.add_argument(
+        "--rpc", action="append", default=[], metavar="S:METHOD[:PARAM,..]",
+        help="call an RPC this many seconds after the device observes RPCs, may be repeated",
+    )
+    parser.add_argument("--payloads", action="store_true", help="print every upload")
+    parser.add_argument(
+        "--stats-s", type=int, default=0, help="print a CLOUD_STATS line every this many seconds"
+    )
+    args = parser.parse_args()
+
+    cloud = SimCloud(
+        profile=args.profile,
+        host=args.host,
+        port=args.port,
+        psk_id=args.psk_id,
+        psk=args.psk,
+        settings=args.setting,
+        lightdb=args.lightdb,
+        rpc=args.rpc,
+        payloads=args.payloads,
+        **profile_overrides(args),
+    ).start()
+    print(f"Listening on coaps://{args.host}:{args.port}, {args.profile} profile", flush=True)
+
+    try:
+        while True:
+            time.sleep(args.stats_s or 3600)
+            if args.stats_s:
+                print(f"CLOUD_STATS {json.dumps(cloud.stats())}", flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print(f"CLOUD_STATS {json.dumps(cloud.stats())}", flush=True)
+        cloud.stop()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
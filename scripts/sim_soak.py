@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Golioth, Inc.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Soak test the tracking pipeline on native_sim over simulated network profiles.
+
+Runs a native_sim build (CONFIG_APP_SIM, see src/sim) for hours once per
+network profile, against a fresh local Golioth server (sim_cloud.py) that
+applies the profile's latency, packet loss, uplink throttling and outages to
+every datagram, and reports for each run:
+
+- sustained rates: track points recorded and uploaded per second over the
+  second half of the run, once queues have settled
+- queue growth: trend of the track queue size over the second half of the run,
+  in bytes per hour; a positive trend means uploads can't keep up
+- memory: track queue and heap high-watermarks, and the thread with the least
+  stack headroom
+- recovery: time for the track queue to drain back to its size before each
+  outage once the client is reconnected, and outages not recovered before the
+  next
+- network: datagrams lost or dropped while offline, and client reconnections
+
+The device runs in real time, so each run takes --hours. Build and run:
+
+    west build -p -b native_sim app
+    app/scripts/sim_soak.py --exe build/zephyr/zephyr.exe --hours 4
+
+Exits with status 1 if a --max-* limit is given and any run exceeds it.
+"""
+
+import argparse
+import json
+import sys
+
+from sim_cloud import PROFILES, SimCloud, run_device
+
+DEFAULT_SETTINGS = ["GPS_DELAY_S=0"]
+
+
+def run(args, profile):
+    cmd = [
+        args.exe,
+        f"-duration={int(args.hours * 3600)}",
+        f"-sample_s={args.sample_s}",
+        f"-speedup={args.speedup}",
+    ]
+
+    cloud = SimCloud(profile=profile, seed=args.seed, settings=args.setting or DEFAULT_SETTINGS)
+    with cloud:
+        return run_device(cmd, cloud, args.timeout)
+
+
+def slope(points):
+    """Least-squares slope of (x, y) points, 0 if there are too few."""
+    n = len(points)
+    if n < 2:
+        return 0.0
+    mean_x = sum(x for x, _ in points) / n
+    mean_y = sum(y for _, y in points) / n
+    var = sum((x - mean_x) ** 2 for x, _ in points)
+    if var == 0:
+        return 0.0
+    return sum((x - mean_x) * (y - mean_y) for x, y in points) / var
+
+
+def rate(samples, key):
+    if len(samples) < 2 or samples[-1]["t"] == samples[0]["t"]:
+        return 0.0
+    return (samples[-1][key] - samples[0][key]) / (samples[-1]["t"] - samples[0]["t"])
+
+
+def summarize(result, samples):
+    steady = samples[len(samples) // 2 :]
+    soak = result["soak"]
+    cloud = result["cloud"]
+    link = cloud["link"]
+
+    # [size, peak used] per thread
+    stacks = result["stacks"]
+    tightest = min(stacks, key=lambda name: stacks[name][0] - stacks[name][1], default=None)
+
+    return {
+        "profile": cloud["profile"],
+        "hours": result["duration_s"] / 3600,
+        "recorded_per_s": rate(steady, "track_seq"),
+        "uploaded_per_s": rate(steady, "uploads"),
+        "queue_growth_bph": slope([(s["t"] / 3600, s["queue_bytes"]) for s in steady]),
+        "queue_peak_bytes": soak["queue_peak_bytes"],
+        "heap_peak_bytes": result["heap"][2],
+        "stack_tightest": tightest,
+        "stack_headroom_bytes": (
+            stacks[tightest][0] - stacks[tightest][1] if tightest is not None else None
+        ),
+        "drops": sum(result["drops"].values()),
+        "lost": link["lost_up"] + link["lost_down"] + link["offline"],
+        "outages": cloud["outages"],
+        "reconnects": soak["reconnects"],
+        "recoveries": soak["recoveries"],
+        "recovery_mean_s": soak["recovery_mean_ms"] / 1000 if soak["recoveries"] else None,
+        "recovery_max_s": soak["recovery_max_ms"] / 1000 if soak["recoveries"] else None,
+        "unrecovered": soak["unrecovered"],
+    }
+
+
+def fmt(value, spec):
+    return "-" if value is None else format(value, spec)
+
+
+def print_table(rows):
+    header = (
+        f"{'profile':>10} {'rec/s':>7} {'up/s':>7} {'queue B/h':>10} {'queue pk':>9} "
+        f"{'heap pk':>8} {'stack min':>16} {'drops':>6} {'lost':>6} {'outages':>7} "
+        f"{'reconn':>6} {'recov avg':>9} {'recov max':>9} {'unrecov':>7}"
+    )
+    print(header)
+    print("-" * len(header))
+    for row in rows:
+        stack = (
+            f"{row['stack_tightest']}:{row['stack_headroom_bytes']}"
+            if row["stack_tightest"] is not None
+            else "-"
+        )
+        print(
+            f"{row['profile']:>10} {row['recorded_per_s']:>7.3f} {row['uploaded_per_s']:>7.3f} "
+            f"{row['queue_growth_bph']:>10.1f} {row['queue_peak_bytes']:>9} "
+            f"{row['heap_peak_bytes']:>8} {stack:>16} {row['drops']:>6} {row['lost']:>6} "
+            f"{row['outages']:>7} {row['reconnects']:>6} {fmt(row['recovery_mean_s'], '.1f'):>9} "
+            f"{fmt(row['recovery_max_s'], '.1f'):>9} {row['unrecovered']:>7}"
+        )
+    print("Rates over the second half of each run, lost datagrams in both directions")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", default="build/zephyr/zephyr.exe", help="native_sim executable")
+    parser.add_argument(
+        "--profiles",
+        default="lte,lte_poor,nbiot,throttled,outages",
+        help=f"comma-separated network profiles, of {', '.join(PROFILES)} (default: %(default)s)",
+    )
+    parser.add_argument(
+        "--hours", type=float, default=4, help="hours per run (default: %(default)s)"
+    )
+    parser.add_argument(
+        "--sample-s", type=int, default=60, help="sampling period (default: %(default)s)"
+    )
+    parser.add_argument(
+        "--speedup", type=float, default=1, help="NMEA replay speed-up (default: %(default)s)"
+    )
+    parser.add_argument("--seed", type=int, default=1, help="packet loss and jitter seed")
+    parser.add_argument(
+        "--setting",
+        action="append",
+        metavar="NAME=VALUE",
+        help=f"Golioth setting, may be repeated (default: {' '.join(DEFAULT_SETTINGS)})",
+    )
+    parser.add_argument("--json", help="write the raw and summarized results to this file")
+    parser.add_argument("--max-queue-growth", type=float, help="fail above this many bytes/hour")
+    parser.add_argument("--max-recovery-s", type=float, help="fail if a recovery takes longer")
+    parser.add_argument(
+        "--min-stack-headroom", type=int, help="fail if a thread has less unused stack (bytes)"
+    )
+    parser.add_argument(
+        "--timeout", type=int, help="wall-clock seconds per run (default: hours + 10 minutes)"
+    )
+    args = parser.parse_args()
+    if args.timeout is None:
+        args.timeout = int(args.hours * 3600) + 600
+
+    runs = []
+    rows = []
+    for profile in args.profiles.split(","):
+        result, samples = run(args, profile)
+        runs.append({"result": result, "samples": samples})
+        rows.append(summarize(result, samples))
+
+    print_table(rows)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"runs": runs, "summary": rows}, f, indent=2)
+
+    failures = []
+    for row in rows:
+        if args.max_queue_growth is not None and row["queue_growth_bph"] > args.max_queue_growth:
+            failures.append(f"{row['profile']}: queue grows {row['queue_growth_bph']:.1f} B/h")
+        if args.max_recovery_s is not None and (
+            (row["recovery_max_s"] or 0) > args.max_recovery_s or row["unrecovered"]
+        ):
+            failures.append(f"{row['profile']}: recovery takes up to {row['recovery_max_s']} s")
+        if (
+            args.min_stack_headroom is not None
+            and row["stack_headroom_bytes"] is not None
+            and row["stack_headroom_bytes"] < args.min_stack_headroom
+        ):
+            failures.append(
+                f"{row['profile']}: {row['stack_tightest']} has "
+                f"{row['stack_headroom_bytes']} bytes of stack left"
+            )
+
+    for failure in failures:
+        print(failure, file=sys.stderr)
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 Golioth, Inc.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Convert a trace downloaded with the `trace` RPC to a Chrome trace.
+
+The input is the LightDB Stream data of the "trace" path, as JSON: either a
+list of chunks, a Golioth REST API stream query response ({"list": [...]}),
+or one chunk per line. Each chunk looks like
+
+    {"seq": 0, "last": false, "hz": 64000000, "events": [[cycles, id, arg], ...]}
+
+Event names are read from `enum trace_event` in src/trace.h. The output can be
+opened in https://ui.perfetto.dev or chrome://tracing.
+
+Usage: trace_to_perfetto.py trace.json [-o trace.perfetto.json]
+"""
+
+import argparse
+import json
+import pathlib
+import re
+import sys
+
+TRACE_H = pathlib.Path(__file__).resolve().parent.parent / "src" / "trace.h"
+
+
+def event_names(header):
+    body = re.search(r"enum trace_event \{(.*?)\};", header.read_text(), re.S).group(1)
+    body = re.sub(r"/\*.*?\*/", "", body, flags=re.S)
+    return [name.strip() for name in body.split(",") if name.strip()]
+
+
+def find_chunks(data):
+    if isinstance(data, dict):
+        if "events" in data:
+            yield data
+        else:
+            for value in data.values():
+                yield from find_chunks(value)
+    elif isinstance(data, list):
+        for value in data:
+            yield from find_chunks(value)
+
+
+def load_chunks(path):
+    text = pathlib.Path(path).read_text()
+    try:
+        data = json.loads(text)
+    except json.JSONDecodeError:
+        data = [json.loads(line) for line in text.splitlines() if line.strip()]
+
+    chunks = {}
+    for chunk in find_chunks(data):
+        chunks[chunk["seq"]] = chunk
+
+    seqs = sorted(chunks)
+    missing = sorted(set(range(seqs[-1] + 1)) - set(seqs)) if seqs else []
+    if missing:
+        print(f"warning: chunks {missing} missing, the trace has gaps", file=sys.stderr)
+    if seqs and not chunks[seqs[-1]]["last"]:
+        print("warning: last chunk missing, the trace is truncated", file=sys.stderr)
+
+    return [chunks[seq] for seq in seqs]
+
+
+def convert(chunks, names):
+    events = []
+    tids = {}
+    # Cycle count since the first record, extended past 32 bits
+    cycles_total = 0
+    prev = None
+
+    for chunk in chunks:
+        us_per_cycle = 1e6 / chunk["hz"]
+
+        for cycles, event_id, arg in chunk["events"]:
+            # Records hold the low 32 bits of the cycle counter. A step of more
+            # than 2^31 backwards is a wrap, a smaller one a record out of order.
+            if prev is not None:
+                step = (cycles - prev) & 0xFFFFFFFF
+                if step >= 1 << 31:
+                    step -= 1 << 32
+                cycles_total += step
+            prev = cycles
+            ts = cycles_total * us_per_cycle
+
+            name = names[event_id] if event_id < len(names) else f"TRACE_UNKNOWN_{event_id}"
+            if name.endswith("_BEGIN"):
+                phase, name = "B", name[: -len("_BEGIN")]
+            elif name.endswith("_END"):
+                phase, name = "E", name[: -len("_END")]
+            else:
+                phase = "i"
+
+            # TRACE_<track>_<name>, or TRACE_<track> for the track's own slices
+            words = name.lower().split("_")[1:]
+            track = words[0]
+            tid = tids.setdefault(track, len(tids) + 1)
+
+            event = {
+                "name": "_".join(words[1:]) or track,
+                "ph": phase,
+                "ts": ts,
+                "pid": 1,
+                "tid": tid,
+                "args": {"arg": arg},
+            }
+            if phase == "i":
+                event["s"] = "t"
+            events.append(event)
+
+    # Time starts at the first record
+    if events:
+        start = events[0]["ts"]
+        for event in events:
+            event["ts"] = round(event["ts"] - start, 3)
+
+    for track, tid in tids.items():
+        events.append(
+            {"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": track}}
+        )
+
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="downloaded trace chunks (JSON)")
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    parser.add_argument("--header", default=TRACE_H, help="trace.h with the event IDs")
+    args = parser.parse_args()
+
+    trace = convert(load_chunks(args.input), event_names(pathlib.Path(args.header)))
+
+    if args.output:
+        pathlib.Path(args.output).write_text(json.dumps(trace))
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
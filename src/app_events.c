@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_events, LOG_LEVEL_DBG);
+
+#include <stdarg.h>
+#include <golioth/client.h>
+#include <golioth/stream.h>
+#include <zephyr/kernel.h>
+
+#include "app_events.h"
+#include "app_stats.h"
+#include "format_helper.h"
+#include "main.h"
+#include "perf_stats.h"
+#include "time_base.h"
+
+#define GOLIOTH_STREAM_TIMEOUT_S 2
+
+/* Time and sequence number, ahead of the body */
+#define EVENT_HEADER_LEN (sizeof("{\"time\":\"\",\"seq\":4294967295,") + FORMAT_TIME_LEN)
+
+/* The time is added on upload, so events captured before UTC is known still get one */
+struct app_event {
+	int64_t uptime_ms;
+	uint32_t seq;
+	/* "<type>":{<body>}} */
+	char json[CONFIG_APP_EVENT_MAX_LEN];
+};
+
+K_MSGQ_DEFINE(events_msgq, sizeof(struct app_event), CONFIG_APP_EVENT_QUEUE_DEPTH, 4);
+
+int app_events_post(const char *type, int64_t uptime_ms, bool urgent, const char *fmt, ...)
+{
+	struct app_event event = {
+		.uptime_ms = uptime_ms,
+		.seq = app_stats_next_seq(APP_SEQ_EVENT),
+	};
+	va_list args;
+	int len;
+	int ret;
+	int err;
+
+	len = snprintk(event.json, sizeof(event.json), "\"%s\":{", type);
+
+	va_start(args, fmt);
+	ret = vsnprintk(&event.json[len], sizeof(event.json) - len, fmt, args);
+	va_end(args);
+	len += ret;
+
+	if (len < sizeof(event.json)) {
+		len += snprintk(&event.json[len], sizeof(event.json) - len, "}}");
+	}
+	if (len >= sizeof(event.json)) {
+		LOG_ERR("Event \"%s\" does not fit in %zu bytes", type, sizeof(event.json));
+		app_stats_inc(APP_STAT_EVENT_QUEUE_DROPS);
+		return -ENOMEM;
+	}
+
+	err = k_msgq_put(&events_msgq, &event, K_NO_WAIT);
+	if (err) {
+		LOG_ERR("Unable to queue \"%s\" event %u: %d", type, event.seq, err);
+		app_stats_inc(APP_STAT_EVENT_QUEUE_DROPS);
+		return -ENOMEM;
+	}
+
+	perf_stats_queue_depth(PERF_QUEUE_EVENTS, k_msgq_num_used_get(&events_msgq));
+	LOG_DBG("Queued \"%s\" event", type);
+
+	if (urgent) {
+		wake_system_thread();
+	}
+
+	return 0;
+}
+
+void app_events_flush(struct golioth_client *client)
+{
+	struct app_event event;
+	char ts_str[FORMAT_TIME_LEN];
+	char json[EVENT_HEADER_LEN + CONFIG_APP_EVENT_MAX_LEN];
+	int64_t time_ms;
+	int err;
+
+	/* Only removed once uploaded, the flush is retried from the next upload cycle */
+	while (k_msgq_peek(&events_msgq, &event) == 0) {
+		time_ms = time_base_utc_ms(event.uptime_ms);
+		if (time_ms) {
+			format_time_ms(ts_str, sizeof(ts_str), time_ms);
+			snprintk(json, sizeof(json), "{\"time\":\"%s\",\"seq\":%u,%s", ts_str,
+				 event.seq, event.json);
+		} else {
+			snprintk(json, sizeof(json), "{\"seq\":%u,%s", event.seq, event.json);
+		}
+
+		err = golioth_stream_set_sync(client, APP_EVENTS_STREAM_ENDP,
+					      GOLIOTH_CONTENT_TYPE_JSON, json, strlen(json),
+					      GOLIOTH_STREAM_TIMEOUT_S);
+		if (err) {
+			LOG_ERR("Failed to send event %u to Golioth: %d", event.seq, err);
+			app_stats_inc(APP_STAT_STREAM_ERRORS);
+			return;
+		}
+
+		/* This is the only reader, so the head is still the event just sent */
+		k_msgq_get(&events_msgq, &event, K_NO_WAIT);
+	}
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_EVENTS_H__
+#define __APP_EVENTS_H__
+
+/** Queue of event records (geofence crossings, etc.) for Golioth LightDB Stream.
+ *
+ * Events are sent to the `events` stream path ahead of any routine track
+ * points waiting in the upload queue. Each event is a JSON object of the form
+ * `{"time":"<ISO 8601>","seq":<n>,"<type>":{<body>}}`; `seq` is the event
+ * sequence number (see app_stats.h). `time` is converted from the capture
+ * uptime on upload (see time_base.h), so events captured before UTC is known
+ * are still timestamped, and it is omitted only if UTC is still unknown then.
+ *
+ * https://docs.golioth.io/firmware/zephyr-device-sdk/light-db-stream/
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <golioth/client.h>
+
+#define APP_EVENTS_STREAM_ENDP "events"
+
+/**
+ * Queue an event for upload.
+ *
+ * @param type name of the event type, used as the key of the event body
+ * @param uptime_ms uptime in milliseconds at which the event was captured
+ * @param urgent wake the system thread so the event is sent without waiting
+ * for the next upload cycle
+ * @param fmt printf-style format of the JSON body (without enclosing braces)
+ *
+ * @return 0 on success, -ENOMEM if the body does not fit or the queue is full
+ */
+int app_events_post(const char *type, int64_t uptime_ms, bool urgent, const char *fmt, ...);
+
+/**
+ * Send all queued events to Golioth. Called from the upload loop.
+ *
+ * Stops at the first event that fails to upload, which is kept at the head of
+ * the queue and sent again on the next call.
+ */
+void app_events_flush(struct golioth_client *client);
+
+#endif /* __APP_EVENTS_H__ */
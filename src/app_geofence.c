@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_geofence, LOG_LEVEL_DBG);
+
+#include <golioth/client.h>
+#include <golioth/lightdb_state.h>
+#include <zephyr/kernel.h>
+
+#include "app_events.h"
+#include "app_geofence.h"
+#include "format_helper.h"
+#include "geofence.h"
+
+static struct golioth_client *client;
+
+K_MUTEX_DEFINE(geofence_mutex);
+/* Uptime at which the evaluated fix was received, protected by geofence_mutex */
+static int64_t _fix_uptime_ms;
+
+static void post_event(int32_t id, bool enter, const struct track_point *pt)
+{
+	const char *event = enter ? "enter" : "exit";
+	char lat_str[FORMAT_COORD_LEN];
+	char lon_str[FORMAT_COORD_LEN];
+
+	format_coord_e7(lat_str, sizeof(lat_str), pt->lat);
+	format_coord_e7(lon_str, sizeof(lon_str), pt->lon);
+
+	LOG_INF("Geofence %d: %s", id, event);
+
+	/* Crossed when the fix was received, not when the RMC thread got to it */
+	app_events_post("geofence", _fix_uptime_ms, true,
+			"\"id\":%d,\"event\":\"%s\",\"lat\":%s,\"lon\":%s", id, event, lat_str,
+			lon_str);
+}
+
+void app_geofence_evaluate(const struct track_point *pt, int64_t uptime_ms)
+{
+	/*
+	 * Fake positions must not trigger alerts, nor positions dead-reckoned
+	 * through a tunnel or garage, which drift for up to
+	 * CONFIG_APP_FUSION_MAX_DR_S. Fences are checked again from the next
+	 * valid fix.
+	 */
+	if (pt->flags & (TRACK_POINT_FAKE | TRACK_POINT_ESTIMATED)) {
+		return;
+	}
+
+	k_mutex_lock(&geofence_mutex, K_FOREVER);
+	_fix_uptime_ms = uptime_ms;
+	geofence_evaluate(pt, post_event);
+	k_mutex_unlock(&geofence_mutex);
+}
+
+static void geofence_handler(struct golioth_client *client, enum golioth_status status,
+			     const struct golioth_coap_rsp_code *coap_rsp_code, const char *path,
+			     const uint8_t *payload, size_t payload_size, void *arg)
+{
+	int err;
+
+	if (status != GOLIOTH_OK) {
+		LOG_ERR("Failed to receive '%s' endpoint: %d", APP_GEOFENCE_ENDP, status);
+		return;
+	}
+
+	k_mutex_lock(&geofence_mutex, K_FOREVER);
+	err = geofence_load(payload, payload_size);
+	k_mutex_unlock(&geofence_mutex);
+
+	if (err) {
+		LOG_ERR("Error loading geofences, all geofences disabled: %d", err);
+	}
+}
+
+int app_geofence_observe(struct golioth_client *geofence_client)
+{
+	int err;
+
+	client = geofence_client;
+
+	err = golioth_lightdb_observe_async(client, APP_GEOFENCE_ENDP, GOLIOTH_CONTENT_TYPE_CBOR,
+					    geofence_handler, NULL);
+	if (err) {
+		LOG_WRN("failed to observe lightdb path: %d", err);
+	}
+
+	return err;
+}
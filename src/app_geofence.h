@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/** On-device geofencing.
+ *
+ * Geofences are read from the `geofences` LightDB State endpoint, which the
+ * device observes so that changes take effect immediately:
+ *
+ *   {
+ *     "version": 3,
+ *     "fences": [
+ *       {"id": 1, "lat": 37.78998, "lon": -122.40086, "radius": 150},
+ *       {"id": 2, "poly": [[37.1, -122.1], [37.2, -122.1], [37.2, -122.2]]}
+ *     ]
+ *   }
+ *
+ * Fences are indexed in a uniform grid (hashed into a fixed number of
+ * buckets), so each fix is only tested against the fences near it and the
+ * evaluation time does not grow with the total number of fences.
+ *
+ * Entering or leaving a fence queues an urgent `geofence` event (see
+ * app_events.h). Only valid GNSS fixes are evaluated, not fake or
+ * dead-reckoned positions.
+ *
+ * https://docs.golioth.io/firmware/zephyr-device-sdk/light-db/
+ */
+
+#ifndef __APP_GEOFENCE_H__
+#define __APP_GEOFENCE_H__
+
+#include <golioth/client.h>
+#include "track_codec.h"
+
+#define APP_GEOFENCE_ENDP "geofences"
+
+int app_geofence_observe(struct golioth_client *geofence_client);
+
+/**
+ * Check a new position against the geofences and queue enter/exit events.
+ *
+ * @param pt position to check
+ * @param uptime_ms uptime in milliseconds at which the fix was received, used
+ *        as the time of the events
+ */
+void app_geofence_evaluate(const struct track_point *pt, int64_t uptime_ms);
+
+#endif /* __APP_GEOFENCE_H__ */
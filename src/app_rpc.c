@@ -9,11 +9,21 @@ LOG_MODULE_REGISTER(app_rpc, LOG_LEVEL_DBG);
 
 #include <golioth/client.h>
 #include <golioth/rpc.h>
+#include <string.h>
 #include <zephyr/logging/log_ctrl.h>
 #include <zephyr/sys/reboot.h>
 
+#ifdef CONFIG_NETWORK_INFO
 #include <network_info.h>
+#endif
 #include "app_rpc.h"
+#include "follow_mode.h"
+#include "main.h"
+#include "perf_stats.h"
+#include "route_replay.h"
+#include "runtime_monitor.h"
+#include "trace.h"
+#include "track_history.h"
 
 static void reboot_work_handler(struct k_work *work)
 {
@@ -31,6 +41,7 @@ static void reboot_work_handler(struct k_work *work)
 }
 K_WORK_DEFINE(reboot_work, reboot_work_handler);
 
+#ifdef CONFIG_NETWORK_INFO
 static enum golioth_rpc_status on_get_network_info(zcbor_state_t *request_params_array,
 						   zcbor_state_t *response_detail_map,
 						   void *callback_arg)
@@ -39,6 +50,7 @@ static enum golioth_rpc_status on_get_network_info(zcbor_state_t *request_params
 
 	return GOLIOTH_RPC_OK;
 }
+#endif /* CONFIG_NETWORK_INFO */
 
 static enum golioth_rpc_status on_set_log_level(zcbor_state_t *request_params_array,
 						zcbor_state_t *response_detail_map,
@@ -95,6 +107,194 @@ static enum golioth_rpc_status on_reboot(zcbor_state_t *request_params_array,
 	return GOLIOTH_RPC_OK;
 }
 
+#ifdef CONFIG_APP_FOLLOW_MODE
+static enum golioth_rpc_status on_follow(zcbor_state_t *request_params_array,
+					 zcbor_state_t *response_detail_map, void *callback_arg)
+{
+	double minutes;
+	double interval_s = 0;
+	bool published;
+	bool ok;
+
+	ok = zcbor_float_decode(request_params_array, &minutes) && (minutes >= 0) &&
+	     (minutes <= CONFIG_APP_FOLLOW_MODE_MAX_MIN);
+
+	/* The interval is optional */
+	if (ok && !zcbor_array_at_end(request_params_array)) {
+		ok = zcbor_float_decode(request_params_array, &interval_s) && (interval_s >= 1) &&
+		     (interval_s <= FOLLOW_MODE_MAX_INTERVAL_S);
+	}
+	if (!ok) {
+		LOG_ERR("Invalid follow parameters");
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	if ((uint32_t)minutes == 0) {
+		follow_mode_stop();
+		return GOLIOTH_RPC_OK;
+	}
+
+	published = follow_mode_start((uint32_t)minutes, (uint32_t)interval_s);
+
+	ok = zcbor_tstr_put_lit(response_detail_map, "interval_s") &&
+	     zcbor_float64_put(response_detail_map, (double)follow_mode_interval_ms() / 1000) &&
+	     zcbor_tstr_put_lit(response_detail_map, "published") &&
+	     zcbor_bool_put(response_detail_map, published);
+
+	return GOLIOTH_RPC_OK;
+}
+#endif /* CONFIG_APP_FOLLOW_MODE */
+
+#ifdef CONFIG_APP_HISTORY
+static enum golioth_rpc_status on_get_history(zcbor_state_t *request_params_array,
+					      zcbor_state_t *response_detail_map,
+					      void *callback_arg)
+{
+	double start_s;
+	double end_s;
+	double resolution_s;
+	int count;
+	bool ok;
+
+	ok = zcbor_float_decode(request_params_array, &start_s) &&
+	     zcbor_float_decode(request_params_array, &end_s) &&
+	     zcbor_float_decode(request_params_array, &resolution_s);
+	if (!ok) {
+		LOG_ERR("Failed to decode array items");
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	count = track_history_request((int64_t)(start_s * 1000), (int64_t)(end_s * 1000),
+				      (int64_t)(resolution_s * 1000));
+	if (count < 0) {
+		LOG_ERR("Invalid history range");
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	/* Points are streamed from the main loop, so this RPC can return right away */
+	wake_system_thread();
+
+	ok = zcbor_tstr_put_lit(response_detail_map, "points") &&
+	     zcbor_float64_put(response_detail_map, (double)count);
+
+	return GOLIOTH_RPC_OK;
+}
+#endif /* CONFIG_APP_HISTORY */
+
+#ifdef CONFIG_APP_PERF_STATS
+static enum golioth_rpc_status on_get_perf_stats(zcbor_state_t *request_params_array,
+						 zcbor_state_t *response_detail_map,
+						 void *callback_arg)
+{
+	if (!perf_stats_add_to_map(response_detail_map)) {
+		LOG_ERR("Perf stats do not fit in the RPC response");
+		return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+	}
+
+	return GOLIOTH_RPC_OK;
+}
+#endif /* CONFIG_APP_PERF_STATS */
+
+#ifdef CONFIG_APP_RUNTIME_MONITOR
+static enum golioth_rpc_status on_get_runtime_stats(zcbor_state_t *request_params_array,
+						    zcbor_state_t *response_detail_map,
+						    void *callback_arg)
+{
+	if (!runtime_monitor_add_to_map(response_detail_map)) {
+		LOG_ERR("Runtime stats do not fit in the RPC response");
+		return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+	}
+
+	return GOLIOTH_RPC_OK;
+}
+#endif /* CONFIG_APP_RUNTIME_MONITOR */
+
+#ifdef CONFIG_APP_TRACE
+static enum golioth_rpc_status on_trace(zcbor_state_t *request_params_array,
+					zcbor_state_t *response_detail_map, void *callback_arg)
+{
+	struct zcbor_string cmd;
+	int count;
+	bool ok;
+
+	ok = zcbor_tstr_decode(request_params_array, &cmd);
+	if (!ok) {
+		LOG_ERR("Failed to decode array item");
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	count = trace_command((const char *)cmd.value, cmd.len);
+	if (count < 0) {
+		LOG_ERR("Unknown trace command: %.*s", (int)cmd.len, (const char *)cmd.value);
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	/* A download is streamed from the main loop, so this RPC can return right away */
+	wake_system_thread();
+
+	ok = zcbor_tstr_put_lit(response_detail_map, "records") &&
+	     zcbor_float64_put(response_detail_map, (double)count);
+
+	return GOLIOTH_RPC_OK;
+}
+#endif /* CONFIG_APP_TRACE */
+
+#ifdef CONFIG_APP_ROUTE_REPLAY
+static enum golioth_rpc_status on_route_replay(zcbor_state_t *request_params_array,
+					       zcbor_state_t *response_detail_map,
+					       void *callback_arg)
+{
+	struct zcbor_string cmd;
+	struct zcbor_string route = {.value = NULL, .len = 0};
+	double rate_hz = 0;
+	int count;
+	bool ok;
+
+	ok = zcbor_tstr_decode(request_params_array, &cmd);
+	if (!ok) {
+		LOG_ERR("Failed to decode array item");
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	if ((cmd.len == 4) && (strncmp((const char *)cmd.value, "stop", cmd.len) == 0)) {
+		route_replay_stop();
+		return GOLIOTH_RPC_OK;
+	}
+
+	if ((cmd.len == 4) && (strncmp((const char *)cmd.value, "load", cmd.len) == 0)) {
+		ok = zcbor_tstr_decode(request_params_array, &route);
+	} else if ((cmd.len != 5) || (strncmp((const char *)cmd.value, "start", cmd.len) != 0)) {
+		ok = false;
+	}
+
+	/* The rate is optional */
+	if (ok && !zcbor_array_at_end(request_params_array)) {
+		ok = zcbor_float_decode(request_params_array, &rate_hz) && (rate_hz >= 1) &&
+		     (rate_hz <= ROUTE_REPLAY_MAX_RATE_HZ);
+	}
+	if (!ok) {
+		LOG_ERR("Invalid route_replay parameters");
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	count = route_replay_start((const char *)route.value, route.len, (uint32_t)rate_hz);
+	if (count == -ENOMEM) {
+		LOG_ERR("Route has more than %d waypoints", CONFIG_APP_ROUTE_REPLAY_MAX_WAYPOINTS);
+		return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+	} else if (count < 0) {
+		LOG_ERR("Invalid route: %d", count);
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	ok = zcbor_tstr_put_lit(response_detail_map, "waypoints") &&
+	     zcbor_float64_put(response_detail_map, (double)count) &&
+	     zcbor_tstr_put_lit(response_detail_map, "length_m") &&
+	     zcbor_float64_put(response_detail_map, (double)route_replay_length_m());
+
+	return GOLIOTH_RPC_OK;
+}
+#endif /* CONFIG_APP_ROUTE_REPLAY */
+
 static void rpc_log_if_register_failure(int err)
 {
 	if (err) {
@@ -108,12 +308,44 @@ void app_rpc_register(struct golioth_client *client)
 
 	int err;
 
-	err = golioth_rpc_register(rpc, "get_network_info", on_get_network_info, NULL);
-	rpc_log_if_register_failure(err);
+	IF_ENABLED(CONFIG_NETWORK_INFO, (
+		err = golioth_rpc_register(rpc, "get_network_info", on_get_network_info, NULL);
+		rpc_log_if_register_failure(err);
+	));
+
+	IF_ENABLED(CONFIG_APP_PERF_STATS, (
+		err = golioth_rpc_register(rpc, "get_perf_stats", on_get_perf_stats, NULL);
+		rpc_log_if_register_failure(err);
+	));
+
+	IF_ENABLED(CONFIG_APP_RUNTIME_MONITOR, (
+		err = golioth_rpc_register(rpc, "get_runtime_stats", on_get_runtime_stats, NULL);
+		rpc_log_if_register_failure(err);
+	));
 
 	err = golioth_rpc_register(rpc, "reboot", on_reboot, NULL);
 	rpc_log_if_register_failure(err);
 
 	err = golioth_rpc_register(rpc, "set_log_level", on_set_log_level, NULL);
 	rpc_log_if_register_failure(err);
+
+	IF_ENABLED(CONFIG_APP_TRACE, (
+		err = golioth_rpc_register(rpc, "trace", on_trace, NULL);
+		rpc_log_if_register_failure(err);
+	));
+
+	IF_ENABLED(CONFIG_APP_HISTORY, (
+		err = golioth_rpc_register(rpc, "get_history", on_get_history, NULL);
+		rpc_log_if_register_failure(err);
+	));
+
+	IF_ENABLED(CONFIG_APP_ROUTE_REPLAY, (
+		err = golioth_rpc_register(rpc, "route_replay", on_route_replay, NULL);
+		rpc_log_if_register_failure(err);
+	));
+
+	IF_ENABLED(CONFIG_APP_FOLLOW_MODE, (
+		err = golioth_rpc_register(rpc, "follow", on_follow, NULL);
+		rpc_log_if_register_failure(err);
+	));
 }
@@ -18,13 +18,33 @@ LOG_MODULE_REGISTER(app_sensors, LOG_LEVEL_DBG);
 #include <zephyr/drivers/can.h>
 #include <zephyr/sys/byteorder.h>
 
+#include "app_events.h"
+#include "app_geofence.h"
 #include "app_sensors.h"
 #include "app_settings.h"
+#include "app_stats.h"
+#include "app_trip.h"
+#include "fix_window.h"
+#include "follow_mode.h"
+#include "format_helper.h"
+#include "fusion.h"
+#include "geo_helper.h"
+#include "gnss_power.h"
+#include "harsh_driving.h"
+#include "perf_stats.h"
+#include "runtime_monitor.h"
+#include "report_policy.h"
+#include "route_replay.h"
+#include "signal_agg.h"
+#include "time_base.h"
+#include "trace.h"
+#include "track_history.h"
+#include "track_queue.h"
+#include "track_simplify.h"
 #include "lib/minmea/minmea.h"
 
 #ifdef CONFIG_LIB_OSTENTUS
-#include <libostentus.h>
-static const struct device *o_dev = DEVICE_DT_GET_ANY(golioth_ostentus);
+#include "display_cache.h"
 #endif
 #ifdef CONFIG_ALUDEL_BATTERY_MONITOR
 #include "battery_monitor/battery.h"
@@ -49,14 +69,20 @@ static const struct device *const uart_dev = DEVICE_DT_GET(UART_DEVICE_NODE);
 static const struct gpio_dt_spec gnss7_sel = GPIO_DT_SPEC_GET(UART_SEL, gpios);
 
 static const struct device *const can_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
-
-struct can_asset_tracker_data {
-	struct minmea_sentence_rmc rmc_frame;
-	int vehicle_speed;
+K_SEM_DEFINE(can_sleep_sem, 0, 1);
+/* Set when a frame is seen while sleeping, the semaphore is also given by settings changes */
+static atomic_t can_activity;
+
+/* An RMC sentence and the uptime at which it was received */
+struct rmc_reading {
+	struct minmea_sentence_rmc frame;
+	int64_t uptime_ms;
+#ifdef CONFIG_APP_PERF_STATS
+	perf_ts_t queued;
+#endif
 };
 
-K_MSGQ_DEFINE(cat_msgq, sizeof(struct can_asset_tracker_data), 64, 4);
-K_MSGQ_DEFINE(rmc_msgq, sizeof(struct minmea_sentence_rmc), 2, 4);
+K_MSGQ_DEFINE(rmc_msgq, sizeof(struct rmc_reading), 2, 4);
 CAN_MSGQ_DEFINE(can_msgq, 2);
 
 #define PROCESS_CAN_FRAMES_THREAD_STACK_SIZE 2048
@@ -76,89 +102,228 @@ K_THREAD_STACK_DEFINE(process_rmc_frames_thread_stack, PROCESS_RMC_FRAMES_THREAD
 K_MUTEX_DEFINE(shared_data_mutex);
 static int g_vehicle_speed = -1;
 
-/* Formatting strings for sending sensor JSON to Golioth */
-/* clang-format off */
-#define JSON_FMT \
-"{" \
-	"\"time\":\"%s\"," \
-	"\"gps\":" \
-	"{" \
-		"\"lat\":%s," \
-		"\"lon\":%s," \
-		"\"fake\":%s" \
-	"}," \
-	"\"vehicle\":" \
-	"{" \
-		"\"speed\":%d" \
-	"}" \
-"}"
-#define JSON_FMT_FAKE_GPS \
-"{" \
-	"\"gps\":" \
-	"{" \
-		"\"lat\":%s," \
-		"\"lon\":%s," \
-		"\"fake\":%s" \
-	"}," \
-	"\"vehicle\":" \
-	"{" \
-		"\"speed\":%d" \
-	"}" \
-"}"
-/* clang-format on */
-
-/**
- * Convert a floating point coordinate value to a minmea_float coordinate.
- *
- * NMEA latitude is represented as [+-]DDMM.MMMM... [-90.0, 90.0]
- * NMEA longitude is represented as [+-]DDDMM.MMMM... [-180.0, 180.0]
- *
- * For example, a float -123.456789 will be be converted to:
- *   degrees = -123
- *   minutes = -0.456789 * 60 = -27.40734
- *   NMEA = (degrees * 100) + minutes = -12327.40734
- *
- * minmea_float stores the .value as a int_least32_t with a .scale factor:
- *   .value = (int_least32_t)(NMEA * .scale)
- *
- * So, NMEA -12327.40734 will be converted to:
- *   .value = -1232740734
- *   .scale = 100000
- *
- * 100000 scaling factor provides 5 digits of precision (±2cm LSB at the
- * equator) for the minutes value.
+/* Every sample of the polled CAN signals, rolled up once per upload window */
+SIGNAL_AGG_DEFINE(vehicle_speed_agg, "speed", 20);
+static struct signal_agg *const signal_aggs[] = {&vehicle_speed_agg};
+
+
+/* UTC time of a valid RMC frame in milliseconds since the epoch, or 0 if unknown */
+static int64_t rmc_time_ms(const struct minmea_sentence_rmc *rmc_frame)
+{
+	struct timespec ts;
+
+	if (!rmc_frame->valid || minmea_gettime(&ts, &rmc_frame->date, &rmc_frame->time)) {
+		return 0;
+	}
+
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void can_activity_cb(const struct device *dev, struct can_frame *frame, void *user_data)
+{
+	atomic_set(&can_activity, 1);
+	k_sem_give(&can_sleep_sem);
+}
+
+void app_sensors_wake_can(void)
+{
+	k_sem_give(&can_sleep_sem);
+}
+
+static int can_set_mode_restart(can_mode_t mode)
+{
+	int err;
+
+	err = can_stop(can_dev);
+	if (err && (err != -EALREADY)) {
+		return err;
+	}
+
+	err = can_set_mode(can_dev, mode);
+	if (err) {
+		return err;
+	}
+
+	return can_start(can_dev);
+}
+
+/*
+ * Stop polling a bus that does not reply. The controller only listens until
+ * any frame is seen on the bus, so neither the transceiver nor the vehicle
+ * gateways are kept awake by our requests.
  *
- * Note: 5 digits of precision is the max we can use. If we were to try to use
- * 6 digits of precision (a scaling factor of 1000000), NMEA -12327.40734 would
- * be converted to .value = -12327407340, which would overflow int32_t:
- *   INT32_MIN =  -2147483648
- *   .value    = -12327407340 <- overflow!
+ * The bus is only considered asleep (ignition off) once it stays silent for
+ * CONFIG_APP_CAN_SLEEP_POLL_S. Traffic seen before then means the ECU simply
+ * does not answer our requests, and polling resumes without any event.
  */
-static inline int coord_to_minmea(struct minmea_float *f, float coord)
+static void can_sleep_until_activity(void)
 {
-	int32_t degrees = (int32_t)coord;
-	float minutes = (coord - degrees) * 60;
-
-	/* Convert degrees to NMEA [+-]DDDMM.MMMMM format */
-	degrees *= 100;
-
-	/**
-	 * Use 100000 as the scaling factor so that we can store up to 5 decimal
-	 * places of minutes in minmea_float.value
-	 */
-	degrees *= 100000;
-	minutes *= 100000;
-
-	/* Make sure we don't overflow int32_t */
-	if (minutes < INT32_MIN || minutes > (float)(INT32_MAX - 1)) {
-		return -ERANGE;
+	const struct can_filter std_filter = {.flags = 0U, .id = 0, .mask = 0};
+	const struct can_filter ext_filter = {.flags = CAN_FILTER_IDE, .id = 0, .mask = 0};
+	int std_filter_id;
+	int ext_filter_id;
+	can_mode_t cap = 0;
+	int64_t listen_start;
+	bool asleep = false;
+	int err;
+
+	LOG_INF("No reply on CAN bus, stop polling until bus activity");
+
+	can_get_capabilities(can_dev, &cap);
+	if (cap & CAN_MODE_LISTENONLY) {
+		err = can_set_mode_restart(CAN_MODE_LISTENONLY);
+		if (err) {
+			LOG_ERR("Unable to switch CAN controller to listen-only mode: %d", err);
+		}
+	}
+
+	/* Before the filters, so that no frame is missed */
+	atomic_clear(&can_activity);
+	k_sem_reset(&can_sleep_sem);
+	listen_start = k_uptime_get();
+
+	std_filter_id = can_add_rx_filter(can_dev, can_activity_cb, NULL, &std_filter);
+	ext_filter_id = can_add_rx_filter(can_dev, can_activity_cb, NULL, &ext_filter);
+	if ((std_filter_id < 0) && (ext_filter_id < 0)) {
+		/* Activity can not be detected, wait for one period and poll again */
+		LOG_ERR("Unable to add CAN activity filter: %d", std_filter_id);
+		k_sem_take(&can_sleep_sem, K_SECONDS(CONFIG_APP_CAN_SLEEP_POLL_S));
 	}
 
-	/* minmea_float uses int_least32_t internally */
-	f->value = (int_least32_t)(degrees + minutes);
-	f->scale = 100000;
+	while ((std_filter_id >= 0) || (ext_filter_id >= 0)) {
+		k_sem_take(&can_sleep_sem, K_SECONDS(CONFIG_APP_CAN_SLEEP_POLL_S));
+		if (atomic_get(&can_activity)) {
+			break;
+		}
+
+		if (!asleep) {
+			/* A settings change also wakes this thread up early */
+			if ((k_uptime_get() - listen_start) <
+			    (CONFIG_APP_CAN_SLEEP_POLL_S * 1000LL)) {
+				continue;
+			}
+
+			asleep = true;
+			LOG_INF("CAN bus asleep");
+			app_events_post("ignition", listen_start, false, "\"on\":false");
+		}
+
+		/*
+		 * The vehicle is parked while the ignition is off, but follow mode
+		 * keeps the receiver on. A new standby delay or wake interval, or
+		 * follow mode starting or ending, applies right away. Polling
+		 * changes wait until polling resumes.
+		 */
+		app_settings_wait_change(APP_SETTINGS_CHANGED_GNSS_POWER, K_NO_WAIT);
+		gnss_power_update(follow_mode_active() ? -1 : 0);
+		app_trip_ignition_off(k_uptime_get());
+	}
+
+	if (std_filter_id >= 0) {
+		can_remove_rx_filter(can_dev, std_filter_id);
+	}
+	if (ext_filter_id >= 0) {
+		can_remove_rx_filter(can_dev, ext_filter_id);
+	}
+
+	if (cap & CAN_MODE_LISTENONLY) {
+		err = can_set_mode_restart(CAN_MODE_NORMAL);
+		if (err) {
+			LOG_ERR("Unable to switch CAN controller to normal mode: %d", err);
+		}
+	}
+
+	/* Drop anything received while listening, it does not answer a request */
+	k_msgq_purge(&can_msgq);
+
+	LOG_INF("Resume polling CAN bus");
+	if (asleep) {
+		app_events_post("ignition", k_uptime_get(), true, "\"on\":true");
+	}
+}
+
+/* Request the vehicle speed from the ECU, returns -1 if there is no reply */
+static int request_vehicle_speed(int64_t *sample_time)
+{
+	const struct can_frame vehicle_speed_request = {
+		.flags = 0,
+		.id = OBD2_PID_REQUEST_ID,
+		.dlc = 8,
+		.data = {ODB2_PID_REQUEST_DATA_LENGTH, OBD2_SERVICE_SHOW_CURRENT_DATA,
+			 ODB2_PID_VEHICLE_SPEED, 0xCC, /* not used (ISO 15765-2 suggests 0xCC) */
+			 0xCC, 0xCC, 0xCC, 0xCC}};
+	struct can_frame can_frame;
+	int vehicle_speed = -1;
+	perf_ts_t request_start;
+	uint8_t data_len;
+	int err;
+
+	/* This sending call is blocking until the message is sent. */
+	request_start = perf_stats_now();
+	trace_event(TRACE_CAN_TX_BEGIN, 0);
+	err = can_send(can_dev, &vehicle_speed_request, K_MSEC(100), NULL, NULL);
+	trace_event(TRACE_CAN_TX_END, err);
+	*sample_time = k_uptime_get();
+	if (err) {
+		LOG_ERR("Error sending CAN frame: %d", err);
+		return -1;
+	}
+
+	/* Wait up to 500ms for a response, stop at the first vehicle speed reply */
+	while ((vehicle_speed < 0) && (k_msgq_get(&can_msgq, &can_frame, K_MSEC(500)) == 0)) {
+		data_len = can_dlc_to_bytes(can_frame.dlc);
+		if ((data_len != OBD2_PID_RESPONSE_DLC) &&
+		    (data_len != ODB2_PID_VEHICLE_SPEED_DLC)) {
+			LOG_ERR("Wrong CAN frame data length: %u", data_len);
+			continue;
+		}
+
+		if ((can_frame.data[1] == (OBD2_SERVICE_SHOW_CURRENT_DATA + 0x40)) &&
+		    (can_frame.data[2] == ODB2_PID_VEHICLE_SPEED)) {
+			vehicle_speed = can_frame.data[3];
+			*sample_time = k_uptime_get();
+			perf_stats_record(PERF_STAGE_CAN_RTT, request_start);
+			trace_event(TRACE_CAN_RX, vehicle_speed);
+		}
+	}
+
+	return vehicle_speed;
+}
+
+/*
+ * Sleep until the next vehicle speed request is due. When the polling period
+ * is changed meanwhile, the request is rescheduled from the new period.
+ */
+static void sleep_until_next_request(int vehicle_speed, int64_t sample_time)
+{
+	int64_t period_ms;
+	uint32_t changed;
+
+	do {
+		if (((vehicle_speed > 0) || harsh_driving_busy()) && harsh_driving_enabled()) {
+			/* Sample fast enough to catch harsh acceleration and braking */
+			period_ms = CONFIG_APP_HARSH_POLL_MS;
+		} else {
+			period_ms = (int64_t)get_vehicle_speed_delay_s() * 1000;
+		}
+
+		/* The freshest fix published in follow mode carries a fresh speed */
+		if (follow_mode_active()) {
+			period_ms = MIN(period_ms, follow_mode_interval_ms());
+		}
+
+		runtime_monitor_loop_checkin(RUNTIME_MONITOR_LOOP_CAN,
+					     MAX(sample_time + period_ms - k_uptime_get(), 0));
 
-	return 0;
+		changed = app_settings_wait_change(APP_SETTINGS_CHANGED_VEHICLE_SPEED_DELAY |
+							   APP_SETTINGS_CHANGED_HARSH_DRIVING |
+							   APP_SETTINGS_CHANGED_GNSS_POWER,
+						   K_TIMEOUT_ABS_MS(sample_time + period_ms));
+		if (changed & APP_SETTINGS_CHANGED_GNSS_POWER) {
+			/* Apply a new standby delay or wake interval from the last sample */
+			gnss_power_update(follow_mode_active() ? -1 : vehicle_speed);
+		}
+	} while (changed != 0);
 }
 
 void process_can_frames_thread(void *arg1, void *arg2, void *arg3)
@@ -168,18 +333,12 @@ void process_can_frames_thread(void *arg1, void *arg2, void *arg3)
 	ARG_UNUSED(arg3);
 	int err;
 	int can_filter_id;
-	struct can_frame can_frame;
 	const struct can_filter can_filter = {
 		.flags = 0U, .id = OBD2_PID_RESPONSE_ID, .mask = CAN_STD_ID_MASK};
-	struct can_frame vehicle_speed_request = {
-		.flags = 0,
-		.id = OBD2_PID_REQUEST_ID,
-		.dlc = 8,
-		.data = {ODB2_PID_REQUEST_DATA_LENGTH, OBD2_SERVICE_SHOW_CURRENT_DATA,
-			 ODB2_PID_VEHICLE_SPEED, 0xCC, /* not used (ISO 15765-2 suggests 0xCC) */
-			 0xCC, 0xCC, 0xCC, 0xCC}};
 	int vehicle_speed;
-	uint8_t data_len;
+	int last_vehicle_speed = -1;
+	int64_t sample_time;
+	int missed_requests = 0;
 
 	/* Automatically put frames matching can_filter into can_msgq */
 	can_filter_id = can_add_rx_filter_msgq(can_dev, &can_msgq, &can_filter);
@@ -198,26 +357,15 @@ void process_can_frames_thread(void *arg1, void *arg2, void *arg3)
 	while (1) {
 		vehicle_speed = -1;
 
-		/* This sending call is blocking until the message is sent. */
-		err = can_send(can_dev, &vehicle_speed_request, K_MSEC(100), NULL, NULL);
-		if (err) {
-			LOG_ERR("Error sending CAN frame: %d", err);
+		/* Drop late replies to the previous request */
+		k_msgq_purge(&can_msgq);
+
+		if (route_replay_active()) {
+			/* The replayed route stands in for the ECU */
+			vehicle_speed = route_replay_speed();
+			sample_time = k_uptime_get();
 		} else {
-			/* Wait up to 500ms for a response (possibly multiple responses in queue) */
-			while (k_msgq_get(&can_msgq, &can_frame, K_MSEC(500)) == 0) {
-				data_len = can_dlc_to_bytes(can_frame.dlc);
-				if ((data_len != OBD2_PID_RESPONSE_DLC) &&
-				    (data_len != ODB2_PID_VEHICLE_SPEED_DLC)) {
-					LOG_ERR("Wrong CAN frame data length: %u", data_len);
-					continue;
-				}
-
-				if ((can_frame.data[1] ==
-				     (OBD2_SERVICE_SHOW_CURRENT_DATA + 0x40)) &&
-				    (can_frame.data[2] == ODB2_PID_VEHICLE_SPEED)) {
-					vehicle_speed = can_frame.data[3];
-				}
-			}
+			vehicle_speed = request_vehicle_speed(&sample_time);
 		}
 
 		/* Update shared global state */
@@ -231,19 +379,46 @@ void process_can_frames_thread(void *arg1, void *arg2, void *arg3)
 		g_vehicle_speed = vehicle_speed;
 		k_mutex_unlock(&shared_data_mutex);
 
-		/* Log vehicle speed */
-		LOG_DBG("Vehicle Speed Sensor: %d km/h", vehicle_speed);
+		/*
+		 * Put the GNSS receiver to sleep while parked, wake it up when moving.
+		 * Follow mode keeps it on, as an unknown speed does.
+		 */
+		gnss_power_update(follow_mode_active() ? -1 : vehicle_speed);
+		app_trip_speed(vehicle_speed, sample_time);
+		harsh_driving_sample(sample_time, vehicle_speed);
+		if (vehicle_speed >= 0) {
+			signal_agg_add(&vehicle_speed_agg, vehicle_speed);
+		}
 
-		/* Update Ostentus slide values */
-		IF_ENABLED(CONFIG_LIB_OSTENTUS, (
-			char vehicle_speed_str[9];
+		/* Speed is sampled several times per second while moving, only log changes */
+		if (vehicle_speed != last_vehicle_speed) {
+			last_vehicle_speed = vehicle_speed;
 
-			snprintk(vehicle_speed_str, sizeof(vehicle_speed_str), "%d km/h",
-				 vehicle_speed);
-			ostentus_slide_set(o_dev, VEHICLE_SPEED, vehicle_speed_str, strlen(vehicle_speed_str));
-		));
+			/* Log vehicle speed */
+			LOG_DBG("Vehicle Speed Sensor: %d km/h", vehicle_speed);
+
+			/* Update Ostentus slide values */
+			IF_ENABLED(CONFIG_LIB_OSTENTUS, (
+				char vehicle_speed_str[9];
+
+				snprintk(vehicle_speed_str, sizeof(vehicle_speed_str), "%d km/h",
+					 vehicle_speed);
+				display_cache_set(VEHICLE_SPEED, vehicle_speed_str);
+			));
+		}
+
+		if (vehicle_speed >= 0) {
+			missed_requests = 0;
+		} else if ((CONFIG_APP_CAN_SLEEP_MISSED_REQUESTS > 0) &&
+			   (++missed_requests >= CONFIG_APP_CAN_SLEEP_MISSED_REQUESTS)) {
+			/* Not polling while the bus is asleep, so no deadline either */
+			runtime_monitor_loop_pause(RUNTIME_MONITOR_LOOP_CAN);
+			can_sleep_until_activity();
+			missed_requests = 0;
+			continue;
+		}
 
-		k_sleep(K_SECONDS(get_vehicle_speed_delay_s()));
+		sleep_until_next_request(vehicle_speed, sample_time);
 	}
 }
 
@@ -253,11 +428,37 @@ void process_rmc_frames_thread(void *arg1, void *arg2, void *arg3)
 	ARG_UNUSED(arg2);
 	ARG_UNUSED(arg3);
 	int err;
-	struct minmea_sentence_rmc rmc_frame;
-	struct can_asset_tracker_data cat_frame;
-
-	while (k_msgq_get(&rmc_msgq, &rmc_frame, K_FOREVER) == 0) {
-		cat_frame.rmc_frame = rmc_frame;
+	struct rmc_reading reading;
+	struct minmea_sentence_rmc *rmc_frame = &reading.frame;
+	struct track_point point;
+	struct track_point retained[2];
+	struct geo_fix fix;
+	struct geo_fix fused;
+	struct report_policy_thresholds thresholds;
+	enum report_policy_result policy;
+	int retained_count;
+	int vehicle_speed;
+	int64_t now;
+	perf_ts_t fix_start;
+	char lat_str[FORMAT_COORD_LEN];
+	char lon_str[FORMAT_COORD_LEN];
+
+	while (k_msgq_get(&rmc_msgq, &reading, K_FOREVER) == 0) {
+		fix_start = perf_stats_now();
+		trace_event(TRACE_RMC_BEGIN, 0);
+		IF_ENABLED(CONFIG_APP_PERF_STATS,
+			   (perf_stats_record(PERF_STAGE_RMC_QUEUE, reading.queued);));
+		now = reading.uptime_ms;
+
+		err = geo_fix_from_rmc(&fix, rmc_frame);
+		if (err) {
+			/* No coordinates at all (no fix yet), treat it like an invalid fix */
+			fix.valid = false;
+		}
+		if (gnss_power_fix_received(fix.valid)) {
+			/* Report where the vehicle is after a wake-up, even if it is parked */
+			report_policy_reset();
+		}
 
 		/* Use the latest vehicle speed reading received from the ECU */
 		err = k_mutex_lock(&shared_data_mutex, K_MSEC(SHARED_DATA_MUTEX_TIMEOUT));
@@ -265,71 +466,158 @@ void process_rmc_frames_thread(void *arg1, void *arg2, void *arg3)
 			LOG_ERR("Error locking shared data mutex (lock count: %u): %d", err,
 				shared_data_mutex.lock_count);
 		}
-		cat_frame.vehicle_speed = g_vehicle_speed;
+		vehicle_speed = g_vehicle_speed;
 		k_mutex_unlock(&shared_data_mutex);
 
-		err = k_msgq_put(&cat_msgq, &cat_frame, K_NO_WAIT);
-		if (err) {
-			LOG_ERR("Unable to add cat_frame to cat_msgq: %d", err);
+		if (fix.valid) {
+			time_base_discipline(rmc_time_ms(rmc_frame), now, TIME_BASE_SOURCE_GNSS);
+		}
+
+		if (fusion_update(&fix, vehicle_speed, now, &fused) == 0) {
+			point.flags = fused.valid ? 0 : TRACK_POINT_ESTIMATED;
+		} else if (get_fake_gps_enabled_s() == true) {
+			/* use fake GPS coordinates from LightDB state */
+			err = geo_coord_to_minmea(&rmc_frame->latitude, get_fake_gps_latitude_s());
+			if (!err) {
+				err = geo_coord_to_minmea(&rmc_frame->longitude,
+							  get_fake_gps_longitude_s());
+			}
+			if (!err) {
+				err = geo_fix_from_rmc(&fused, rmc_frame);
+			}
+			if (err) {
+				LOG_ERR("Unable to convert fake GPS coordinates: %d", err);
+				trace_event(TRACE_RMC_END, -1);
+				continue;
+			}
+			fused.valid = false;
+			point.flags = TRACK_POINT_FAKE;
+		} else {
+			trace_event(TRACE_RMC_END, -1);
+			continue;
 		}
 
-		LOG_DBG("GPS Position%s: %f, %f", cat_frame.rmc_frame.valid ? "" : " (fake)",
-			(double)minmea_tocoord(&rmc_frame.latitude),
-			(double)minmea_tocoord(&rmc_frame.longitude));
+		/* Timestamp every point, not only valid fixes, from the time it was received */
+		point.time_ms = time_base_utc_ms(now);
+		point.lat = fused.lat;
+		point.lon = fused.lon;
+		point.speed = vehicle_speed;
+		point.seq = 0;
+
+		/* Geofences are checked on every fix, regardless of the reporting policy */
+		IF_ENABLED(CONFIG_APP_GEOFENCE, (app_geofence_evaluate(&point, now);));
+		app_trip_position(&point, &fused, now);
+		IF_ENABLED(CONFIG_APP_HISTORY, (track_history_add(&point);));
+		follow_mode_fix(&point, now);
+
+		/* Only fixes that cross the reporting dead-band and are needed to
+		 * keep the track within the simplification error bound are queued,
+		 * so fixes stay within REPORT_DISTANCE_M + TRACK_MAX_ERROR_M of the
+		 * uploaded track. The max interval heartbeat is always queued.
+		 */
+		thresholds.distance_m = get_report_distance_m();
+		thresholds.heading_deg = get_report_heading_deg();
+		thresholds.max_interval_s = get_report_max_interval_s();
+		policy = report_policy_check(&fused, &thresholds, now);
+		if (policy != REPORT_POLICY_SKIP) {
+			retained_count = track_simplify_push(&point, get_track_max_error_m(), now,
+							     (policy == REPORT_POLICY_HEARTBEAT),
+							     retained);
+		} else {
+			retained_count = track_simplify_poll(now, &retained[0]);
+		}
+		for (int i = 0; i < retained_count; i++) {
+			/* A dropped point keeps its number so the gap shows up */
+			retained[i].seq = app_stats_next_seq(APP_SEQ_TRACK);
+			err = track_queue_put(&retained[i]);
+			if (err) {
+				LOG_ERR("Unable to add point %u to track queue: %d",
+					retained[i].seq, err);
+				app_stats_inc(APP_STAT_TRACK_QUEUE_DROPS);
+			}
+		}
+		if (retained_count) {
+			perf_stats_queue_depth(PERF_QUEUE_TRACK, track_queue_used());
+		}
+		perf_stats_record(PERF_STAGE_FIX, fix_start);
+		trace_event(TRACE_RMC_END, point.flags);
+
+		format_coord_e7(lat_str, sizeof(lat_str), point.lat);
+		format_coord_e7(lon_str, sizeof(lon_str), point.lon);
+
+		if (point.flags & TRACK_POINT_FAKE) {
+			LOG_DBG("GPS Position (fake): %s, %s", lat_str, lon_str);
+		} else if (point.flags & TRACK_POINT_ESTIMATED) {
+			LOG_DBG("GPS Position (estimated): %s, %s", lat_str, lon_str);
+		} else {
+			LOG_DBG("GPS Position: %s, %s", lat_str, lon_str);
+		}
 
 		/* Update Ostentus slide values */
 		IF_ENABLED(CONFIG_LIB_OSTENTUS, (
-			char lat_str[12];
-			char lon_str[12];
-
-			snprintk(lat_str, sizeof(lat_str), "%f",
-				 (double) minmea_tocoord(&rmc_frame.latitude));
-			snprintk(lon_str, sizeof(lon_str), "%f",
-				 (double) minmea_tocoord(&rmc_frame.longitude));
-			ostentus_slide_set(o_dev, LATITUDE, lat_str, strlen(lat_str));
-			ostentus_slide_set(o_dev, LONGITUDE, lon_str, strlen(lon_str));
+			display_cache_set(LATITUDE, lat_str);
+			display_cache_set(LONGITUDE, lon_str);
 		));
 	}
 }
 
+/* Queue a reading for the RMC thread, safe to call from an ISR */
+static int queue_reading(struct rmc_reading *reading)
+{
+	int err;
+
+	IF_ENABLED(CONFIG_APP_PERF_STATS, (reading->queued = perf_stats_now();));
+	err = k_msgq_put(&rmc_msgq, reading, K_NO_WAIT);
+	trace_event(TRACE_ISR_RMC_QUEUED, err);
+	if (err) {
+		app_stats_inc(APP_STAT_GNSS_QUEUE_DROPS);
+	}
+	perf_stats_queue_depth(PERF_QUEUE_RMC, k_msgq_num_used_get(&rmc_msgq));
+
+	return err;
+}
+
+int app_sensors_inject_rmc(const struct minmea_sentence_rmc *frame, int64_t uptime_ms)
+{
+	struct rmc_reading reading = {
+		.frame = *frame,
+		.uptime_ms = uptime_ms,
+	};
+
+	return queue_reading(&reading);
+}
+
 /* This is called from the UART irq callback to try to get out fast */
 static void process_reading(char *raw_nmea)
 {
 	/* _last_gps timestamp records when the previous GPS value was stored */
-	static uint64_t _last_gps;
+	static int64_t _last_gps;
+	perf_ts_t parse_start = perf_stats_now();
 	enum minmea_sentence_id sid;
 	sid = minmea_sentence_id(raw_nmea, false);
-	if (sid == MINMEA_SENTENCE_RMC) {
-		struct minmea_sentence_rmc rmc_frame;
-		bool success = minmea_parse_rmc(&rmc_frame, raw_nmea);
+	/* Fixes come from the replayed route instead */
+	if ((sid == MINMEA_SENTENCE_RMC) && !route_replay_active()) {
+		struct rmc_reading reading;
+		bool success = minmea_parse_rmc(&reading.frame, raw_nmea);
+		perf_stats_record(PERF_STAGE_NMEA_PARSE, parse_start);
 		if (success) {
-			uint64_t wait_for = _last_gps;
-			if (k_uptime_delta(&wait_for) >= ((uint64_t)get_gps_delay_s() * 1000)) {
-				if (rmc_frame.valid == true) {
-					/* if queue is full, message is silently dropped */
-					k_msgq_put(&rmc_msgq, &rmc_frame, K_NO_WAIT);
-
-					/*
-					 * wait_for now contains the current timestamp. Store this
-					 * for the next reading.
-					 */
-					_last_gps = wait_for;
-				} else {
-					if (get_fake_gps_enabled_s() == true) {
-						/* use fake GPS coordinates from LightDB state */
-						coord_to_minmea(&rmc_frame.latitude,
-								get_fake_gps_latitude_s());
-						coord_to_minmea(&rmc_frame.longitude,
-								get_fake_gps_longitude_s());
-						k_msgq_put(&rmc_msgq, &rmc_frame, K_NO_WAIT);
-
-						/*
-						 * wait_for now contains the current timestamp.
-						 * Store this for the next reading.
-						 */
-						_last_gps = wait_for;
-					}
-				}
+			/* Start over the window from the new delay */
+			if (app_settings_wait_change(APP_SETTINGS_CHANGED_GPS_DELAY, K_NO_WAIT)) {
+				_last_gps = 0;
+			}
+
+			/* Follow mode takes every fix, and publishes them at its own interval */
+			if (fix_window_take(&_last_gps, k_uptime_get(),
+					    (int64_t)get_gps_delay_s() * MSEC_PER_SEC,
+					    follow_mode_active())) {
+				/*
+				 * Invalid frames are queued too: the processing thread
+				 * dead-reckons through fix gaps, or substitutes the fake
+				 * GPS coordinates. If queue is full, message is dropped
+				 * and counted.
+				 */
+				reading.uptime_ms = _last_gps;
+				queue_reading(&reading);
 			} else {
 				/* LOG_DBG("Ignoring reading due to gps_delay_s window"); */
 			}
@@ -344,6 +632,8 @@ void serial_cb(const struct device *dev, void *user_data)
 	static char rx_buf[NMEA_SIZE];
 	static int rx_buf_pos;
 
+	IF_ENABLED(CONFIG_APP_TRACE_UART_ISR, (trace_event(TRACE_ISR_UART, 0);));
+
 	if (!uart_irq_update(uart_dev)) {
 		return;
 	}
@@ -361,6 +651,7 @@ void serial_cb(const struct device *dev, void *user_data)
 				rx_buf[rx_buf_pos + 1] = '\0';
 			}
 
+			trace_event(TRACE_ISR_NMEA_LINE, rx_buf_pos);
 			process_reading(rx_buf);
 			/* reset the buffer (it was copied to the msgq) */
 			rx_buf_pos = 0;
@@ -390,6 +681,8 @@ void app_sensors_init(void)
 	uart_irq_callback_user_data_set(uart_dev, serial_cb, NULL);
 	uart_irq_rx_enable(uart_dev);
 
+	gnss_power_init(uart_dev);
+
 	LOG_DBG("Initializing CAN controller");
 
 	if (!device_is_ready(can_dev)) {
@@ -411,6 +704,8 @@ void app_sensors_init(void)
 		NULL, NULL, NULL, PROCESS_CAN_FRAMES_THREAD_PRIORITY, 0, K_NO_WAIT);
 	if (!process_can_frames_tid) {
 		LOG_ERR("Error spawning CAN frame processing thread");
+	} else {
+		k_thread_name_set(process_can_frames_tid, "can_frames");
 	}
 
 	/* Spawn a thread to process RMC frames */
@@ -420,6 +715,66 @@ void app_sensors_init(void)
 		NULL, NULL, NULL, PROCESS_RMC_FRAMES_THREAD_PRIORITY, 0, K_NO_WAIT);
 	if (!process_rmc_frames_tid) {
 		LOG_ERR("Error spawning RMC frame processing thread");
+	} else {
+		k_thread_name_set(process_rmc_frames_tid, "rmc_frames");
+	}
+
+	IF_ENABLED(CONFIG_APP_ROUTE_REPLAY, (route_replay_init();));
+}
+
+/* Stream one rollup of all CAN signals sampled since the previous call */
+static void stream_signal_rollups(void)
+{
+	char json_buf[CONFIG_APP_SIGNAL_AGG_MAX_LEN];
+	char ts_str[FORMAT_TIME_LEN];
+	int64_t time_ms = time_base_utc_ms(k_uptime_get());
+	size_t pos = 0;
+	size_t start;
+	int len;
+	int err;
+
+	/* The rollup is timestamped with the end of the window */
+	if (time_ms) {
+		format_time_ms(ts_str, sizeof(ts_str), time_ms);
+		pos = snprintk(json_buf, sizeof(json_buf), "{\"time\":\"%s\"", ts_str);
+	} else {
+		json_buf[pos++] = '{';
+	}
+	start = pos;
+
+	/* Leave room for the separator before each member and the closing brace */
+	for (size_t i = 0; i < ARRAY_SIZE(signal_aggs); i++) {
+		size_t sep = (pos > 1) ? 1 : 0;
+
+		len = signal_agg_rollup(signal_aggs[i], &json_buf[pos + sep],
+					sizeof(json_buf) - pos - sep - 1);
+		if (len < 0) {
+			return;
+		} else if (len > 0) {
+			if (sep) {
+				json_buf[pos] = ',';
+			}
+			pos += sep + len;
+		}
+	}
+
+	if (pos == start) {
+		/* Nothing was sampled in this window */
+		return;
+	}
+	json_buf[pos++] = '}';
+
+	err = golioth_stream_set_sync(client, "signals", GOLIOTH_CONTENT_TYPE_JSON, json_buf, pos,
+				      GOLIOTH_STREAM_TIMEOUT_S);
+	if (err) {
+		/* Not acknowledged, the next rollup covers this window too */
+		LOG_ERR("Failed to send signal rollup to Golioth: %d", err);
+		app_stats_inc(APP_STAT_STREAM_ERRORS);
+		return;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(signal_aggs); i++) {
+		signal_agg_ack(signal_aggs[i]);
 	}
 }
 
@@ -428,56 +783,63 @@ void app_sensors_init(void)
 void app_sensors_read_and_stream(void)
 {
 	int err;
-	struct can_asset_tracker_data cached_data;
-	char json_buf[256];
-	char ts_str[32];
-	char lat_str[12];
-	char lon_str[12];
+	struct track_point point;
+	char json_buf[FORMAT_TRACK_POINT_LEN];
+	perf_ts_t stage_start;
+	int64_t utc_now;
+
+	/* Fall back to the network time while there is no GNSS time */
+	time_base_update();
 
 	/* Golioth custom hardware for demos */
 	IF_ENABLED(CONFIG_ALUDEL_BATTERY_MONITOR, (
 		read_and_report_battery(client);
 		IF_ENABLED(CONFIG_LIB_OSTENTUS, (
-			ostentus_slide_set(o_dev,
-					   BATTERY_V,
-					   get_batt_v_str(),
-					   strlen(get_batt_v_str()));
-			ostentus_slide_set(o_dev,
-					   BATTERY_LVL,
-					   get_batt_lvl_str(),
-					   strlen(get_batt_lvl_str()));
+			display_cache_set(BATTERY_V, get_batt_v_str());
+			display_cache_set(BATTERY_LVL, get_batt_lvl_str());
 		));
 	));
 
-	while (k_msgq_get(&cat_msgq, &cached_data, K_NO_WAIT) == 0) {
-		snprintk(lat_str, sizeof(lat_str), "%f",
-			 (double) minmea_tocoord(&cached_data.rmc_frame.latitude));
-		snprintk(lon_str, sizeof(lon_str), "%f",
-			 (double) minmea_tocoord(&cached_data.rmc_frame.longitude));
-		snprintk(ts_str, sizeof(ts_str), "20%02d-%02d-%02dT%02d:%02d:%02d.%03dZ",
-			 cached_data.rmc_frame.date.year, cached_data.rmc_frame.date.month,
-			 cached_data.rmc_frame.date.day, cached_data.rmc_frame.time.hours,
-			 cached_data.rmc_frame.time.minutes, cached_data.rmc_frame.time.seconds,
-			 cached_data.rmc_frame.time.microseconds);
-
-		if (cached_data.rmc_frame.valid == true) {
-			/*
-			 * `time` will not appear in the `data` payload once received
-			 * by Golioth LightDB Stream, but instead will override the
-			 * `time` timestamp of the data.
-			 */
-			snprintk(json_buf, sizeof(json_buf), JSON_FMT, ts_str, lat_str, lon_str,
-				 "false", cached_data.vehicle_speed);
-		} else { /* Fake GPS data does not have a `time` field */
-			snprintk(json_buf, sizeof(json_buf), JSON_FMT_FAKE_GPS, lat_str, lon_str,
-				 "true", cached_data.vehicle_speed);
+	gnss_power_report(client);
+	stream_signal_rollups();
+
+	/* Events go out ahead of routine track points */
+	app_events_flush(client);
+
+	while (track_queue_get(&point) == 0) {
+		if (IS_ENABLED(CONFIG_APP_PERF_STATS) && (point.time_ms != 0)) {
+			utc_now = time_base_utc_ms(k_uptime_get());
+			perf_stats_record_us(PERF_STAGE_UPLOAD_AGE,
+					     (uint32_t)CLAMP((utc_now - point.time_ms) * 1000, 0,
+							     UINT32_MAX));
 		}
 
+		stage_start = perf_stats_now();
+		format_track_point_json(json_buf, sizeof(json_buf), &point);
+		perf_stats_record(PERF_STAGE_ENCODE, stage_start);
+
+		stage_start = perf_stats_now();
+		trace_event(TRACE_MAIN_STREAM_BEGIN, point.seq);
 		err = golioth_stream_set_sync(client, "tracker", GOLIOTH_CONTENT_TYPE_JSON,
 					      json_buf, strlen(json_buf), GOLIOTH_STREAM_TIMEOUT_S);
-		if (err)
-			LOG_ERR("Failed to send sensor data to Golioth: %d", err);
+		trace_event(TRACE_MAIN_STREAM_END, err);
+		perf_stats_record(PERF_STAGE_STREAM, stage_start);
+		if (err) {
+			LOG_ERR("Failed to send point %u to Golioth: %d", point.seq, err);
+			app_stats_inc(APP_STAT_TRACK_UPLOAD_ERRORS);
+		}
+
+		/* Don't hold back events raised while the backlog is uploading */
+		app_events_flush(client);
 	}
+
+	/* Points requested with the get_history RPC */
+	IF_ENABLED(CONFIG_APP_HISTORY, (track_history_stream(client);));
+
+	/* Trace records requested with the trace RPC */
+	IF_ENABLED(CONFIG_APP_TRACE, (trace_stream(client);));
+
+	app_stats_report(client);
 }
 
 void app_sensors_set_client(struct golioth_client *sensors_client)
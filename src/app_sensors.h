@@ -15,11 +15,28 @@
  */
 
 #include <golioth/client.h>
+#include "lib/minmea/minmea.h"
 
 void app_sensors_set_client(struct golioth_client *sensors_client);
 void app_sensors_read_and_stream(void);
 void app_sensors_init(void);
 
+/**
+ * Queue an RMC sentence for processing, as if received from the GNSS receiver.
+ *
+ * @param frame parsed RMC sentence
+ * @param uptime_ms uptime at which the sentence was received
+ *
+ * @return 0 on success, -ENOMSG if the queue is full (counted as a drop)
+ */
+int app_sensors_inject_rmc(const struct minmea_sentence_rmc *frame, int64_t uptime_ms);
+
+/**
+ * Wake the CAN thread if it is waiting for bus activity, to check the settings
+ * changes announced with app_settings_wait_change(). It then waits again.
+ */
+void app_sensors_wake_can(void);
+
 #define LABEL_LATITUDE	    "Latitude"
 #define LABEL_LONGITUDE	    "Longitude"
 #define LABEL_VEHICLE_SPEED "Speed"
@@ -39,7 +56,9 @@ typedef enum {
 	BATTERY_V,
 	BATTERY_LVL,
 #endif
-	FIRMWARE
+	FIRMWARE,
+	/* Number of slides, keep last */
+	SLIDE_KEY_COUNT
 } slide_key;
 
 #endif /* __APP_SENSORS_H__ */
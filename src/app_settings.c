@@ -7,11 +7,17 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(app_settings, LOG_LEVEL_DBG);
 
+#include <string.h>
 #include <golioth/client.h>
 #include <golioth/settings.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
 #include "main.h"
+#include "app_sensors.h"
 #include "app_settings.h"
 
+#define APP_SETTINGS_KEY "app"
+
 /* How long to wait between uploading to Golioth */
 static int32_t _loop_delay_s = 5;
 #define LOOP_DELAY_S_MAX 43200
@@ -40,6 +46,294 @@ static int32_t _vehicle_speed_delay_s = 1;
 #define VEHICLE_SPEED_DELAY_S_MAX 43200
 #define VEHICLE_SPEED_DELAY_S_MIN 0
 
+/* Report a fix after moving this far from the last reported fix */
+static int32_t _report_distance_m = 100;
+#define REPORT_DISTANCE_M_MAX 100000
+#define REPORT_DISTANCE_M_MIN 0
+
+/* Report a fix after the heading changes this much from the last reported fix */
+static int32_t _report_heading_deg = 20;
+#define REPORT_HEADING_DEG_MAX 180
+#define REPORT_HEADING_DEG_MIN 0
+
+/* Report a fix after this long even if the vehicle did not move */
+static int32_t _report_max_interval_s = 300;
+#define REPORT_MAX_INTERVAL_S_MAX 43200
+#define REPORT_MAX_INTERVAL_S_MIN 0
+
+/* Maximum distance between a dropped fix and the simplified track */
+static int32_t _track_max_error_m = 10;
+#define TRACK_MAX_ERROR_M_MAX 1000
+#define TRACK_MAX_ERROR_M_MIN 0
+
+/* Put the GNSS receiver in backup mode after the vehicle is stationary this long */
+static int32_t _gnss_standby_delay_s = 60;
+#define GNSS_STANDBY_DELAY_S_MAX 3600
+#define GNSS_STANDBY_DELAY_S_MIN 0
+
+/* Wake the GNSS receiver for a fix this often while the vehicle is stationary */
+static int32_t _gnss_wake_interval_s = 900;
+#define GNSS_WAKE_INTERVAL_S_MAX 86400
+#define GNSS_WAKE_INTERVAL_S_MIN 0
+
+/* Report harsh acceleration/braking above these limits (milli-g) */
+static int32_t _harsh_accel_mg = 300;
+#define HARSH_ACCEL_MG_MAX 2000
+#define HARSH_ACCEL_MG_MIN 0
+
+static int32_t _harsh_brake_mg = 400;
+#define HARSH_BRAKE_MG_MAX 2000
+#define HARSH_BRAKE_MG_MIN 0
+
+enum setting_type {
+	SETTING_INT,
+	SETTING_BOOL,
+	SETTING_FLOAT,
+};
+
+/*
+ * Settings applied from the cloud: saved to flash and restored at boot before
+ * the cloud syncs, and announced to the tasks that use them.
+ */
+struct setting_desc {
+	/* Golioth setting name, saved as APP_SETTINGS_KEY/<name> */
+	const char *name;
+	enum setting_type type;
+	void *value;
+	/* Range of the restored value, as the Golioth Settings Service checks it */
+	float min;
+	float max;
+	/* APP_SETTINGS_CHANGED_* bit posted when applied, 0 if read on every use */
+	uint32_t changed;
+};
+
+static const struct setting_desc settings_table[] = {
+	{"LOOP_DELAY_S", SETTING_INT, &_loop_delay_s, LOOP_DELAY_S_MIN, LOOP_DELAY_S_MAX, 0},
+	{"GPS_DELAY_S", SETTING_INT, &_gps_delay_s, GPS_DELAY_S_MIN, GPS_DELAY_S_MAX,
+	 APP_SETTINGS_CHANGED_GPS_DELAY},
+	{"FAKE_GPS_ENABLED", SETTING_BOOL, &_fake_gps_enabled_s, 0, 1, 0},
+	{"FAKE_GPS_LATITUDE", SETTING_FLOAT, &_fake_gps_latitude_s,
+	 FAKE_GPS_LATITUDE_S_MIN, FAKE_GPS_LATITUDE_S_MAX, 0},
+	{"FAKE_GPS_LONGITUDE", SETTING_FLOAT, &_fake_gps_longitude_s,
+	 FAKE_GPS_LONGITUDE_S_MIN, FAKE_GPS_LONGITUDE_S_MAX, 0},
+	{"VEHICLE_SPEED_DELAY_S", SETTING_INT, &_vehicle_speed_delay_s,
+	 VEHICLE_SPEED_DELAY_S_MIN, VEHICLE_SPEED_DELAY_S_MAX,
+	 APP_SETTINGS_CHANGED_VEHICLE_SPEED_DELAY},
+	{"REPORT_DISTANCE_M", SETTING_INT, &_report_distance_m,
+	 REPORT_DISTANCE_M_MIN, REPORT_DISTANCE_M_MAX, 0},
+	{"REPORT_HEADING_DEG", SETTING_INT, &_report_heading_deg,
+	 REPORT_HEADING_DEG_MIN, REPORT_HEADING_DEG_MAX, 0},
+	{"REPORT_MAX_INTERVAL_S", SETTING_INT, &_report_max_interval_s,
+	 REPORT_MAX_INTERVAL_S_MIN, REPORT_MAX_INTERVAL_S_MAX, 0},
+	{"TRACK_MAX_ERROR_M", SETTING_INT, &_track_max_error_m,
+	 TRACK_MAX_ERROR_M_MIN, TRACK_MAX_ERROR_M_MAX, 0},
+	{"GNSS_STANDBY_DELAY_S", SETTING_INT, &_gnss_standby_delay_s,
+	 GNSS_STANDBY_DELAY_S_MIN, GNSS_STANDBY_DELAY_S_MAX, APP_SETTINGS_CHANGED_GNSS_POWER},
+	{"GNSS_WAKE_INTERVAL_S", SETTING_INT, &_gnss_wake_interval_s,
+	 GNSS_WAKE_INTERVAL_S_MIN, GNSS_WAKE_INTERVAL_S_MAX, APP_SETTINGS_CHANGED_GNSS_POWER},
+	{"HARSH_ACCEL_MG", SETTING_INT, &_harsh_accel_mg, HARSH_ACCEL_MG_MIN, HARSH_ACCEL_MG_MAX,
+	 APP_SETTINGS_CHANGED_HARSH_DRIVING},
+	{"HARSH_BRAKE_MG", SETTING_INT, &_harsh_brake_mg, HARSH_BRAKE_MG_MIN, HARSH_BRAKE_MG_MAX,
+	 APP_SETTINGS_CHANGED_HARSH_DRIVING},
+};
+
+BUILD_ASSERT(ARRAY_SIZE(settings_table) <= 32, "Dirty settings are tracked in a 32-bit mask");
+
+K_MUTEX_DEFINE(persist_mutex);
+static K_EVENT_DEFINE(settings_changed);
+/* Values as last saved to (or restored from) flash, the defaults until then */
+static uint8_t _saved[ARRAY_SIZE(settings_table)][sizeof(int32_t)];
+static bool _saved_init;
+/* Settings whose value differs from _saved */
+static uint32_t _dirty;
+static int _restored;
+
+static size_t setting_size(const struct setting_desc *setting)
+{
+	return (setting->type == SETTING_BOOL) ? sizeof(bool) : sizeof(int32_t);
+}
+
+/* Called with persist_mutex held, before the first setting is restored or changed */
+static void init_saved(void)
+{
+	if (_saved_init) {
+		return;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(settings_table); i++) {
+		memcpy(_saved[i], settings_table[i].value, setting_size(&settings_table[i]));
+	}
+
+	_saved_init = true;
+}
+
+static void save_work_handler(struct k_work *work)
+{
+	uint8_t value[sizeof(int32_t)];
+	char key[sizeof(APP_SETTINGS_KEY) + SETTINGS_MAX_NAME_LEN];
+	size_t size;
+	int saved = 0;
+	int err;
+
+	k_mutex_lock(&persist_mutex, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(settings_table); i++) {
+		if (!(_dirty & BIT(i))) {
+			continue;
+		}
+
+		size = setting_size(&settings_table[i]);
+		memcpy(value, settings_table[i].value, size);
+		snprintk(key, sizeof(key), APP_SETTINGS_KEY "/%s", settings_table[i].name);
+
+		err = settings_save_one(key, value, size);
+		if (err) {
+			/* Stays dirty, and is retried with the next change */
+			LOG_ERR("Unable to save setting %s: %d", settings_table[i].name, err);
+			continue;
+		}
+
+		memcpy(_saved[i], value, size);
+		_dirty &= ~BIT(i);
+		saved++;
+	}
+
+	k_mutex_unlock(&persist_mutex);
+
+	LOG_DBG("Saved %d settings", saved);
+}
+
+static K_WORK_DELAYABLE_DEFINE(save_work, save_work_handler);
+
+static void post_changes(uint32_t changes)
+{
+	if (!changes) {
+		return;
+	}
+
+	k_event_post(&settings_changed, changes);
+
+	/* While the ignition is off, the CAN thread waits on the bus instead */
+	app_sensors_wake_can();
+}
+
+/*
+ * Called with the new value of a setting applied from the cloud. Only values
+ * that differ from flash are saved, once changes have settled, so the same
+ * values pushed again on every connection cost no flash writes.
+ */
+static void setting_applied(const void *value)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(settings_table); i++) {
+		if (settings_table[i].value != value) {
+			continue;
+		}
+
+		/* Tasks waiting on the previous value reschedule right away */
+		post_changes(settings_table[i].changed);
+
+		k_mutex_lock(&persist_mutex, K_FOREVER);
+		init_saved();
+
+		if (memcmp(value, _saved[i], setting_size(&settings_table[i])) != 0) {
+			_dirty |= BIT(i);
+		} else {
+			_dirty &= ~BIT(i);
+		}
+
+		if (_dirty) {
+			/* Not rescheduled, so a steady stream of changes is still saved */
+			k_work_schedule(&save_work, K_MSEC(CONFIG_APP_SETTINGS_SAVE_DELAY_MS));
+		}
+		k_mutex_unlock(&persist_mutex);
+		return;
+	}
+}
+
+static bool setting_in_range(const struct setting_desc *setting, const void *value)
+{
+	int32_t int_value;
+	float float_value;
+
+	switch (setting->type) {
+	case SETTING_INT:
+		memcpy(&int_value, value, sizeof(int_value));
+		return (int_value >= (int32_t)setting->min) && (int_value <= (int32_t)setting->max);
+	case SETTING_FLOAT:
+		memcpy(&float_value, value, sizeof(float_value));
+		/* Written so that NAN fails too */
+		return (float_value >= setting->min) && (float_value <= setting->max);
+	default:
+		return true;
+	}
+}
+
+static int app_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	uint8_t value[sizeof(int32_t)];
+	int ret;
+
+	for (size_t i = 0; i < ARRAY_SIZE(settings_table); i++) {
+		if (!settings_name_steq(name, settings_table[i].name, NULL)) {
+			continue;
+		}
+
+		if (len != setting_size(&settings_table[i])) {
+			LOG_WRN("Discarding saved %s of unexpected size %zu", settings_table[i].name, len);
+			return 0;
+		}
+
+		ret = read_cb(cb_arg, value, len);
+		if (ret < 0) {
+			return ret;
+		}
+
+		if (!setting_in_range(&settings_table[i], value)) {
+			LOG_WRN("Discarding saved %s out of range", settings_table[i].name);
+			return 0;
+		}
+
+		k_mutex_lock(&persist_mutex, K_FOREVER);
+		init_saved();
+		memcpy(settings_table[i].value, value, len);
+		memcpy(_saved[i], value, len);
+		k_mutex_unlock(&persist_mutex);
+		_restored++;
+
+		return 0;
+	}
+
+	/* A setting that is no longer used */
+	return -ENOENT;
+}
+
+static int app_settings_commit(void)
+{
+	if (_restored) {
+		LOG_INF("Restored %d settings from flash", _restored);
+	}
+
+	return 0;
+}
+
+/* Loaded before main() (CONFIG_GOLIOTH_SAMPLE_SETTINGS_AUTOLOAD), so before any thread starts */
+SETTINGS_STATIC_HANDLER_DEFINE(app, APP_SETTINGS_KEY, NULL, app_settings_set, app_settings_commit,
+			       NULL);
+
+uint32_t app_settings_wait_change(uint32_t changes, k_timeout_t timeout)
+{
+	uint32_t changed = k_event_wait(&settings_changed, changes, false, timeout);
+
+	k_event_clear(&settings_changed, changed);
+
+	return changed;
+}
+
+void app_settings_notify(uint32_t changes)
+{
+	post_changes(changes);
+}
+
 int32_t get_loop_delay_s(void)
 {
 	return _loop_delay_s;
@@ -70,11 +364,52 @@ int32_t get_vehicle_speed_delay_s(void)
 	return _vehicle_speed_delay_s;
 }
 
+int32_t get_report_distance_m(void)
+{
+	return _report_distance_m;
+}
+
+int32_t get_report_heading_deg(void)
+{
+	return _report_heading_deg;
+}
+
+int32_t get_report_max_interval_s(void)
+{
+	return _report_max_interval_s;
+}
+
+int32_t get_track_max_error_m(void)
+{
+	return _track_max_error_m;
+}
+
+int32_t get_gnss_standby_delay_s(void)
+{
+	return _gnss_standby_delay_s;
+}
+
+int32_t get_gnss_wake_interval_s(void)
+{
+	return _gnss_wake_interval_s;
+}
+
+int32_t get_harsh_accel_mg(void)
+{
+	return _harsh_accel_mg;
+}
+
+int32_t get_harsh_brake_mg(void)
+{
+	return _harsh_brake_mg;
+}
+
 static enum golioth_settings_status on_loop_delay_setting(int32_t new_value, void *arg)
 {
 	_loop_delay_s = new_value;
 	LOG_INF("Set loop delay to %i seconds", new_value);
 	wake_system_thread();
+	setting_applied(&_loop_delay_s);
 	return GOLIOTH_SETTINGS_SUCCESS;
 }
 
@@ -82,6 +417,7 @@ static enum golioth_settings_status on_gps_delay_setting(int32_t new_value, void
 {
 	_gps_delay_s = new_value;
 	LOG_INF("Set GPS delay to %i seconds", new_value);
+	setting_applied(&_gps_delay_s);
 	return GOLIOTH_SETTINGS_SUCCESS;
 }
 
@@ -89,6 +425,7 @@ static enum golioth_settings_status on_fake_gps_enabled_setting(bool new_value,
 {
 	_fake_gps_enabled_s = new_value;
 	LOG_INF("Enable fake GPS location: %s", new_value ? "true" : "false");
+	setting_applied(&_fake_gps_enabled_s);
 	return GOLIOTH_SETTINGS_SUCCESS;
 }
 
@@ -101,6 +438,7 @@ static enum golioth_settings_status on_fake_gps_latitude_setting(float new_value
 	}
 	_fake_gps_latitude_s = new_value;
 	LOG_INF("Set fake GPS latitude to %.5f degrees", (double) new_value);
+	setting_applied(&_fake_gps_latitude_s);
 	return GOLIOTH_SETTINGS_SUCCESS;
 }
 
@@ -113,6 +451,7 @@ static enum golioth_settings_status on_fake_gps_longitude_setting(float new_valu
 	}
 	_fake_gps_longitude_s = new_value;
 	LOG_INF("Set fake GPS longitude to %.5f degrees", (double) new_value);
+	setting_applied(&_fake_gps_longitude_s);
 	return GOLIOTH_SETTINGS_SUCCESS;
 }
 
@@ -120,6 +459,71 @@ static enum golioth_settings_status on_vehicle_speed_delay_setting(int32_t new_v
 {
 	_vehicle_speed_delay_s = new_value;
 	LOG_INF("Set vehicle speed delay to %i seconds", new_value);
+	setting_applied(&_vehicle_speed_delay_s);
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_report_distance_setting(int32_t new_value, void *arg)
+{
+	_report_distance_m = new_value;
+	LOG_INF("Set report distance to %i meters", new_value);
+	setting_applied(&_report_distance_m);
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_report_heading_setting(int32_t new_value, void *arg)
+{
+	_report_heading_deg = new_value;
+	LOG_INF("Set report heading change to %i degrees", new_value);
+	setting_applied(&_report_heading_deg);
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_report_max_interval_setting(int32_t new_value, void *arg)
+{
+	_report_max_interval_s = new_value;
+	LOG_INF("Set report max interval to %i seconds", new_value);
+	setting_applied(&_report_max_interval_s);
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_track_max_error_setting(int32_t new_value, void *arg)
+{
+	_track_max_error_m = new_value;
+	LOG_INF("Set track max error to %i meters", new_value);
+	setting_applied(&_track_max_error_m);
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_gnss_standby_delay_setting(int32_t new_value, void *arg)
+{
+	_gnss_standby_delay_s = new_value;
+	LOG_INF("Set GNSS standby delay to %i seconds", new_value);
+	setting_applied(&_gnss_standby_delay_s);
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_gnss_wake_interval_setting(int32_t new_value, void *arg)
+{
+	_gnss_wake_interval_s = new_value;
+	LOG_INF("Set GNSS wake interval to %i seconds", new_value);
+	setting_applied(&_gnss_wake_interval_s);
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_harsh_accel_setting(int32_t new_value, void *arg)
+{
+	_harsh_accel_mg = new_value;
+	LOG_INF("Set harsh acceleration threshold to %i mg", new_value);
+	setting_applied(&_harsh_accel_mg);
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_harsh_brake_setting(int32_t new_value, void *arg)
+{
+	_harsh_brake_mg = new_value;
+	LOG_INF("Set harsh braking threshold to %i mg", new_value);
+	setting_applied(&_harsh_brake_mg);
 	return GOLIOTH_SETTINGS_SUCCESS;
 }
 
@@ -165,4 +569,62 @@ void app_settings_register(struct golioth_client *client)
 	if (err) {
 		LOG_ERR("Failed to register on_vehicle_speed_delay_setting callback: %d", err);
 	}
+
+	err = golioth_settings_register_int_with_range(settings, "REPORT_DISTANCE_M",
+						       REPORT_DISTANCE_M_MIN, REPORT_DISTANCE_M_MAX,
+						       on_report_distance_setting, NULL);
+	if (err) {
+		LOG_ERR("Failed to register on_report_distance_setting callback: %d", err);
+	}
+
+	err = golioth_settings_register_int_with_range(settings, "REPORT_HEADING_DEG",
+						       REPORT_HEADING_DEG_MIN, REPORT_HEADING_DEG_MAX,
+						       on_report_heading_setting, NULL);
+	if (err) {
+		LOG_ERR("Failed to register on_report_heading_setting callback: %d", err);
+	}
+
+	err = golioth_settings_register_int_with_range(
+		settings, "REPORT_MAX_INTERVAL_S", REPORT_MAX_INTERVAL_S_MIN,
+		REPORT_MAX_INTERVAL_S_MAX, on_report_max_interval_setting, NULL);
+	if (err) {
+		LOG_ERR("Failed to register on_report_max_interval_setting callback: %d", err);
+	}
+
+	err = golioth_settings_register_int_with_range(settings, "TRACK_MAX_ERROR_M",
+						       TRACK_MAX_ERROR_M_MIN, TRACK_MAX_ERROR_M_MAX,
+						       on_track_max_error_setting, NULL);
+	if (err) {
+		LOG_ERR("Failed to register on_track_max_error_setting callback: %d", err);
+	}
+
+	err = golioth_settings_register_int_with_range(settings, "GNSS_STANDBY_DELAY_S",
+						       GNSS_STANDBY_DELAY_S_MIN,
+						       GNSS_STANDBY_DELAY_S_MAX,
+						       on_gnss_standby_delay_setting, NULL);
+	if (err) {
+		LOG_ERR("Failed to register on_gnss_standby_delay_setting callback: %d", err);
+	}
+
+	err = golioth_settings_register_int_with_range(settings, "GNSS_WAKE_INTERVAL_S",
+						       GNSS_WAKE_INTERVAL_S_MIN,
+						       GNSS_WAKE_INTERVAL_S_MAX,
+						       on_gnss_wake_interval_setting, NULL);
+	if (err) {
+		LOG_ERR("Failed to register on_gnss_wake_interval_setting callback: %d", err);
+	}
+
+	err = golioth_settings_register_int_with_range(settings, "HARSH_ACCEL_MG",
+						       HARSH_ACCEL_MG_MIN, HARSH_ACCEL_MG_MAX,
+						       on_harsh_accel_setting, NULL);
+	if (err) {
+		LOG_ERR("Failed to register on_harsh_accel_setting callback: %d", err);
+	}
+
+	err = golioth_settings_register_int_with_range(settings, "HARSH_BRAKE_MG",
+						       HARSH_BRAKE_MG_MIN, HARSH_BRAKE_MG_MAX,
+						       on_harsh_brake_setting, NULL);
+	if (err) {
+		LOG_ERR("Failed to register on_harsh_brake_setting callback: %d", err);
+	}
 }
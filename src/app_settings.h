@@ -16,6 +16,35 @@
 
 #include <stdint.h>
 #include <golioth/client.h>
+#include <zephyr/kernel.h>
+
+/*
+ * Posted when settings that periodic tasks schedule from are applied, see
+ * app_settings_wait_change(). Other settings are read again on every use.
+ */
+#define APP_SETTINGS_CHANGED_GPS_DELAY BIT(0)
+#define APP_SETTINGS_CHANGED_VEHICLE_SPEED_DELAY BIT(1)
+#define APP_SETTINGS_CHANGED_GNSS_POWER BIT(2)
+#define APP_SETTINGS_CHANGED_HARSH_DRIVING BIT(3)
+
+/**
+ * Wait until one of the @p changes settings is applied, so that a periodic
+ * task can reschedule its next deadline from the new value right away.
+ *
+ * A change stays pending until it is waited for, so a change applied while
+ * the task was busy is returned at once. Each change has a single subscriber,
+ * as waiting consumes it: GPS_DELAY the GNSS sentence handler, the others the
+ * CAN thread. Can be called from an ISR with K_NO_WAIT.
+ *
+ * @return the changes that were applied, 0 on timeout
+ */
+uint32_t app_settings_wait_change(uint32_t changes, k_timeout_t timeout);
+
+/**
+ * Announce a change of the rates tasks derive from settings, such as a
+ * temporary override, as if the @p changes settings were applied.
+ */
+void app_settings_notify(uint32_t changes);
 
 int32_t get_loop_delay_s(void);
 void app_settings_register(struct golioth_client *client);
@@ -24,5 +53,13 @@ bool get_fake_gps_enabled_s(void);
 float get_fake_gps_latitude_s(void);
 float get_fake_gps_longitude_s(void);
 int32_t get_vehicle_speed_delay_s(void);
+int32_t get_report_distance_m(void);
+int32_t get_report_heading_deg(void);
+int32_t get_report_max_interval_s(void);
+int32_t get_track_max_error_m(void);
+int32_t get_gnss_standby_delay_s(void);
+int32_t get_gnss_wake_interval_s(void);
+int32_t get_harsh_accel_mg(void);
+int32_t get_harsh_brake_mg(void);
 
 #endif /* __APP_SETTINGS_H__ */
@@ -7,6 +7,7 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(app_state, LOG_LEVEL_DBG);
 
+#include <stddef.h>
 #include <golioth/client.h>
 #include <golioth/lightdb_state.h>
 #include <zephyr/data/json.h>
@@ -16,13 +17,52 @@ LOG_MODULE_REGISTER(app_state, LOG_LEVEL_DBG);
 #include "app_state.h"
 #include "app_sensors.h"
 
-#define DEVICE_STATE_FMT "{\"example_int0\":%d,\"example_int1\":%d}"
-
-uint32_t _example_int0;
-uint32_t _example_int1 = 1;
+/* Desired value that requests no change */
+#define APP_STATE_NO_CHANGE -1
+
+struct app_state_field {
+	const char *name;
+	size_t offset;
+	int32_t min;
+	int32_t max;
+	/* Called with the new value once applied, may be NULL */
+	void (*on_change)(int32_t value);
+};
+
+#define APP_STATE_FIELD(_name, _default, _min, _max, _on_change)                                   \
+	{#_name, offsetof(struct app_state, _name), _min, _max, _on_change},
+#define APP_STATE_DEFAULT(_name, _default, _min, _max, _on_change) ._name = _default,
+#define APP_STATE_RESET(_name, _default, _min, _max, _on_change) ._name = APP_STATE_NO_CHANGE,
+/* Quotes, colon, sign and 10 digits, comma or closing brace */
+#define APP_STATE_FIELD_LEN(_name, _default, _min, _max, _on_change) +sizeof(#_name) + 15
+/* Opening brace and terminator, then each field */
+#define APP_STATE_JSON_LEN (2 APP_STATE_FIELDS(APP_STATE_FIELD_LEN))
+
+/* In the order of app_state_descr, so field i is bit i of json_obj_parse() */
+static const struct app_state_field fields[] = {APP_STATE_FIELDS(APP_STATE_FIELD)};
+
+BUILD_ASSERT(ARRAY_SIZE(fields) == ARRAY_SIZE(app_state_descr));
+BUILD_ASSERT(ARRAY_SIZE(fields) <= 32, "Changed fields are tracked in a 32-bit mask");
+
+/* Written to the desired endpoint once desired values are processed */
+static const struct app_state desired_reset = {APP_STATE_FIELDS(APP_STATE_RESET)};
+
+K_MUTEX_DEFINE(state_mutex);
+static struct app_state _state = {APP_STATE_FIELDS(APP_STATE_DEFAULT)};
+/* Writes waiting for write_work */
+static bool _actual_pending;
+static bool _desired_pending;
 
 static struct golioth_client *client;
 
+static void write_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(write_work, write_work_handler);
+
+static int32_t *field_value(struct app_state *state, size_t i)
+{
+	return (int32_t *)((uint8_t *)state + fields[i].offset);
+}
+
 static void async_handler(struct golioth_client *client,
 			  enum golioth_status status,
 			  const struct golioth_coap_rsp_code *coap_rsp_code,
@@ -37,17 +77,20 @@ static void async_handler(struct golioth_client *client,
 	LOG_DBG("State successfully set");
 }
 
-int app_state_reset_desired(void)
+static int write_state(const char *path, const struct app_state *state)
 {
-	LOG_INF("Resetting \"%s\" LightDB State endpoint to defaults.", APP_STATE_DESIRED_ENDP);
-
-	char sbuf[sizeof(DEVICE_STATE_FMT) + 4]; /* space for two "-1" values */
+	char sbuf[APP_STATE_JSON_LEN];
+	int err;
 
-	snprintk(sbuf, sizeof(sbuf), DEVICE_STATE_FMT, -1, -1);
+	err = json_obj_encode_buf(app_state_descr, ARRAY_SIZE(app_state_descr), state, sbuf,
+				  sizeof(sbuf));
+	if (err) {
+		LOG_ERR("Unable to encode LightDB State: %d", err);
+		return err;
+	}
 
-	int err;
 	err = golioth_lightdb_set_async(client,
-					APP_STATE_DESIRED_ENDP,
+					path,
 					GOLIOTH_CONTENT_TYPE_JSON,
 					sbuf,
 					strlen(sbuf),
@@ -59,27 +102,52 @@ int app_state_reset_desired(void)
 	return err;
 }
 
-int app_state_update_actual(void)
+/* Changes within CONFIG_APP_STATE_WRITE_DELAY_MS take one write per endpoint */
+static void write_work_handler(struct k_work *work)
 {
+	struct app_state actual;
+	bool update_actual;
+	bool reset_desired;
+
+	k_mutex_lock(&state_mutex, K_FOREVER);
+	actual = _state;
+	update_actual = _actual_pending;
+	reset_desired = _desired_pending;
+	_actual_pending = false;
+	_desired_pending = false;
+	k_mutex_unlock(&state_mutex);
+
+	if (update_actual) {
+		write_state(APP_STATE_ACTUAL_ENDP, &actual);
+	}
 
-	char sbuf[sizeof(DEVICE_STATE_FMT) + 10]; /* space for uint16 values */
+	if (reset_desired) {
+		/*
+		 * Return the processed desired values to -1 on the server to
+		 * indicate they were received.
+		 */
+		LOG_INF("Resetting \"%s\" LightDB State endpoint to defaults.",
+			APP_STATE_DESIRED_ENDP);
+		write_state(APP_STATE_DESIRED_ENDP, &desired_reset);
+	}
+}
 
-	snprintk(sbuf, sizeof(sbuf), DEVICE_STATE_FMT, _example_int0, _example_int1);
+static void schedule_write(bool update_actual, bool reset_desired)
+{
+	k_mutex_lock(&state_mutex, K_FOREVER);
+	_actual_pending |= update_actual;
+	_desired_pending |= reset_desired;
+	k_mutex_unlock(&state_mutex);
 
-	int err;
+	/* Not rescheduled, so a steady stream of updates is still written */
+	k_work_schedule(&write_work, K_MSEC(CONFIG_APP_STATE_WRITE_DELAY_MS));
+}
 
-	err = golioth_lightdb_set_async(client,
-					APP_STATE_ACTUAL_ENDP,
-					GOLIOTH_CONTENT_TYPE_JSON,
-					sbuf,
-					strlen(sbuf),
-					async_handler,
-					NULL);
+int app_state_update_actual(void)
+{
+	schedule_write(true, false);
 
-	if (err) {
-		LOG_ERR("Unable to write to LightDB State: %d", err);
-	}
-	return err;
+	return 0;
 }
 
 static void app_state_desired_handler(struct golioth_client *client, enum golioth_status status,
@@ -87,7 +155,11 @@ static void app_state_desired_handler(struct golioth_client *client, enum goliot
 				      const char *path, const uint8_t *payload, size_t payload_size,
 				      void *arg)
 {
-	int err = 0;
+	struct app_state parsed_state;
+	bool desired_processed = false;
+	uint32_t changed = 0;
+	int32_t value;
+	int32_t *stored;
 	int ret;
 
 	if (status != GOLIOTH_OK) {
@@ -97,70 +169,56 @@ static void app_state_desired_handler(struct golioth_client *client, enum goliot
 
 	LOG_HEXDUMP_DBG(payload, payload_size, APP_STATE_DESIRED_ENDP);
 
-	struct app_state parsed_state;
-
 	ret = json_obj_parse((char *)payload, payload_size, app_state_descr,
 			     ARRAY_SIZE(app_state_descr), &parsed_state);
 
 	if (ret < 0) {
 		LOG_ERR("Error parsing desired values: %d", ret);
-		app_state_reset_desired();
+		schedule_write(false, true);
 		return;
 	}
 
-	uint8_t desired_processed_count = 0;
-	uint8_t state_change_count = 0;
-
-	if (ret & 1 << 0) {
-		/* Process example_int0 */
-		if ((parsed_state.example_int0 >= 0) && (parsed_state.example_int0 < 65536)) {
-			LOG_DBG("Validated desired example_int0 value: %d",
-				parsed_state.example_int0);
-			if (_example_int0 != parsed_state.example_int0) {
-				_example_int0 = parsed_state.example_int0;
-				++state_change_count;
-			}
-			++desired_processed_count;
-		} else if (parsed_state.example_int0 == -1) {
-			LOG_DBG("No change requested for example_int0");
-		} else {
-			LOG_ERR("Invalid desired example_int0 value: %d",
-				parsed_state.example_int0);
-			++desired_processed_count;
+	k_mutex_lock(&state_mutex, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(fields); i++) {
+		if (!(ret & BIT(i))) {
+			continue;
 		}
-	}
-	if (ret & 1 << 1) {
-		/* Process example_int1 */
-		if ((parsed_state.example_int1 >= 0) && (parsed_state.example_int1 < 65536)) {
-			LOG_DBG("Validated desired example_int1 value: %d",
-				parsed_state.example_int1);
-			if (_example_int1 != parsed_state.example_int1) {
-				_example_int1 = parsed_state.example_int1;
-				++state_change_count;
-			}
-			++desired_processed_count;
-		} else if (parsed_state.example_int1 == -1) {
-			LOG_DBG("No change requested for example_int1");
-		} else {
-			LOG_ERR("Invalid desired example_int1 value: %d",
-				parsed_state.example_int1);
-			++desired_processed_count;
+
+		value = *field_value(&parsed_state, i);
+		if (value == APP_STATE_NO_CHANGE) {
+			LOG_DBG("No change requested for %s", fields[i].name);
+			continue;
 		}
-	}
 
-	if (state_change_count) {
-		/* The state was changed, so update the state on the Golioth servers */
-		err = app_state_update_actual();
+		/* Invalid values are reset too */
+		desired_processed = true;
+
+		if ((value < fields[i].min) || (value > fields[i].max)) {
+			LOG_ERR("Invalid desired %s value: %d", fields[i].name, value);
+			continue;
+		}
+
+		LOG_DBG("Validated desired %s value: %d", fields[i].name, value);
+
+		stored = field_value(&_state, i);
+		if (*stored != value) {
+			*stored = value;
+			changed |= BIT(i);
+		}
 	}
-	if (desired_processed_count) {
-		/* We processed some desired changes to return these to -1 on the server
-		 * to indicate the desired values were received.
-		 */
-		err = app_state_reset_desired();
+
+	k_mutex_unlock(&state_mutex);
+
+	for (size_t i = 0; i < ARRAY_SIZE(fields); i++) {
+		if ((changed & BIT(i)) && fields[i].on_change) {
+			fields[i].on_change(*field_value(&parsed_state, i));
+		}
 	}
 
-	if (err) {
-		LOG_ERR("Failed to update cloud state: %d", err);
+	if (changed || desired_processed) {
+		/* The state was changed, so update the state on the Golioth servers */
+		schedule_write(changed != 0, desired_processed);
 	}
 }
 
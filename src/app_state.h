@@ -17,6 +17,10 @@
  * processed, and update the actual state (`APP_STATE_ACTUAL_ENDP`) to report
  * the new state of the device.
  *
+ * The fields are declared in APP_STATE_FIELDS (json_helper.h). Desired updates
+ * received within CONFIG_APP_STATE_WRITE_DELAY_MS are answered with a single
+ * write to each endpoint.
+ *
  * The device should write to the _actual state_ endpoint, the cloud should not.
  * By convention the cloud should consider the _actual state_ values read-only.
  *
@@ -32,6 +36,11 @@
 #define APP_STATE_ACTUAL_ENDP  "state"
 
 int app_state_observe(struct golioth_client *state_client);
+
+/**
+ * Write the actual state, together with any other change made within
+ * CONFIG_APP_STATE_WRITE_DELAY_MS.
+ */
 int app_state_update_actual(void);
 
 #endif /* __APP_STATE_H__ */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_stats, LOG_LEVEL_DBG);
+
+#include <golioth/client.h>
+#include <golioth/lightdb_state.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "app_stats.h"
+
+/* clang-format off */
+#define STATS_FMT \
+"{" \
+	"\"uptime_s\":%u," \
+	"\"track_seq\":%u," \
+	"\"event_seq\":%u," \
+	"\"gnss_queue_drops\":%u," \
+	"\"track_queue_drops\":%u," \
+	"\"track_upload_errors\":%u," \
+	"\"event_queue_drops\":%u," \
+	"\"stream_errors\":%u" \
+"}"
+/* clang-format on */
+
+static atomic_t _seq[APP_SEQ_COUNT];
+static atomic_t _stats[APP_STAT_COUNT];
+
+/* Uptime of the last report, -1 before the first one */
+static int64_t _last_report_ms = -1;
+
+uint32_t app_stats_next_seq(enum app_seq seq)
+{
+	/* atomic_inc() returns the previous value */
+	return (uint32_t)atomic_inc(&_seq[seq]) + 1;
+}
+
+void app_stats_inc(enum app_stat stat)
+{
+	atomic_inc(&_stats[stat]);
+}
+
+uint32_t app_stats_last_seq(enum app_seq seq)
+{
+	return (uint32_t)atomic_get(&_seq[seq]);
+}
+
+uint32_t app_stats_get(enum app_stat stat)
+{
+	return (uint32_t)atomic_get(&_stats[stat]);
+}
+
+static void async_handler(struct golioth_client *client,
+			  enum golioth_status status,
+			  const struct golioth_coap_rsp_code *coap_rsp_code,
+			  const char *path,
+			  void *arg)
+{
+	if (status != GOLIOTH_OK) {
+		LOG_WRN("Failed to set stats: %d", status);
+		return;
+	}
+
+	LOG_DBG("Stats successfully set");
+}
+
+void app_stats_report(struct golioth_client *client)
+{
+	char sbuf[sizeof(STATS_FMT) + 9 * 10];
+	int64_t now = k_uptime_get();
+	int err;
+
+	if ((_last_report_ms >= 0) &&
+	    ((now - _last_report_ms) < (CONFIG_APP_STATS_REPORT_INTERVAL_S * 1000LL))) {
+		return;
+	}
+	_last_report_ms = now;
+
+	snprintk(sbuf, sizeof(sbuf), STATS_FMT, (uint32_t)(now / 1000),
+		 (uint32_t)atomic_get(&_seq[APP_SEQ_TRACK]),
+		 (uint32_t)atomic_get(&_seq[APP_SEQ_EVENT]),
+		 (uint32_t)atomic_get(&_stats[APP_STAT_GNSS_QUEUE_DROPS]),
+		 (uint32_t)atomic_get(&_stats[APP_STAT_TRACK_QUEUE_DROPS]),
+		 (uint32_t)atomic_get(&_stats[APP_STAT_TRACK_UPLOAD_ERRORS]),
+		 (uint32_t)atomic_get(&_stats[APP_STAT_EVENT_QUEUE_DROPS]),
+		 (uint32_t)atomic_get(&_stats[APP_STAT_STREAM_ERRORS]));
+
+	err = golioth_lightdb_set_async(client, APP_STATS_ENDP, GOLIOTH_CONTENT_TYPE_JSON, sbuf,
+					strlen(sbuf), async_handler, NULL);
+	if (err) {
+		LOG_ERR("Unable to write stats to LightDB State: %d", err);
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_STATS_H__
+#define __APP_STATS_H__
+
+/** Record sequence numbers and per-stage drop counters.
+ *
+ * Every record queued for upload (track points on `tracker`, events on
+ * `events`) carries a `seq` number taken from a per-stream counter that starts
+ * at 1 on boot. A record that is dropped on the device still consumes its
+ * number, so the backend sees every loss as a gap in the sequence.
+ *
+ * The device counts its own drops per stage. Comparing the gaps seen by the
+ * backend with these counters tells whether records were lost in the device
+ * queues, failed to upload, or went missing in transit. The counters and the
+ * last sequence number of each stream are reported to the `stats` LightDB
+ * State endpoint every CONFIG_APP_STATS_REPORT_INTERVAL_S seconds.
+ */
+
+#include <stdint.h>
+#include <golioth/client.h>
+
+#define APP_STATS_ENDP "stats"
+
+enum app_seq {
+	APP_SEQ_TRACK,
+	APP_SEQ_EVENT,
+	APP_SEQ_COUNT,
+};
+
+enum app_stat {
+	/** RMC sentence dropped because the processing queue was full */
+	APP_STAT_GNSS_QUEUE_DROPS,
+	/** Track point dropped because the upload queue was full */
+	APP_STAT_TRACK_QUEUE_DROPS,
+	/** Track point lost because the stream upload failed */
+	APP_STAT_TRACK_UPLOAD_ERRORS,
+	/** Event dropped because the event queue was full or it did not fit */
+	APP_STAT_EVENT_QUEUE_DROPS,
+	/** Other stream uploads (events, signal rollups, GNSS power) that failed */
+	APP_STAT_STREAM_ERRORS,
+	APP_STAT_COUNT,
+};
+
+/**
+ * Take the next sequence number of a stream. Safe to call from any context.
+ *
+ * @return sequence number, starting at 1
+ */
+uint32_t app_stats_next_seq(enum app_seq seq);
+
+/** Increment a drop counter. Safe to call from an ISR. */
+void app_stats_inc(enum app_stat stat);
+
+/** Last sequence number taken from a stream, 0 if none yet. */
+uint32_t app_stats_last_seq(enum app_seq seq);
+
+/** Current value of a drop counter. */
+uint32_t app_stats_get(enum app_stat stat);
+
+/**
+ * Report the counters to LightDB State if the report interval has elapsed.
+ * Called from the upload loop.
+ */
+void app_stats_report(struct golioth_client *client);
+
+#endif /* __APP_STATS_H__ */
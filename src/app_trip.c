@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_trip, LOG_LEVEL_DBG);
+
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+
+#include "app_events.h"
+#include "app_trip.h"
+#include "format_helper.h"
+#include "time_base.h"
+
+#define TRIP_SETTINGS_KEY "trip/state"
+
+/* Below this speed the vehicle is considered stopped */
+#define MOVING_MIN_SPEED_KMH 5.0f
+/* Speed readings further apart than this are not integrated across the gap */
+#define MAX_INTEGRATION_MS   10000
+/* Save the in-progress trip at most this often */
+#define SAVE_INTERVAL_MS     60000
+
+#define HIST_BIN_KMH 20
+#define HIST_BINS    7
+
+/* Trip accumulators, persisted across reboots */
+struct trip_state {
+	bool active;
+	/* UTC time in milliseconds since the Unix epoch, 0 if unknown */
+	int64_t start_time_ms;
+	int32_t start_lat;
+	int32_t start_lon;
+	int32_t last_lat;
+	int32_t last_lon;
+	bool has_position;
+	uint32_t duration_ms;
+	uint32_t idle_ms;
+	float gnss_distance_m;
+	float wheel_distance_m;
+	float max_speed;
+	/* Time spent in each HIST_BIN_KMH wide speed band, in seconds */
+	uint32_t speed_hist_s[HIST_BINS];
+	/* Sub-second remainders of speed_hist_s */
+	uint16_t speed_hist_ms[HIST_BINS];
+};
+
+K_MUTEX_DEFINE(trip_mutex);
+static struct trip_state _trip;
+
+/* Last known position while no trip is active, used as the start of the next trip */
+static int32_t _parked_lat;
+static int32_t _parked_lon;
+static bool _has_parked_position;
+
+static int64_t _last_speed_ms;
+static int64_t _moving_since;
+static int64_t _stopped_since;
+static int64_t _last_save_ms;
+static bool _vehicle_speed_known;
+/* Uptime of the last fused speed fed while the vehicle speed was unknown */
+static int64_t _last_fix_speed_ms;
+
+static void trip_save_work_handler(struct k_work *work);
+K_WORK_DEFINE(trip_save_work, trip_save_work_handler);
+
+static void trip_save_work_handler(struct k_work *work)
+{
+	struct trip_state state;
+	int err;
+
+	k_mutex_lock(&trip_mutex, K_FOREVER);
+	state = _trip;
+	k_mutex_unlock(&trip_mutex);
+
+	err = settings_save_one(TRIP_SETTINGS_KEY, &state, sizeof(state));
+	if (err) {
+		LOG_ERR("Unable to save trip state: %d", err);
+	}
+}
+
+static int trip_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	struct trip_state state;
+	int ret;
+
+	if (!settings_name_steq(name, "state", NULL)) {
+		return -ENOENT;
+	}
+
+	if (len != sizeof(state)) {
+		LOG_WRN("Discarding saved trip state of unexpected size %zu", len);
+		return 0;
+	}
+
+	ret = read_cb(cb_arg, &state, sizeof(state));
+	if (ret < 0) {
+		return ret;
+	}
+
+	k_mutex_lock(&trip_mutex, K_FOREVER);
+	_trip = state;
+	k_mutex_unlock(&trip_mutex);
+
+	if (state.active) {
+		LOG_INF("Resuming trip in progress");
+	}
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(trip, "trip", NULL, trip_settings_set, NULL, NULL);
+
+static void trip_start(int64_t start_ms)
+{
+	memset(&_trip, 0, sizeof(_trip));
+	_trip.active = true;
+	_trip.start_time_ms = time_base_utc_ms(start_ms);
+	if (_has_parked_position) {
+		_trip.start_lat = _parked_lat;
+		_trip.start_lon = _parked_lon;
+		_trip.last_lat = _parked_lat;
+		_trip.last_lon = _parked_lon;
+		_trip.has_position = true;
+	}
+
+	LOG_INF("Trip started");
+}
+
+static void trip_end(int64_t end_ms, uint32_t trailing_idle_ms)
+{
+	char start_str[FORMAT_TIME_LEN];
+	char start_lat_str[FORMAT_COORD_LEN];
+	char start_lon_str[FORMAT_COORD_LEN];
+	char end_lat_str[FORMAT_COORD_LEN];
+	char end_lon_str[FORMAT_COORD_LEN];
+	uint32_t duration_ms;
+	uint32_t idle_ms;
+	uint32_t avg_speed = 0;
+
+	/* The wait for the end of the trip is not part of it */
+	duration_ms = _trip.duration_ms - MIN(_trip.duration_ms, trailing_idle_ms);
+	idle_ms = _trip.idle_ms - MIN(_trip.idle_ms, trailing_idle_ms);
+	_trip.speed_hist_s[0] -= MIN(_trip.speed_hist_s[0], trailing_idle_ms / 1000);
+	if (duration_ms > 0) {
+		avg_speed = (uint32_t)lroundf(_trip.wheel_distance_m * 3600.0f / duration_ms);
+	}
+
+	if (_trip.start_time_ms) {
+		format_time_ms(start_str, sizeof(start_str), _trip.start_time_ms);
+	} else {
+		strcpy(start_str, "");
+	}
+	format_coord_e7(start_lat_str, sizeof(start_lat_str), _trip.start_lat);
+	format_coord_e7(start_lon_str, sizeof(start_lon_str), _trip.start_lon);
+	format_coord_e7(end_lat_str, sizeof(end_lat_str), _trip.last_lat);
+	format_coord_e7(end_lon_str, sizeof(end_lon_str), _trip.last_lon);
+
+	LOG_INF("Trip ended: %u s, %u m", duration_ms / 1000, (uint32_t)_trip.wheel_distance_m);
+
+	app_events_post("trip", end_ms, false,
+			"\"start\":\"%s\",\"dur_s\":%u,\"idle_s\":%u,\"dist_m\":%u,"
+			"\"wheel_m\":%u,\"max_kmh\":%u,\"avg_kmh\":%u,"
+			"\"from\":[%s,%s],\"to\":[%s,%s],"
+			"\"hist\":[%u,%u,%u,%u,%u,%u,%u]",
+			start_str, duration_ms / 1000, idle_ms / 1000,
+			(uint32_t)_trip.gnss_distance_m, (uint32_t)_trip.wheel_distance_m,
+			(uint32_t)lroundf(_trip.max_speed), avg_speed, start_lat_str,
+			start_lon_str, end_lat_str, end_lon_str, _trip.speed_hist_s[0],
+			_trip.speed_hist_s[1], _trip.speed_hist_s[2], _trip.speed_hist_s[3],
+			_trip.speed_hist_s[4], _trip.speed_hist_s[5], _trip.speed_hist_s[6]);
+
+	if (_trip.has_position) {
+		_parked_lat = _trip.last_lat;
+		_parked_lon = _trip.last_lon;
+		_has_parked_position = true;
+	}
+
+	memset(&_trip, 0, sizeof(_trip));
+}
+
+static void accumulate(float speed, uint32_t dt_ms)
+{
+	int bin = MIN((int)(speed / HIST_BIN_KMH), HIST_BINS - 1);
+	uint32_t bin_ms = _trip.speed_hist_ms[bin] + dt_ms;
+
+	_trip.duration_ms += dt_ms;
+	_trip.wheel_distance_m += speed * dt_ms / 3600.0f;
+	_trip.max_speed = MAX(_trip.max_speed, speed);
+	if (speed < MOVING_MIN_SPEED_KMH) {
+		_trip.idle_ms += dt_ms;
+	}
+
+	_trip.speed_hist_s[bin] += bin_ms / 1000;
+	_trip.speed_hist_ms[bin] = bin_ms % 1000;
+}
+
+static void update_speed(float speed, int64_t now_ms)
+{
+	bool moving = speed >= MOVING_MIN_SPEED_KMH;
+	bool save = false;
+
+	if (_trip.active && _last_speed_ms) {
+		int64_t dt_ms = now_ms - _last_speed_ms;
+
+		if ((dt_ms > 0) && (dt_ms <= MAX_INTEGRATION_MS)) {
+			accumulate(speed, (uint32_t)dt_ms);
+		}
+	}
+	_last_speed_ms = now_ms;
+
+	if (!_trip.active) {
+		_stopped_since = 0;
+		if (!moving) {
+			_moving_since = 0;
+		} else if (!_moving_since) {
+			_moving_since = now_ms;
+		} else if ((now_ms - _moving_since) >= (CONFIG_APP_TRIP_START_S * 1000LL)) {
+			trip_start(_moving_since);
+			/* The time spent waiting for the start is part of the trip */
+			accumulate(speed, (uint32_t)(now_ms - _moving_since));
+			_last_save_ms = now_ms;
+			save = true;
+		}
+	} else {
+		_moving_since = 0;
+		if (moving) {
+			_stopped_since = 0;
+		} else if (!_stopped_since) {
+			_stopped_since = now_ms;
+		} else if ((now_ms - _stopped_since) >= (CONFIG_APP_TRIP_END_S * 1000LL)) {
+			trip_end(_stopped_since, (uint32_t)(now_ms - _stopped_since));
+			_stopped_since = 0;
+			save = true;
+		}
+	}
+
+	if (_trip.active && ((now_ms - _last_save_ms) >= SAVE_INTERVAL_MS)) {
+		_last_save_ms = now_ms;
+		save = true;
+	}
+
+	if (save) {
+		k_work_submit(&trip_save_work);
+	}
+}
+
+void app_trip_speed(int vehicle_speed, int64_t now_ms)
+{
+	k_mutex_lock(&trip_mutex, K_FOREVER);
+
+	_vehicle_speed_known = (vehicle_speed >= 0);
+	if (_vehicle_speed_known) {
+		update_speed((float)vehicle_speed, now_ms);
+	}
+
+	k_mutex_unlock(&trip_mutex);
+}
+
+void app_trip_ignition_off(int64_t now_ms)
+{
+	k_mutex_lock(&trip_mutex, K_FOREVER);
+
+	/* A silent bus says nothing about the speed, recent fixes take precedence */
+	_vehicle_speed_known = false;
+	if (!_last_fix_speed_ms || ((now_ms - _last_fix_speed_ms) > MAX_INTEGRATION_MS)) {
+		update_speed(0.0f, now_ms);
+	}
+
+	k_mutex_unlock(&trip_mutex);
+}
+
+void app_trip_position(const struct track_point *pt, const struct geo_fix *fix, int64_t now_ms)
+{
+	if (pt->flags & TRACK_POINT_FAKE) {
+		return;
+	}
+
+	k_mutex_lock(&trip_mutex, K_FOREVER);
+
+	if (_trip.active) {
+		if (_trip.has_position) {
+			_trip.gnss_distance_m +=
+				geo_distance_m(_trip.last_lat, _trip.last_lon, pt->lat, pt->lon);
+		} else {
+			_trip.start_lat = pt->lat;
+			_trip.start_lon = pt->lon;
+			_trip.has_position = true;
+		}
+		_trip.last_lat = pt->lat;
+		_trip.last_lon = pt->lon;
+	} else {
+		_parked_lat = pt->lat;
+		_parked_lon = pt->lon;
+		_has_parked_position = true;
+	}
+
+	/* Fall back to the fused speed while the ECU does not reply */
+	if (!_vehicle_speed_known && !isnan(fix->speed)) {
+		update_speed(fix->speed, now_ms);
+		_last_fix_speed_ms = now_ms;
+	}
+
+	k_mutex_unlock(&trip_mutex);
+}
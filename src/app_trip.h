@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_TRIP_H__
+#define __APP_TRIP_H__
+
+/** Trip segmentation and on-device trip summaries.
+ *
+ * A trip starts once the vehicle has been moving for CONFIG_APP_TRIP_START_S
+ * seconds and ends once it has been stopped for CONFIG_APP_TRIP_END_S seconds.
+ * The vehicle speed from OBD-II drives the detection, with the fused GNSS speed
+ * as a fallback while no OBD-II reply is available.
+ *
+ * During a trip, distance is accumulated both from GNSS positions (haversine)
+ * and by integrating the wheel speed, together with idle time, maximum speed
+ * and a histogram of time spent per speed band. A summary is posted as a
+ * "trip" event when the trip ends.
+ *
+ * The in-progress trip is saved to the "trip" settings subtree, so a reboot
+ * during a trip does not split it in two.
+ */
+
+#include <stdint.h>
+#include "geo_helper.h"
+#include "track_codec.h"
+
+/**
+ * Feed a vehicle speed reading from the ECU.
+ *
+ * @param vehicle_speed vehicle speed in km/h, -1 if unknown
+ * @param now_ms current uptime in milliseconds
+ */
+void app_trip_speed(int vehicle_speed, int64_t now_ms);
+
+/**
+ * Notify that the CAN bus is asleep (ignition off).
+ *
+ * The vehicle is assumed to be parked unless fused positions keep reporting a
+ * speed, which then drives trip detection.
+ *
+ * @param now_ms current uptime in milliseconds
+ */
+void app_trip_ignition_off(int64_t now_ms);
+
+/**
+ * Feed a fused position.
+ *
+ * @param pt track point built from the fused position
+ * @param fix fused position, used for its speed while the vehicle speed is unknown
+ * @param now_ms current uptime in milliseconds
+ */
+void app_trip_position(const struct track_point *pt, const struct geo_fix *fix, int64_t now_ms);
+
+#endif /* __APP_TRIP_H__ */
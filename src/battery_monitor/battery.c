@@ -20,6 +20,8 @@
 
 #include "battery_monitor/battery.h"
 #include "../app_sensors.h"
+#include "../format_helper.h"
+#include "../time_base.h"
 
 LOG_MODULE_REGISTER(battery, LOG_LEVEL_DBG);
 
@@ -27,7 +29,8 @@ LOG_MODULE_REGISTER(battery, LOG_LEVEL_DBG);
 #define ZEPHYR_USER DT_PATH(zephyr_user)
 
 /* Formatting string for sending battery JSON to Golioth */
-#define JSON_FMT "{\"batt_v\":%d.%03d,\"batt_lvl\":%d.%02d}"
+#define JSON_FMT	   "{\"batt_v\":%d.%03d,\"batt_lvl\":%d.%02d}"
+#define JSON_FMT_WITH_TIME "{\"time\":\"%s\",\"batt_v\":%d.%03d,\"batt_lvl\":%d.%02d}"
 
 #define LABEL_BATTERY "Battery"
 
@@ -239,30 +242,6 @@ int battery_sample(void)
 	return rc;
 }
 
-unsigned int battery_level_pptt(unsigned int batt_mV, const struct battery_level_point *curve)
-{
-	const struct battery_level_point *pb = curve;
-
-	if (batt_mV >= pb->lvl_mV) {
-		/* Measured voltage above highest point, cap at maximum. */
-		return pb->lvl_pptt;
-	}
-	/* Go down to the last point at or below the measured voltage. */
-	while ((pb->lvl_pptt > 0) && (batt_mV < pb->lvl_mV)) {
-		++pb;
-	}
-	if (batt_mV < pb->lvl_mV) {
-		/* Below lowest point, cap at minimum */
-		return pb->lvl_pptt;
-	}
-
-	/* Linear interpolation between below and above points. */
-	const struct battery_level_point *pa = pb - 1;
-
-	return pb->lvl_pptt +
-	       ((pa->lvl_pptt - pb->lvl_pptt) * (batt_mV - pb->lvl_mV) / (pa->lvl_mV - pb->lvl_mV));
-}
-
 int read_battery_data(struct battery_data *batt_data)
 {
 
@@ -323,13 +302,21 @@ static void async_error_handler(struct golioth_client *client, enum golioth_stat
 int stream_battery_data(struct golioth_client *client, struct battery_data *batt_data)
 {
 	int err;
-	/* {"batt_v":X.XXX,"batt_lvl":XXX.XX} */
-	char json_buf[35];
+	/* {"time":"YYYY-MM-DDTHH:MM:SS.sssZ","batt_v":X.XXX,"batt_lvl":XXX.XX} */
+	char json_buf[35 + 10 + FORMAT_TIME_LEN];
+	char ts_str[FORMAT_TIME_LEN];
 
 	/* Send battery data to Golioth */
-	snprintk(json_buf, sizeof(json_buf), JSON_FMT, batt_data->battery_voltage_mv / 1000,
-		 batt_data->battery_voltage_mv % 1000, batt_data->battery_level_pptt / 100,
-		 batt_data->battery_level_pptt % 100);
+	if (batt_data->time_ms) {
+		format_time_ms(ts_str, sizeof(ts_str), batt_data->time_ms);
+		snprintk(json_buf, sizeof(json_buf), JSON_FMT_WITH_TIME, ts_str,
+			 batt_data->battery_voltage_mv / 1000, batt_data->battery_voltage_mv % 1000,
+			 batt_data->battery_level_pptt / 100, batt_data->battery_level_pptt % 100);
+	} else {
+		snprintk(json_buf, sizeof(json_buf), JSON_FMT, batt_data->battery_voltage_mv / 1000,
+			 batt_data->battery_voltage_mv % 1000, batt_data->battery_level_pptt / 100,
+			 batt_data->battery_level_pptt % 100);
+	}
 
 	err = golioth_stream_set_async(client, stream_endpoint, GOLIOTH_CONTENT_TYPE_JSON, json_buf,
 				       strlen(json_buf), async_error_handler, NULL);
@@ -350,6 +337,7 @@ int read_and_report_battery(struct golioth_client *client)
 		LOG_ERR("Error reading battery data");
 		return err;
 	}
+	batt_data.time_ms = time_base_utc_ms(k_uptime_get());
 
 	/* Format as global string for easy access */
 	snprintk(_batt_v_str, sizeof(_batt_v_str), "%d.%03d V", batt_data.battery_voltage_mv / 1000,
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(display_cache, LOG_LEVEL_DBG);
+
+#include <string.h>
+#include <libostentus.h>
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+
+#include "display_cache.h"
+
+#define DISPLAY_CACHE_THREAD_STACK_SIZE 1024
+#define DISPLAY_CACHE_THREAD_PRIORITY	K_LOWEST_APPLICATION_THREAD_PRIO
+
+static const struct device *o_dev = DEVICE_DT_GET_ANY(golioth_ostentus);
+
+struct slide_value {
+	char value[CONFIG_APP_DISPLAY_VALUE_LEN];
+	bool dirty;
+};
+
+static struct k_spinlock cache_lock;
+static struct slide_value _slides[SLIDE_KEY_COUNT];
+static bool _started;
+
+K_THREAD_STACK_DEFINE(display_cache_stack, DISPLAY_CACHE_THREAD_STACK_SIZE);
+static struct k_work_q display_cache_work_q;
+
+static void flush_work_handler(struct k_work *work)
+{
+	char value[CONFIG_APP_DISPLAY_VALUE_LEN];
+	k_spinlock_key_t key;
+	bool dirty;
+
+	for (int i = 0; i < SLIDE_KEY_COUNT; i++) {
+		/* Copy out under the lock, the I2C transfer happens without it */
+		key = k_spin_lock(&cache_lock);
+		dirty = _slides[i].dirty;
+		if (dirty) {
+			memcpy(value, _slides[i].value, sizeof(value));
+			_slides[i].dirty = false;
+		}
+		k_spin_unlock(&cache_lock, key);
+
+		if (dirty) {
+			ostentus_slide_set(o_dev, i, value, strlen(value));
+		}
+	}
+}
+static K_WORK_DELAYABLE_DEFINE(flush_work, flush_work_handler);
+
+void display_cache_set(slide_key slide, const char *value)
+{
+	k_spinlock_key_t key;
+	bool schedule = false;
+
+	key = k_spin_lock(&cache_lock);
+	if (strncmp(_slides[slide].value, value, sizeof(_slides[slide].value) - 1) != 0) {
+		strncpy(_slides[slide].value, value, sizeof(_slides[slide].value) - 1);
+		_slides[slide].dirty = true;
+		schedule = _started;
+	}
+	k_spin_unlock(&cache_lock, key);
+
+	if (schedule) {
+		/* No-op if a flush is already pending, which coalesces writes */
+		k_work_schedule_for_queue(&display_cache_work_q, &flush_work,
+					  K_MSEC(CONFIG_APP_DISPLAY_FLUSH_MS));
+	}
+}
+
+void display_cache_start(void)
+{
+	k_spinlock_key_t key;
+
+	k_work_queue_start(&display_cache_work_q, display_cache_stack,
+			   K_THREAD_STACK_SIZEOF(display_cache_stack), DISPLAY_CACHE_THREAD_PRIORITY,
+			   NULL);
+	k_thread_name_set(k_work_queue_thread_get(&display_cache_work_q), "display_cache");
+
+	key = k_spin_lock(&cache_lock);
+	_started = true;
+	k_spin_unlock(&cache_lock, key);
+
+	/* Send the values set so far */
+	k_work_schedule_for_queue(&display_cache_work_q, &flush_work, K_NO_WAIT);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __DISPLAY_CACHE_H__
+#define __DISPLAY_CACHE_H__
+
+/** Write-back cache of the Ostentus slide values.
+ *
+ * Writing a slide value only updates a RAM copy and marks the slide dirty if
+ * the value changed, so it never blocks on I2C and can be called from the
+ * sensor threads. Dirty slides are sent to the Ostentus by a single
+ * low-priority work queue thread, at most once every
+ * CONFIG_APP_DISPLAY_FLUSH_MS. The e-paper only redraws every few seconds
+ * anyway, so intermediate values are never missed.
+ */
+
+#include "app_sensors.h"
+
+/**
+ * Set the value of a slide.
+ *
+ * Values longer than CONFIG_APP_DISPLAY_VALUE_LEN - 1 characters are truncated.
+ */
+void display_cache_set(slide_key slide, const char *value);
+
+/**
+ * Start flushing dirty slides to the Ostentus.
+ *
+ * Values set before this call are held until it, so slides can be set before
+ * they are added to the slideshow.
+ */
+void display_cache_start(void);
+
+#endif /* __DISPLAY_CACHE_H__ */
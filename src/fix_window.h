@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __FIX_WINDOW_H__
+#define __FIX_WINDOW_H__
+
+/** Rate limit of the RMC sentences taken from the GNSS receiver.
+ *
+ * At most one sentence is taken per `GPS_DELAY_S` window, the others are
+ * dropped in the UART ISR before they reach the processing thread. Inline, as
+ * it runs for every sentence in the ISR.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Decide whether a sentence received at now_ms is taken.
+ *
+ * @param last_ms uptime of the last sentence taken, set to now_ms if this one
+ * is taken. Setting it to 0 starts the window over.
+ * @param now_ms current uptime in milliseconds
+ * @param window_ms minimum time between two sentences taken
+ * @param take_all take the sentence regardless of the window
+ *
+ * @return true if the sentence is taken
+ */
+static inline bool fix_window_take(int64_t *last_ms, int64_t now_ms, int64_t window_ms,
+				   bool take_all)
+{
+	if (!take_all && ((now_ms - *last_ms) < window_ms)) {
+		return false;
+	}
+
+	*last_ms = now_ms;
+
+	return true;
+}
+
+#endif /* __FIX_WINDOW_H__ */
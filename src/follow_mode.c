@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(follow_mode, LOG_LEVEL_DBG);
+
+#include <string.h>
+#include <golioth/client.h>
+#include <golioth/stream.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "app_settings.h"
+#include "follow_mode.h"
+#include "format_helper.h"
+#include "gnss_power.h"
+
+K_MUTEX_DEFINE(follow_mutex);
+static struct golioth_client *_client;
+/* Latest fix, kept while not following too, to publish it when following starts */
+static struct track_point _latest;
+static int64_t _latest_ms;
+static bool _have_latest;
+/* Uptime of the fix last published, the next one is due an interval later */
+static int64_t _published_ms;
+static uint32_t _seq;
+/* Interval in milliseconds while following, 0 otherwise. Read from the GNSS ISR. */
+static atomic_t _interval_ms;
+
+static void publish_work_handler(struct k_work *work);
+static K_WORK_DEFINE(publish_work, publish_work_handler);
+static void end_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(end_work, end_work_handler);
+
+static void async_handler(struct golioth_client *client, enum golioth_status status,
+			  const struct golioth_coap_rsp_code *coap_rsp_code, const char *path,
+			  void *arg)
+{
+	if (status != GOLIOTH_OK) {
+		LOG_WRN("Failed to publish fix: %d", status);
+	}
+}
+
+static void publish_work_handler(struct k_work *work)
+{
+	char json_buf[FORMAT_TRACK_POINT_LEN];
+	struct track_point point;
+	int err;
+
+	k_mutex_lock(&follow_mutex, K_FOREVER);
+	point = _latest;
+	point.seq = ++_seq;
+	k_mutex_unlock(&follow_mutex);
+
+	format_track_point_json(json_buf, sizeof(json_buf), &point);
+
+	/* Queued ahead of the backlog the main loop uploads one point at a time */
+	err = golioth_stream_set_async(_client, FOLLOW_MODE_STREAM_ENDP, GOLIOTH_CONTENT_TYPE_JSON,
+				       json_buf, strlen(json_buf), async_handler, NULL);
+	if (err) {
+		LOG_ERR("Failed to publish fix %u: %d", point.seq, err);
+	}
+}
+
+static void end_work_handler(struct k_work *work)
+{
+	follow_mode_stop();
+}
+
+void follow_mode_init(struct golioth_client *client)
+{
+	_client = client;
+}
+
+bool follow_mode_start(uint32_t minutes, uint32_t interval_s)
+{
+	int64_t now = k_uptime_get();
+	bool publish;
+
+	if (interval_s == 0) {
+		interval_s = CONFIG_APP_FOLLOW_MODE_INTERVAL_S;
+	}
+
+	k_mutex_lock(&follow_mutex, K_FOREVER);
+
+	if (!follow_mode_active()) {
+		_seq = 0;
+	}
+
+	/*
+	 * Publish the freshest fix now if it is no older than an interval, as
+	 * it would be while following. Otherwise the receiver was asleep or
+	 * lost the sky: publish the next fix as soon as it is received.
+	 */
+	publish = _have_latest && ((now - _latest_ms) <= ((int64_t)interval_s * MSEC_PER_SEC));
+	_published_ms = publish ? _latest_ms : INT64_MIN / 2;
+	atomic_set(&_interval_ms, (atomic_val_t)interval_s * MSEC_PER_SEC);
+
+	k_mutex_unlock(&follow_mutex);
+
+	if (publish) {
+		k_work_submit(&publish_work);
+	}
+
+	k_work_reschedule(&end_work, K_MINUTES(minutes));
+
+	/* Rather than after the next vehicle speed request, which may be hours away */
+	gnss_power_update(-1);
+
+	/*
+	 * Vehicle speed polling and the GPS window pick up the interval right
+	 * away. The CAN thread is woken too if the bus is asleep, and keeps the
+	 * receiver on from there.
+	 */
+	app_settings_notify(APP_SETTINGS_CHANGED_VEHICLE_SPEED_DELAY |
+			    APP_SETTINGS_CHANGED_GPS_DELAY);
+
+	LOG_INF("Following for %u minutes, a fix every %u seconds", minutes, interval_s);
+
+	return publish;
+}
+
+void follow_mode_stop(void)
+{
+	k_work_cancel_delayable(&end_work);
+
+	if (atomic_set(&_interval_ms, 0) == 0) {
+		return;
+	}
+
+	app_settings_notify(APP_SETTINGS_CHANGED_VEHICLE_SPEED_DELAY |
+			    APP_SETTINGS_CHANGED_GPS_DELAY);
+
+	LOG_INF("Follow mode ended after %u fixes", _seq);
+}
+
+int64_t follow_mode_interval_ms(void)
+{
+	return atomic_get(&_interval_ms);
+}
+
+void follow_mode_fix(const struct track_point *point, int64_t uptime_ms)
+{
+	int64_t interval_ms = follow_mode_interval_ms();
+	bool publish = false;
+
+	k_mutex_lock(&follow_mutex, K_FOREVER);
+
+	_latest = *point;
+	_latest_ms = uptime_ms;
+	_have_latest = true;
+
+	/* A quarter interval of slack, so that a 1 s interval keeps every 1 Hz fix */
+	if ((interval_ms > 0) && ((uptime_ms - _published_ms) >= (interval_ms * 3 / 4))) {
+		_published_ms = uptime_ms;
+		publish = true;
+	}
+
+	k_mutex_unlock(&follow_mutex);
+
+	if (publish) {
+		k_work_submit(&publish_work);
+	}
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __FOLLOW_MODE_H__
+#define __FOLLOW_MODE_H__
+
+/** Temporary high-rate streaming of fixes, requested with the follow RPC.
+ *
+ * When follow mode starts, the freshest fix is published right away if it is
+ * no older than the follow interval, then a fix is published every follow
+ * interval until the requested duration has passed. Fixes are published with
+ * golioth_stream_set_async() to the FOLLOW_MODE_STREAM_ENDP endpoint, so they
+ * do not wait for the main loop or for the track point backlog. Their `seq`
+ * counts the fixes of the follow session from 1.
+ *
+ * While following, every RMC sentence is processed regardless of
+ * GPS_DELAY_S, the vehicle speed is polled at least once per interval and the
+ * GNSS receiver is woken up and kept on, also while the CAN bus is asleep. The
+ * configured rates apply again once follow mode ends.
+ *
+ * Without CONFIG_APP_FOLLOW_MODE, follow mode is never active.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <golioth/client.h>
+#include "track_codec.h"
+
+#define FOLLOW_MODE_STREAM_ENDP "follow"
+#define FOLLOW_MODE_MAX_INTERVAL_S 3600
+
+#ifdef CONFIG_APP_FOLLOW_MODE
+
+/** Set the client fixes are published with. */
+void follow_mode_init(struct golioth_client *client);
+
+/**
+ * Start following, or change the duration and interval of the current session.
+ *
+ * @param minutes duration, up to CONFIG_APP_FOLLOW_MODE_MAX_MIN
+ * @param interval_s seconds between fixes, 0 for CONFIG_APP_FOLLOW_MODE_INTERVAL_S
+ *
+ * @return true if a fix was published right away, false if none was received
+ *	   within the interval and the next one is published as soon as it is
+ *	   received
+ */
+bool follow_mode_start(uint32_t minutes, uint32_t interval_s);
+
+/** Stop following. */
+void follow_mode_stop(void);
+
+/** Interval between fixes in milliseconds while following, 0 otherwise. */
+int64_t follow_mode_interval_ms(void);
+
+/**
+ * Pass a processed fix, called for every fix. Publishes it if it is due.
+ *
+ * @param point fix, with the vehicle speed at the time of the fix
+ * @param uptime_ms uptime when the fix was received
+ */
+void follow_mode_fix(const struct track_point *point, int64_t uptime_ms);
+
+#else /* CONFIG_APP_FOLLOW_MODE */
+
+static inline int64_t follow_mode_interval_ms(void)
+{
+	return 0;
+}
+
+static inline void follow_mode_fix(const struct track_point *point, int64_t uptime_ms)
+{
+}
+
+#endif /* CONFIG_APP_FOLLOW_MODE */
+
+/** True while following. */
+static inline bool follow_mode_active(void)
+{
+	return follow_mode_interval_ms() != 0;
+}
+
+#endif /* __FOLLOW_MODE_H__ */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <time.h>
+#include <zephyr/kernel.h>
+
+#include "format_helper.h"
+#include "geo_helper.h"
+
+/* Formatting strings for sending track points to Golioth */
+/* clang-format off */
+#define JSON_FMT \
+"{" \
+	"\"time\":\"%s\"," \
+	"\"seq\":%u," \
+	"\"gps\":" \
+	"{" \
+		"\"lat\":%s," \
+		"\"lon\":%s," \
+		"\"fake\":%s," \
+		"\"estimated\":%s" \
+	"}," \
+	"\"vehicle\":" \
+	"{" \
+		"\"speed\":%d" \
+	"}" \
+"}"
+#define JSON_FMT_FAKE_GPS \
+"{" \
+	"\"seq\":%u," \
+	"\"gps\":" \
+	"{" \
+		"\"lat\":%s," \
+		"\"lon\":%s," \
+		"\"fake\":%s," \
+		"\"estimated\":%s" \
+	"}," \
+	"\"vehicle\":" \
+	"{" \
+		"\"speed\":%d" \
+	"}" \
+"}"
+/* clang-format on */
+
+void format_coord_e7(char *buf, size_t len, int32_t coord_e7)
+{
+	uint32_t abs_coord = (coord_e7 < 0) ? -(int64_t)coord_e7 : coord_e7;
+
+	snprintk(buf, len, "%s%u.%07u", (coord_e7 < 0) ? "-" : "", abs_coord / GEO_E7_PER_DEG,
+		 abs_coord % GEO_E7_PER_DEG);
+}
+
+void format_time_ms(char *buf, size_t len, int64_t time_ms)
+{
+	time_t secs = time_ms / 1000;
+	struct tm tm;
+
+	gmtime_r(&secs, &tm);
+	snprintk(buf, len, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", tm.tm_year + 1900,
+		 tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+		 (int)(time_ms % 1000));
+}
+
+int format_track_point_json(char *buf, size_t len, const struct track_point *pt)
+{
+	char ts_str[FORMAT_TIME_LEN];
+	char lat_str[FORMAT_COORD_LEN];
+	char lon_str[FORMAT_COORD_LEN];
+
+	format_coord_e7(lat_str, sizeof(lat_str), pt->lat);
+	format_coord_e7(lon_str, sizeof(lon_str), pt->lon);
+
+	if (pt->time_ms == 0) { /* No `time` field until UTC time is known */
+		return snprintk(buf, len, JSON_FMT_FAKE_GPS, pt->seq, lat_str, lon_str,
+				(pt->flags & TRACK_POINT_FAKE) ? "true" : "false",
+				(pt->flags & TRACK_POINT_ESTIMATED) ? "true" : "false", pt->speed);
+	}
+
+	format_time_ms(ts_str, sizeof(ts_str), pt->time_ms);
+
+	/*
+	 * `time` will not appear in the `data` payload once received by Golioth
+	 * LightDB Stream, but instead will override the `time` timestamp of the
+	 * data.
+	 */
+	return snprintk(buf, len, JSON_FMT, ts_str, pt->seq, lat_str, lon_str,
+			(pt->flags & TRACK_POINT_FAKE) ? "true" : "false",
+			(pt->flags & TRACK_POINT_ESTIMATED) ? "true" : "false", pt->speed);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __FORMAT_HELPER_H__
+#define __FORMAT_HELPER_H__
+
+/** String formatting shared by the JSON payloads sent to Golioth. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "track_codec.h"
+
+/* "-180.0000000" plus terminator */
+#define FORMAT_COORD_LEN 13
+/* "2024-01-01T00:00:00.000Z" plus terminator */
+#define FORMAT_TIME_LEN	 25
+/* Buffer size for format_track_point_json() */
+#define FORMAT_TRACK_POINT_LEN 256
+
+/** Format a coordinate in 1e-7 degrees as a decimal string. */
+void format_coord_e7(char *buf, size_t len, int32_t coord_e7);
+
+/** Format a UTC time in milliseconds since the Unix epoch as an ISO 8601 string. */
+void format_time_ms(char *buf, size_t len, int64_t time_ms);
+
+/**
+ * Format a track point as the JSON payload of the "tracker" stream.
+ *
+ * The `time` field is left out while the UTC time of the point is unknown.
+ *
+ * @return length of the payload, as snprintk()
+ */
+int format_track_point_json(char *buf, size_t len, const struct track_point *pt);
+
+#endif /* __FORMAT_HELPER_H__ */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(fusion, LOG_LEVEL_DBG);
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+
+#include "fusion.h"
+
+#define EARTH_RADIUS_M	      6371008.8
+#define DEG_TO_RAD	      (M_PI / 180.0)
+#define KMH_TO_MS	      (1.0 / 3.6)
+/* Course over ground is noise when (almost) stationary, so ignore it below this speed */
+#define COURSE_MIN_SPEED_KMH  5.0f
+/* Measurements further than this from the estimate reset the filter */
+#define INNOVATION_RESET_M    CONFIG_APP_FUSION_RESET_M
+
+static struct {
+	/* Position in degrees */
+	double lat;
+	double lon;
+	/* Course over ground in degrees true, NAN if unknown */
+	float course;
+	/* Last GNSS speed over ground in km/h, NAN if unknown */
+	float gnss_speed;
+	int64_t last_update_ms;
+	int64_t last_valid_ms;
+	bool initialized;
+} _state;
+
+/* Wrap a longitude, or a difference of longitudes, into [-180, 180) */
+static double wrap_lon(double lon)
+{
+	return lon - 360.0 * floor((lon + 180.0) / 360.0);
+}
+
+static void propagate(float speed, int64_t now_ms)
+{
+	double dt = (now_ms - _state.last_update_ms) / 1000.0;
+
+	_state.last_update_ms = now_ms;
+
+	if (isnan(speed) || isnan(_state.course) || (dt <= 0.0)) {
+		return;
+	}
+
+	double distance = speed * KMH_TO_MS * dt;
+	double heading = _state.course * DEG_TO_RAD;
+
+	_state.lat += (distance * cos(heading) / EARTH_RADIUS_M) / DEG_TO_RAD;
+	_state.lon += (distance * sin(heading) / (EARTH_RADIUS_M * cos(_state.lat * DEG_TO_RAD))) /
+		      DEG_TO_RAD;
+	/* Driving east across the antimeridian goes on from -180 */
+	_state.lon = wrap_lon(_state.lon);
+}
+
+static void correct(const struct geo_fix *fix, int64_t now_ms)
+{
+	double meas_lat = (double)fix->lat / GEO_E7_PER_DEG;
+	double meas_lon = (double)fix->lon / GEO_E7_PER_DEG;
+	int32_t est_lat = (int32_t)lround(_state.lat * GEO_E7_PER_DEG);
+	int32_t est_lon = (int32_t)lround(_state.lon * GEO_E7_PER_DEG);
+
+	if (geo_distance_m(est_lat, est_lon, fix->lat, fix->lon) > INNOVATION_RESET_M) {
+		_state.lat = meas_lat;
+		_state.lon = meas_lon;
+	} else {
+		_state.lat += (meas_lat - _state.lat) * CONFIG_APP_FUSION_GAIN_PCT / 100.0;
+		/* The short way across the antimeridian: 179.99 and -179.99 are 0.02 apart */
+		_state.lon += wrap_lon(meas_lon - _state.lon) * CONFIG_APP_FUSION_GAIN_PCT / 100.0;
+		_state.lon = wrap_lon(_state.lon);
+	}
+
+	_state.gnss_speed = fix->speed;
+	if (!isnan(fix->course) && !isnan(fix->speed) && (fix->speed >= COURSE_MIN_SPEED_KMH)) {
+		_state.course = fix->course;
+	}
+
+	_state.last_valid_ms = now_ms;
+}
+
+int fusion_update(const struct geo_fix *fix, int vehicle_speed, int64_t now_ms,
+		  struct geo_fix *out)
+{
+	float speed;
+
+	if (fix->valid && !_state.initialized) {
+		_state.lat = (double)fix->lat / GEO_E7_PER_DEG;
+		_state.lon = (double)fix->lon / GEO_E7_PER_DEG;
+		_state.course = NAN;
+		_state.last_update_ms = now_ms;
+		_state.initialized = true;
+	}
+
+	if (!_state.initialized) {
+		return -ENODATA;
+	}
+
+	if (fix->valid) {
+		/* Prefer wheel speed, fall back to the previous GNSS speed over ground */
+		speed = (vehicle_speed >= 0) ? (float)vehicle_speed : _state.gnss_speed;
+		propagate(speed, now_ms);
+		correct(fix, now_ms);
+	} else {
+		/* Dead reckoning needs wheel speed; a stale GNSS speed would drift */
+		if ((vehicle_speed < 0) ||
+		    ((now_ms - _state.last_valid_ms) > (CONFIG_APP_FUSION_MAX_DR_S * 1000LL))) {
+			_state.last_update_ms = now_ms;
+			return -ENODATA;
+		}
+		speed = (float)vehicle_speed;
+		propagate(speed, now_ms);
+	}
+
+	out->lat = (int32_t)lround(_state.lat * GEO_E7_PER_DEG);
+	out->lon = (int32_t)lround(_state.lon * GEO_E7_PER_DEG);
+	out->course = _state.course;
+	out->speed = speed;
+	out->valid = fix->valid;
+
+	return 0;
+}
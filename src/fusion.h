@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __FUSION_H__
+#define __FUSION_H__
+
+/** Fusion of GNSS fixes with OBD-II vehicle speed.
+ *
+ * A complementary filter tracks the vehicle position. Between updates the
+ * position is propagated from the vehicle speed (OBD-II, or GNSS speed over
+ * ground if unavailable) along the last known course over ground:
+ *
+ *  - While the GNSS fix is valid, each fix pulls the propagated position
+ *    towards the measurement by CONFIG_APP_FUSION_GAIN_PCT percent, which
+ *    smooths out fix-to-fix jitter.
+ *  - While the GNSS fix is invalid (tunnels, parking garages, urban canyons)
+ *    the propagated position is reported as an estimate, for up to
+ *    CONFIG_APP_FUSION_MAX_DR_S seconds after the last valid fix.
+ */
+
+#include <stdint.h>
+#include "geo_helper.h"
+
+/**
+ * Update the filter with a new fix.
+ *
+ * @param fix fix from the GNSS receiver; only used if fix->valid is true
+ * @param vehicle_speed vehicle speed from OBD-II in km/h, -1 if unknown
+ * @param now_ms current uptime in milliseconds
+ * @param out fused position. out->valid is false for dead-reckoned estimates.
+ *
+ * @return 0 on success, -ENODATA if no position can be estimated
+ */
+int fusion_update(const struct geo_fix *fix, int vehicle_speed, int64_t now_ms,
+		  struct geo_fix *out);
+
+#endif /* __FUSION_H__ */
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <math.h>
+
+#include "geo_helper.h"
+
+#define EARTH_RADIUS_M 6371008.8
+#define KNOTS_TO_KMH   1.852f
+
+static inline double e7_to_rad(int64_t coord_e7)
+{
+	return ((double)coord_e7 / GEO_E7_PER_DEG) * (M_PI / 180.0);
+}
+
+int geo_minmea_to_e7(const struct minmea_float *f, int32_t *coord_e7)
+{
+	if (f->scale == 0) {
+		return -ENODATA;
+	}
+
+	int64_t value = f->value;
+	int64_t scale = f->scale;
+
+	/* Split DDDMM.MMMM into whole degrees and (scaled) minutes */
+	int64_t degrees = value / (scale * 100);
+	int64_t minutes = value % (scale * 100);
+
+	*coord_e7 = (int32_t)(degrees * GEO_E7_PER_DEG +
+			      (minutes * GEO_E7_PER_DEG) / (60 * scale));
+
+	return 0;
+}
+
+int geo_coord_to_minmea(struct minmea_float *f, float coord)
+{
+	int32_t degrees;
+	int32_t minutes;
+
+	/* Written so that NAN fails too */
+	if (!((coord >= -180.0f) && (coord <= 180.0f))) {
+		return -ERANGE;
+	}
+
+	degrees = (int32_t)coord;
+	/* At most 6000000, well within the exact integer range of a float */
+	minutes = (int32_t)lroundf((coord - degrees) * 60 * GEO_MINMEA_SCALE);
+
+	/* Convert degrees to NMEA [+-]DDDMM.MMMMM format, at most 1800000000 */
+	f->value = degrees * 100 * GEO_MINMEA_SCALE + minutes;
+	f->scale = GEO_MINMEA_SCALE;
+
+	return 0;
+}
+
+int geo_e7_to_minmea(struct minmea_float *f, int32_t coord_e7)
+{
+	int32_t degrees;
+	int32_t rest;
+
+	if ((coord_e7 < -180 * GEO_E7_PER_DEG) || (coord_e7 > 180 * GEO_E7_PER_DEG)) {
+		return -ERANGE;
+	}
+
+	degrees = coord_e7 / GEO_E7_PER_DEG;
+	rest = coord_e7 % GEO_E7_PER_DEG;
+
+	/* 1e-7 degrees to 1e-5 minutes is * 60 / 100, rounded half away from zero */
+	f->value = degrees * 100 * GEO_MINMEA_SCALE + (rest * 6 + ((rest < 0) ? -5 : 5)) / 10;
+	f->scale = GEO_MINMEA_SCALE;
+
+	return 0;
+}
+
+int geo_fix_from_rmc(struct geo_fix *fix, const struct minmea_sentence_rmc *rmc_frame)
+{
+	int err;
+
+	err = geo_minmea_to_e7(&rmc_frame->latitude, &fix->lat);
+	if (err) {
+		return err;
+	}
+
+	err = geo_minmea_to_e7(&rmc_frame->longitude, &fix->lon);
+	if (err) {
+		return err;
+	}
+
+	/* minmea_tofloat() returns NAN for empty fields */
+	fix->course = minmea_tofloat(&rmc_frame->course);
+	fix->speed = minmea_tofloat(&rmc_frame->speed) * KNOTS_TO_KMH;
+	fix->valid = rmc_frame->valid;
+
+	return 0;
+}
+
+float geo_distance_m(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2)
+{
+	double phi1 = e7_to_rad(lat1);
+	double phi2 = e7_to_rad(lat2);
+	double dphi = e7_to_rad((int64_t)lat2 - lat1);
+	double dlambda = e7_to_rad((int64_t)lon2 - lon1);
+
+	double a = sin(dphi / 2) * sin(dphi / 2) +
+		   cos(phi1) * cos(phi2) * sin(dlambda / 2) * sin(dlambda / 2);
+
+	return (float)(2 * EARTH_RADIUS_M * asin(sqrt(fmin(a, 1.0))));
+}
+
+float geo_segment_distance_m(int32_t a_lat, int32_t a_lon, int32_t b_lat, int32_t b_lon,
+			     int32_t p_lat, int32_t p_lon)
+{
+	double k_lat = EARTH_RADIUS_M;
+	double k_lon = EARTH_RADIUS_M * cos(e7_to_rad(a_lat));
+
+	/* Project b and p to meters east/north of a */
+	double bx = k_lon * e7_to_rad((int64_t)b_lon - a_lon);
+	double by = k_lat * e7_to_rad((int64_t)b_lat - a_lat);
+	double px = k_lon * e7_to_rad((int64_t)p_lon - a_lon);
+	double py = k_lat * e7_to_rad((int64_t)p_lat - a_lat);
+
+	double len_sq = bx * bx + by * by;
+	double t = (len_sq > 0.0) ? ((px * bx + py * by) / len_sq) : 0.0;
+
+	t = fmax(0.0, fmin(1.0, t));
+
+	return (float)hypot(px - t * bx, py - t * by);
+}
+
+float geo_bearing_deg(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2)
+{
+	double phi1 = e7_to_rad(lat1);
+	double phi2 = e7_to_rad(lat2);
+	double dlambda = e7_to_rad((int64_t)lon2 - lon1);
+
+	double y = sin(dlambda) * cos(phi2);
+	double x = cos(phi1) * sin(phi2) - sin(phi1) * cos(phi2) * cos(dlambda);
+	double bearing = atan2(y, x) * (180.0 / M_PI);
+
+	return (float)((bearing < 0.0) ? (bearing + 360.0) : bearing);
+}
+
+float geo_heading_diff(float a, float b)
+{
+	float diff = fmodf(fabsf(a - b), 360.0f);
+
+	return (diff > 180.0f) ? (360.0f - diff) : diff;
+}
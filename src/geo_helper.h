@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __GEO_HELPER_H__
+#define __GEO_HELPER_H__
+
+/** Geodesic helpers shared by the tracking pipeline.
+ *
+ * Coordinates are carried as fixed-point integers in units of 1e-7 degrees.
+ * This keeps the full precision of the NMEA sentence (which float would not)
+ * while still fitting in an int32_t for the whole [-180.0, 180.0] range.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lib/minmea/minmea.h"
+
+#define GEO_E7_PER_DEG 10000000
+/* Scale of the minmea_float coordinates made by geo_coord_to_minmea() */
+#define GEO_MINMEA_SCALE 100000
+
+/** A position fix as consumed by the tracking pipeline stages. */
+struct geo_fix {
+	/** Latitude in 1e-7 degrees */
+	int32_t lat;
+	/** Longitude in 1e-7 degrees */
+	int32_t lon;
+	/** Course over ground in degrees true, NAN if unknown */
+	float course;
+	/** Speed over ground in km/h, NAN if unknown */
+	float speed;
+	/** True if the position comes from a valid GNSS fix */
+	bool valid;
+};
+
+/**
+ * Convert an NMEA [+-]DDDMM.MMMM minmea_float coordinate to 1e-7 degrees.
+ *
+ * Uses integer arithmetic only, so no precision is lost to float rounding.
+ *
+ * @return 0 on success, -ENODATA if the field was empty in the sentence
+ */
+int geo_minmea_to_e7(const struct minmea_float *f, int32_t *coord_e7);
+
+/**
+ * Convert a coordinate in degrees to an NMEA [+-]DDDMM.MMMMM minmea_float.
+ *
+ * NMEA latitude is represented as [+-]DDMM.MMMM... [-90.0, 90.0]
+ * NMEA longitude is represented as [+-]DDDMM.MMMM... [-180.0, 180.0]
+ *
+ * For example, -123.456789 is converted to:
+ *   degrees = -123
+ *   minutes = -0.456789 * 60 = -27.40734
+ *   NMEA = (degrees * 100) + minutes = -12327.40734
+ *
+ * minmea_float stores the value as an int_least32_t with a scale factor of
+ * GEO_MINMEA_SCALE: .value = -1232740734, .scale = 100000. That is 5 decimal
+ * places of minutes (about 2 cm at the equator), and the most that fits: with
+ * 6 decimal places, -12327.407340 would be -12327407340, which overflows
+ * int32_t. At 5 decimal places, the largest value is 18000.00000, which fits.
+ *
+ * Degrees and minutes are scaled separately and added as integers, so the
+ * result is not rounded to the 24 bits of precision of a float.
+ *
+ * @return 0 on success, -ERANGE if coord is outside [-180.0, 180.0] or NAN
+ */
+int geo_coord_to_minmea(struct minmea_float *f, float coord);
+
+/**
+ * Convert a coordinate in 1e-7 degrees to an NMEA [+-]DDDMM.MMMMM minmea_float.
+ *
+ * Uses integer arithmetic only, the minutes are rounded to GEO_MINMEA_SCALE.
+ *
+ * @return 0 on success, -ERANGE if coord_e7 is outside [-180.0, 180.0]
+ */
+int geo_e7_to_minmea(struct minmea_float *f, int32_t coord_e7);
+
+/**
+ * Fill a geo_fix from an RMC sentence.
+ *
+ * @return 0 on success, -ENODATA if the sentence has no coordinates
+ */
+int geo_fix_from_rmc(struct geo_fix *fix, const struct minmea_sentence_rmc *rmc_frame);
+
+/** Great-circle (haversine) distance in meters between two coordinates. */
+float geo_distance_m(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2);
+
+/**
+ * Distance in meters from point p to the segment a-b.
+ *
+ * Uses an equirectangular projection around a, which is accurate to well
+ * under a meter for segments up to a few kilometers long.
+ */
+float geo_segment_distance_m(int32_t a_lat, int32_t a_lon, int32_t b_lat, int32_t b_lon,
+			     int32_t p_lat, int32_t p_lon);
+
+/** Initial great-circle bearing from the first to the second coordinate, in degrees [0, 360). */
+float geo_bearing_deg(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2);
+
+/** Absolute difference between two headings in degrees, in the range [0, 180]. */
+float geo_heading_diff(float a, float b);
+
+#endif /* __GEO_HELPER_H__ */
@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(geofence, LOG_LEVEL_DBG);
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <zcbor_decode.h>
+#include <zephyr/sys/util.h>
+
+#include "geo_helper.h"
+#include "geofence.h"
+
+#define MAX_FENCES   CONFIG_APP_GEOFENCE_MAX_FENCES
+#define MAX_VERTICES CONFIG_APP_GEOFENCE_MAX_VERTICES
+#define MAX_INSIDE   CONFIG_APP_GEOFENCE_MAX_INSIDE
+#define GRID_BUCKETS CONFIG_APP_GEOFENCE_GRID_BUCKETS
+#define GRID_ENTRIES CONFIG_APP_GEOFENCE_GRID_ENTRIES
+#define GRID_CELL_E7 (CONFIG_APP_GEOFENCE_GRID_CELL_MDEG * (GEO_E7_PER_DEG / 1000))
+
+/* Fences spanning more grid cells than this are checked on every fix instead */
+#define MAX_CELLS_PER_FENCE 64
+
+#define METERS_PER_DEG_LAT 111320.0
+#define NO_ENTRY	   UINT16_MAX
+
+struct geofence {
+	int32_t id;
+	/* Bounding box in 1e-7 degrees */
+	int32_t min_lat;
+	int32_t min_lon;
+	int32_t max_lat;
+	int32_t max_lon;
+	/* Polygon vertices (or the center of a circle) in _vertices */
+	uint16_t first_vertex;
+	uint16_t n_vertices;
+	/* Radius of a circle, 0 for polygons */
+	uint32_t radius_m;
+};
+
+struct grid_entry {
+	uint16_t fence;
+	uint16_t next;
+};
+
+static struct geofence _fences[MAX_FENCES];
+static size_t _fence_count;
+
+/* {lat, lon} pairs in 1e-7 degrees */
+static int32_t _vertices[MAX_VERTICES][2];
+static size_t _vertex_count;
+
+/* Grid index: each bucket is a linked list of entries in _entries */
+static uint16_t _buckets[GRID_BUCKETS] = {[0 ... GRID_BUCKETS - 1] = NO_ENTRY};
+static uint16_t _large_fences = NO_ENTRY;
+static struct grid_entry _entries[GRID_ENTRIES];
+static size_t _entry_count;
+
+static int32_t _version;
+
+/* IDs of the fences the vehicle was inside at the last fix */
+static int32_t _inside_ids[MAX_INSIDE];
+static size_t _inside_count;
+
+static inline int32_t grid_cell(int32_t coord_e7)
+{
+	/* Round towards negative infinity so cells do not straddle zero */
+	return (coord_e7 >= 0) ? (coord_e7 / GRID_CELL_E7)
+			       : -(int32_t)((-(int64_t)coord_e7 + GRID_CELL_E7 - 1) / GRID_CELL_E7);
+}
+
+static inline uint16_t *grid_bucket(int32_t cell_lat, int32_t cell_lon)
+{
+	uint32_t hash = ((uint32_t)cell_lat * 73856093u) ^ ((uint32_t)cell_lon * 19349663u);
+
+	return &_buckets[hash % GRID_BUCKETS];
+}
+
+static int grid_add(uint16_t *head, uint16_t fence)
+{
+	if (_entry_count >= GRID_ENTRIES) {
+		return -ENOMEM;
+	}
+
+	_entries[_entry_count].fence = fence;
+	_entries[_entry_count].next = *head;
+	*head = _entry_count++;
+
+	return 0;
+}
+
+static int grid_index_fence(uint16_t fence)
+{
+	const struct geofence *f = &_fences[fence];
+	int32_t lat0 = grid_cell(f->min_lat);
+	int32_t lat1 = grid_cell(f->max_lat);
+	int32_t lon0 = grid_cell(f->min_lon);
+	int32_t lon1 = grid_cell(f->max_lon);
+	int err;
+
+	if (((int64_t)(lat1 - lat0 + 1) * (lon1 - lon0 + 1)) > MAX_CELLS_PER_FENCE) {
+		return grid_add(&_large_fences, fence);
+	}
+
+	for (int32_t lat = lat0; lat <= lat1; lat++) {
+		for (int32_t lon = lon0; lon <= lon1; lon++) {
+			err = grid_add(grid_bucket(lat, lon), fence);
+			if (err) {
+				return err;
+			}
+		}
+	}
+
+	return 0;
+}
+
+void geofence_clear(void)
+{
+	_fence_count = 0;
+	_vertex_count = 0;
+	_entry_count = 0;
+	_large_fences = NO_ENTRY;
+	memset(_buckets, 0xFF, sizeof(_buckets));
+	_version = 0;
+}
+
+static bool polygon_contains(const int32_t (*v)[2], size_t n, int32_t lat, int32_t lon)
+{
+	bool inside = false;
+
+	/* Ray casting, treating lat/lon as planar coordinates */
+	for (size_t i = 0, j = n - 1; i < n; j = i++) {
+		int64_t yi = v[i][0];
+		int64_t xi = v[i][1];
+		int64_t yj = v[j][0];
+		int64_t xj = v[j][1];
+
+		if ((yi > lat) == (yj > lat)) {
+			continue;
+		}
+
+		/* lon < xi + (xj - xi) * (lat - yi) / (yj - yi), without the division */
+		int64_t lhs = (lon - xi) * (yj - yi);
+		int64_t rhs = (xj - xi) * (lat - yi);
+
+		if ((yj > yi) ? (lhs < rhs) : (lhs > rhs)) {
+			inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+static bool fence_contains(const struct geofence *f, int32_t lat, int32_t lon)
+{
+	if ((lat < f->min_lat) || (lat > f->max_lat) || (lon < f->min_lon) ||
+	    (lon > f->max_lon)) {
+		return false;
+	}
+
+	if (f->radius_m) {
+		const int32_t *center = _vertices[f->first_vertex];
+
+		return geo_distance_m(center[0], center[1], lat, lon) <= (float)f->radius_m;
+	}
+
+	return polygon_contains(&_vertices[f->first_vertex], f->n_vertices, lat, lon);
+}
+
+static bool id_in(const int32_t *ids, size_t count, int32_t id)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (ids[i] == id) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void geofence_evaluate(const struct track_point *pt, geofence_event_cb cb)
+{
+	int32_t now_inside[MAX_INSIDE];
+	size_t now_count = 0;
+
+	const uint16_t heads[] = {
+		*grid_bucket(grid_cell(pt->lat), grid_cell(pt->lon)),
+		_large_fences,
+	};
+
+	for (int h = 0; h < ARRAY_SIZE(heads); h++) {
+		for (uint16_t e = heads[h]; e != NO_ENTRY; e = _entries[e].next) {
+			const struct geofence *f = &_fences[_entries[e].fence];
+
+			if (!fence_contains(f, pt->lat, pt->lon) ||
+			    id_in(now_inside, now_count, f->id)) {
+				continue;
+			}
+
+			if (now_count < MAX_INSIDE) {
+				now_inside[now_count++] = f->id;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < _inside_count; i++) {
+		if (!id_in(now_inside, now_count, _inside_ids[i])) {
+			cb(_inside_ids[i], false, pt);
+		}
+	}
+
+	for (size_t i = 0; i < now_count; i++) {
+		if (!id_in(_inside_ids, _inside_count, now_inside[i])) {
+			cb(now_inside[i], true, pt);
+		}
+	}
+
+	memcpy(_inside_ids, now_inside, now_count * sizeof(now_inside[0]));
+	_inside_count = now_count;
+}
+
+static bool key_is(const struct zcbor_string *key, const char *name)
+{
+	return (key->len == strlen(name)) && !memcmp(key->value, name, key->len);
+}
+
+static bool decode_number(zcbor_state_t *zsd, double *value)
+{
+	int64_t int_value;
+
+	if (zcbor_float_decode(zsd, value)) {
+		return true;
+	}
+
+	if (zcbor_int64_decode(zsd, &int_value)) {
+		*value = (double)int_value;
+		return true;
+	}
+
+	return false;
+}
+
+static bool decode_int32(zcbor_state_t *zsd, int32_t *value)
+{
+	double number;
+
+	if (!decode_number(zsd, &number) || !((number >= INT32_MIN) && (number <= INT32_MAX))) {
+		return false;
+	}
+
+	*value = (int32_t)number;
+
+	return true;
+}
+
+static bool decode_coord(zcbor_state_t *zsd, int32_t *coord_e7, double limit)
+{
+	double deg;
+
+	if (!decode_number(zsd, &deg) || !((deg >= -limit) && (deg <= limit))) {
+		return false;
+	}
+
+	*coord_e7 = (int32_t)llround(deg * GEO_E7_PER_DEG);
+
+	return true;
+}
+
+static bool decode_polygon(zcbor_state_t *zsd, struct geofence *f)
+{
+	if (!zcbor_list_start_decode(zsd)) {
+		return false;
+	}
+
+	while (!zcbor_array_at_end(zsd)) {
+		if (_vertex_count >= MAX_VERTICES) {
+			LOG_ERR("Too many geofence vertices (max %d)", MAX_VERTICES);
+			return false;
+		}
+
+		if (!zcbor_list_start_decode(zsd) ||
+		    !decode_coord(zsd, &_vertices[_vertex_count][0], 90.0) ||
+		    !decode_coord(zsd, &_vertices[_vertex_count][1], 180.0) ||
+		    !zcbor_list_end_decode(zsd)) {
+			return false;
+		}
+
+		_vertex_count++;
+		f->n_vertices++;
+	}
+
+	return zcbor_list_end_decode(zsd);
+}
+
+static int decode_fence(zcbor_state_t *zsd)
+{
+	struct geofence *f = &_fences[_fence_count];
+	struct zcbor_string key;
+	int32_t center[2] = {0};
+	int center_fields = 0;
+	double value;
+	bool has_id = false;
+	bool ok;
+
+	if (_fence_count >= MAX_FENCES) {
+		LOG_ERR("Too many geofences (max %d)", MAX_FENCES);
+		return -ENOMEM;
+	}
+
+	*f = (struct geofence){.first_vertex = _vertex_count};
+
+	if (!zcbor_map_start_decode(zsd)) {
+		return -EBADMSG;
+	}
+
+	while (!zcbor_array_at_end(zsd)) {
+		if (!zcbor_tstr_decode(zsd, &key)) {
+			return -EBADMSG;
+		}
+
+		if (key_is(&key, "id")) {
+			ok = decode_int32(zsd, &f->id);
+			has_id = true;
+		} else if (key_is(&key, "lat")) {
+			ok = decode_coord(zsd, &center[0], 90.0);
+			center_fields++;
+		} else if (key_is(&key, "lon")) {
+			ok = decode_coord(zsd, &center[1], 180.0);
+			center_fields++;
+		} else if (key_is(&key, "radius")) {
+			ok = decode_number(zsd, &value);
+			/* Also rejects NaN, the bounding box must fit in int32_t */
+			if (ok && !((value >= 1.0) && (value <= GEOFENCE_MAX_RADIUS_M))) {
+				LOG_ERR("Geofence radius out of range (1 to %d m)",
+					GEOFENCE_MAX_RADIUS_M);
+				return -EINVAL;
+			}
+			f->radius_m = (uint32_t)value;
+		} else if (key_is(&key, "poly")) {
+			ok = decode_polygon(zsd, f);
+		} else {
+			ok = zcbor_any_skip(zsd, NULL);
+		}
+
+		if (!ok) {
+			return -EBADMSG;
+		}
+	}
+
+	if (!zcbor_map_end_decode(zsd)) {
+		return -EBADMSG;
+	}
+
+	if (!has_id) {
+		LOG_ERR("Geofence without \"id\"");
+		return -EINVAL;
+	}
+
+	if (f->radius_m) {
+		if ((center_fields != 2) || f->n_vertices) {
+			LOG_ERR("Geofence %d: circle needs \"lat\", \"lon\" and \"radius\"", f->id);
+			return -EINVAL;
+		}
+		if (_vertex_count >= MAX_VERTICES) {
+			LOG_ERR("Too many geofence vertices (max %d)", MAX_VERTICES);
+			return -ENOMEM;
+		}
+
+		_vertices[_vertex_count][0] = center[0];
+		_vertices[_vertex_count][1] = center[1];
+		_vertex_count++;
+		f->n_vertices = 1;
+
+		/* Half the size of the bounding box, in 1e-7 degrees */
+		double lat_rad = (center[0] / (double)GEO_E7_PER_DEG) * (M_PI / 180.0);
+		double dlat = (f->radius_m / METERS_PER_DEG_LAT) * GEO_E7_PER_DEG;
+		double dlon = dlat / fmax(cos(lat_rad), 0.01);
+
+		f->min_lat = (int32_t)MAX(center[0] - dlat, -90.0 * GEO_E7_PER_DEG);
+		f->max_lat = (int32_t)MIN(center[0] + dlat, 90.0 * GEO_E7_PER_DEG);
+		f->min_lon = (int32_t)MAX(center[1] - dlon, -180.0 * GEO_E7_PER_DEG);
+		f->max_lon = (int32_t)MIN(center[1] + dlon, 180.0 * GEO_E7_PER_DEG);
+	} else {
+		if (f->n_vertices < 3) {
+			LOG_ERR("Geofence %d: polygon needs at least 3 vertices", f->id);
+			return -EINVAL;
+		}
+
+		f->min_lat = f->max_lat = _vertices[f->first_vertex][0];
+		f->min_lon = f->max_lon = _vertices[f->first_vertex][1];
+		for (size_t i = f->first_vertex; i < _vertex_count; i++) {
+			f->min_lat = MIN(f->min_lat, _vertices[i][0]);
+			f->max_lat = MAX(f->max_lat, _vertices[i][0]);
+			f->min_lon = MIN(f->min_lon, _vertices[i][1]);
+			f->max_lon = MAX(f->max_lon, _vertices[i][1]);
+		}
+	}
+
+	_fence_count++;
+
+	return 0;
+}
+
+static int decode_fences(const uint8_t *payload, size_t payload_size)
+{
+	ZCBOR_STATE_D(zsd, 5, payload, payload_size, 1, 0);
+	struct zcbor_string key;
+	int err;
+
+	geofence_clear();
+
+	/* A missing or null endpoint simply means there are no geofences */
+	if ((payload_size == 0) || zcbor_nil_expect(zsd, NULL)) {
+		return 0;
+	}
+
+	if (!zcbor_map_start_decode(zsd)) {
+		return -EBADMSG;
+	}
+
+	while (!zcbor_array_at_end(zsd)) {
+		if (!zcbor_tstr_decode(zsd, &key)) {
+			return -EBADMSG;
+		}
+
+		if (key_is(&key, "version")) {
+			if (!decode_int32(zsd, &_version)) {
+				return -EBADMSG;
+			}
+		} else if (key_is(&key, "fences")) {
+			if (!zcbor_list_start_decode(zsd)) {
+				return -EBADMSG;
+			}
+			while (!zcbor_array_at_end(zsd)) {
+				err = decode_fence(zsd);
+				if (err) {
+					return err;
+				}
+			}
+			if (!zcbor_list_end_decode(zsd)) {
+				return -EBADMSG;
+			}
+		} else if (!zcbor_any_skip(zsd, NULL)) {
+			return -EBADMSG;
+		}
+	}
+
+	if (!zcbor_map_end_decode(zsd)) {
+		return -EBADMSG;
+	}
+
+	for (size_t i = 0; i < _fence_count; i++) {
+		err = grid_index_fence(i);
+		if (err) {
+			LOG_ERR("Geofence grid index full (max %d entries)", GRID_ENTRIES);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+int geofence_load(const uint8_t *payload, size_t payload_size)
+{
+	int err;
+
+	err = decode_fences(payload, payload_size);
+	if (err) {
+		geofence_clear();
+		return err;
+	}
+
+	LOG_INF("Loaded %zu geofences (version %d, %zu vertices, %zu grid entries)", _fence_count,
+		_version, _vertex_count, _entry_count);
+
+	return 0;
+}
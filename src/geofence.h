@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/** Geofence store and grid index.
+ *
+ * Decodes geofences from CBOR (see app_geofence.h for the format) into
+ * fixed-size pools and indexes them in a uniform grid, hashed into a fixed
+ * number of buckets. Each fix is only tested against the fences in its grid
+ * cell, plus the few fences spanning too many cells to index.
+ *
+ * Circles may have a radius of 1 m to GEOFENCE_MAX_RADIUS_M.
+ *
+ * Not thread safe, the caller serializes all calls.
+ */
+
+#ifndef __GEOFENCE_H__
+#define __GEOFENCE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "track_codec.h"
+
+/** Largest circle radius accepted, in meters */
+#define GEOFENCE_MAX_RADIUS_M 1000000
+
+/**
+ * Called for each geofence entered or left.
+ *
+ * @param id ID of the geofence
+ * @param enter true if the geofence was entered, false if it was left
+ * @param pt position that entered or left the geofence
+ */
+typedef void (*geofence_event_cb)(int32_t id, bool enter, const struct track_point *pt);
+
+/**
+ * Replace all geofences with the ones of a CBOR document.
+ *
+ * @param payload CBOR document, or an empty or null payload for no geofences
+ * @param payload_size size of @p payload
+ *
+ * @return 0 on success, or a negative error code, in which case all geofences
+ * are removed
+ */
+int geofence_load(const uint8_t *payload, size_t payload_size);
+
+/** Remove all geofences. */
+void geofence_clear(void);
+
+/**
+ * Check a new position against the geofences.
+ *
+ * @param pt new position
+ * @param cb called for each geofence entered or left since the previous position
+ */
+void geofence_evaluate(const struct track_point *pt, geofence_event_cb cb);
+
+#endif /* __GEOFENCE_H__ */
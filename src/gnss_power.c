@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(gnss_power, LOG_LEVEL_DBG);
+
+#include <golioth/stream.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "app_settings.h"
+#include "app_stats.h"
+#include "format_helper.h"
+#include "gnss_power.h"
+#include "time_base.h"
+
+#define GOLIOTH_STREAM_TIMEOUT_S 2
+
+#define UBX_SYNC_CHAR_1 0xB5
+#define UBX_SYNC_CHAR_2 0x62
+
+#define UBX_CLASS_RXM	      0x02
+#define UBX_ID_RXM_PMREQ      0x41
+#define UBX_PMREQ_LEN	      16
+#define UBX_PMREQ_BACKUP      BIT(1)
+#define UBX_PMREQ_FORCE	      BIT(2)
+#define UBX_PMREQ_WAKE_UARTRX BIT(3)
+
+#define UBX_CLASS_CFG	       0x06
+#define UBX_ID_CFG_RST	       0x04
+#define UBX_CFG_RST_LEN	       4
+#define UBX_CFG_RST_HOT_START  0x0000
+#define UBX_CFG_RST_GNSS_START 0x09
+
+/* Bytes sent to generate UART activity; the receiver discards them while waking up */
+#define WAKEUP_PULSE_LEN 8
+#define WAKEUP_DELAY_MS	 100
+
+/* Give up on a periodic fix after this long, to avoid draining the battery indoors */
+#define FIX_TIMEOUT_MS (120 * 1000)
+
+enum gnss_power_state {
+	GNSS_POWER_ON,
+	GNSS_POWER_BACKUP,
+};
+
+static const struct device *_uart;
+
+K_MUTEX_DEFINE(gnss_power_mutex);
+static enum gnss_power_state _state = GNSS_POWER_ON;
+static int64_t _state_since;
+static int64_t _on_time_ms;
+static int64_t _last_moving;
+static bool _fix_since_wake;
+
+/* Uptime of the last report, -1 before the first one */
+static int64_t _last_report_ms = -1;
+/* Set on a power state transition, cleared once the report is sent */
+static bool _report_pending;
+
+static void ubx_send(uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint16_t len)
+{
+	uint8_t header[] = {UBX_SYNC_CHAR_1, UBX_SYNC_CHAR_2, msg_class, msg_id, len & 0xFF,
+			    len >> 8};
+	uint8_t ck_a = 0;
+	uint8_t ck_b = 0;
+
+	/* 8-bit Fletcher checksum over class, id, length and payload */
+	for (size_t i = 2; i < sizeof(header); i++) {
+		ck_a += header[i];
+		ck_b += ck_a;
+	}
+	for (size_t i = 0; i < len; i++) {
+		ck_a += payload[i];
+		ck_b += ck_a;
+	}
+
+	for (size_t i = 0; i < sizeof(header); i++) {
+		uart_poll_out(_uart, header[i]);
+	}
+	for (size_t i = 0; i < len; i++) {
+		uart_poll_out(_uart, payload[i]);
+	}
+	uart_poll_out(_uart, ck_a);
+	uart_poll_out(_uart, ck_b);
+}
+
+static void set_state(enum gnss_power_state state, int64_t now)
+{
+	if (_state == GNSS_POWER_ON) {
+		_on_time_ms += now - _state_since;
+	}
+
+	if (_state != state) {
+		_report_pending = true;
+	}
+
+	_state = state;
+	_state_since = now;
+}
+
+static void enter_backup(int64_t now)
+{
+	uint8_t pmreq[UBX_PMREQ_LEN] = {0};
+
+	/* version 0, duration 0 (until woken up) */
+	sys_put_le32(UBX_PMREQ_BACKUP | UBX_PMREQ_FORCE, &pmreq[8]);
+	sys_put_le32(UBX_PMREQ_WAKE_UARTRX, &pmreq[12]);
+	ubx_send(UBX_CLASS_RXM, UBX_ID_RXM_PMREQ, pmreq, sizeof(pmreq));
+
+	set_state(GNSS_POWER_BACKUP, now);
+}
+
+static void wake_up(int64_t now)
+{
+	uint8_t rst[UBX_CFG_RST_LEN] = {0};
+
+	for (int i = 0; i < WAKEUP_PULSE_LEN; i++) {
+		uart_poll_out(_uart, 0xFF);
+	}
+	k_msleep(WAKEUP_DELAY_MS);
+
+	/* Battery-backed RAM is kept, so the receiver resumes with a hot start */
+	sys_put_le16(UBX_CFG_RST_HOT_START, &rst[0]);
+	rst[2] = UBX_CFG_RST_GNSS_START;
+	ubx_send(UBX_CLASS_CFG, UBX_ID_CFG_RST, rst, sizeof(rst));
+
+	_fix_since_wake = false;
+	set_state(GNSS_POWER_ON, now);
+}
+
+void gnss_power_init(const struct device *uart)
+{
+	int64_t now = k_uptime_get();
+
+	_uart = uart;
+
+	k_mutex_lock(&gnss_power_mutex, K_FOREVER);
+	_state = GNSS_POWER_ON;
+	_state_since = now;
+	_last_moving = now;
+	k_mutex_unlock(&gnss_power_mutex);
+}
+
+void gnss_power_update(int vehicle_speed)
+{
+	int64_t now = k_uptime_get();
+	int64_t standby_delay_ms = (int64_t)get_gnss_standby_delay_s() * 1000;
+	int64_t wake_interval_ms = (int64_t)get_gnss_wake_interval_s() * 1000;
+
+	k_mutex_lock(&gnss_power_mutex, K_FOREVER);
+
+	if (vehicle_speed != 0) {
+		_last_moving = now;
+	}
+
+	switch (_state) {
+	case GNSS_POWER_ON:
+		if ((standby_delay_ms > 0) && ((now - _last_moving) >= standby_delay_ms) &&
+		    (_fix_since_wake || ((now - _state_since) >= FIX_TIMEOUT_MS))) {
+			LOG_INF("Vehicle stationary, GNSS receiver entering backup mode");
+			enter_backup(now);
+		}
+		break;
+	case GNSS_POWER_BACKUP:
+		if ((vehicle_speed != 0) || (standby_delay_ms == 0)) {
+			LOG_INF("Vehicle moving, waking up GNSS receiver");
+			wake_up(now);
+		} else if ((wake_interval_ms > 0) && ((now - _state_since) >= wake_interval_ms)) {
+			LOG_INF("Waking up GNSS receiver for a periodic fix");
+			wake_up(now);
+		}
+		break;
+	}
+
+	k_mutex_unlock(&gnss_power_mutex);
+}
+
+bool gnss_power_fix_received(bool valid)
+{
+	bool first;
+
+	if (!valid) {
+		return false;
+	}
+
+	k_mutex_lock(&gnss_power_mutex, K_FOREVER);
+	first = !_fix_since_wake;
+	_fix_since_wake = true;
+	k_mutex_unlock(&gnss_power_mutex);
+
+	return first;
+}
+
+void gnss_power_report(struct golioth_client *client)
+{
+	char json_buf[64 + FORMAT_TIME_LEN];
+	char ts_str[FORMAT_TIME_LEN];
+	int64_t now = k_uptime_get();
+	int64_t time_ms = time_base_utc_ms(now);
+	int64_t on_time_ms;
+	bool on;
+	int err;
+
+	k_mutex_lock(&gnss_power_mutex, K_FOREVER);
+	if (!_report_pending && (_last_report_ms >= 0) &&
+	    ((now - _last_report_ms) < (CONFIG_APP_STATS_REPORT_INTERVAL_S * 1000LL))) {
+		k_mutex_unlock(&gnss_power_mutex);
+		return;
+	}
+	on = (_state == GNSS_POWER_ON);
+	on_time_ms = _on_time_ms + (on ? (now - _state_since) : 0);
+	_report_pending = false;
+	_last_report_ms = now;
+	k_mutex_unlock(&gnss_power_mutex);
+
+	if (time_ms) {
+		format_time_ms(ts_str, sizeof(ts_str), time_ms);
+		snprintk(json_buf, sizeof(json_buf),
+			 "{\"time\":\"%s\",\"on\":%s,\"on_time_s\":%u,\"uptime_s\":%u}", ts_str,
+			 on ? "true" : "false", (uint32_t)(on_time_ms / 1000),
+			 (uint32_t)(now / 1000));
+	} else {
+		snprintk(json_buf, sizeof(json_buf), "{\"on\":%s,\"on_time_s\":%u,\"uptime_s\":%u}",
+			 on ? "true" : "false", (uint32_t)(on_time_ms / 1000),
+			 (uint32_t)(now / 1000));
+	}
+
+	err = golioth_stream_set_sync(client, GNSS_POWER_STREAM_ENDP, GOLIOTH_CONTENT_TYPE_JSON,
+				      json_buf, strlen(json_buf), GOLIOTH_STREAM_TIMEOUT_S);
+	if (err) {
+		LOG_ERR("Failed to send GNSS power state to Golioth: %d", err);
+		app_stats_inc(APP_STAT_STREAM_ERRORS);
+
+		/* Retry on the next pass */
+		k_mutex_lock(&gnss_power_mutex, K_FOREVER);
+		_report_pending = true;
+		k_mutex_unlock(&gnss_power_mutex);
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __GNSS_POWER_H__
+#define __GNSS_POWER_H__
+
+/** Motion-aware duty cycling of the GNSS receiver.
+ *
+ * The u-blox receiver on the GNSS 7 Click is put in backup mode (UBX-RXM-PMREQ)
+ * once the vehicle speed reported over CAN has been 0 km/h for
+ * `GNSS_STANDBY_DELAY_S` seconds. It is woken up (by UART activity, followed by
+ * a UBX-CFG-RST hot start) as soon as the vehicle moves, and every
+ * `GNSS_WAKE_INTERVAL_S` seconds for a fresh fix while parked.
+ *
+ * An unknown vehicle speed (no reply from the ECU) keeps the receiver on.
+ */
+
+#include <stdbool.h>
+#include <golioth/client.h>
+#include <zephyr/device.h>
+
+#define GNSS_POWER_STREAM_ENDP "gnss"
+
+/**
+ * Start tracking the receiver power state. The receiver is assumed to be on.
+ *
+ * @param uart UART the receiver is connected to
+ */
+void gnss_power_init(const struct device *uart);
+
+/**
+ * Run the power state machine with the latest vehicle speed.
+ *
+ * @param vehicle_speed vehicle speed in km/h, -1 if unknown
+ */
+void gnss_power_update(int vehicle_speed);
+
+/**
+ * Notify the state machine that an RMC sentence was received.
+ *
+ * @return true for the first valid fix since boot or since the receiver woke up
+ */
+bool gnss_power_fix_received(bool valid);
+
+/**
+ * Stream the receiver power state and accumulated on-time to Golioth.
+ *
+ * Only sends a record after a power state transition, or once every
+ * CONFIG_APP_STATS_REPORT_INTERVAL_S otherwise.
+ */
+void gnss_power_report(struct golioth_client *client);
+
+#endif /* __GNSS_POWER_H__ */
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(harsh_driving, LOG_LEVEL_DBG);
+
+#include <math.h>
+#include <zephyr/kernel.h>
+
+#include "app_events.h"
+#include "app_settings.h"
+#include "harsh_driving.h"
+
+#define PRE_SAMPLES  CONFIG_APP_HARSH_PRE_SAMPLES
+#define POST_SAMPLES CONFIG_APP_HARSH_POST_SAMPLES
+#define WINDOW_MS    CONFIG_APP_HARSH_WINDOW_MS
+
+/* Fewer samples than this in the window are not enough to fit a slope */
+#define MIN_FIT_SAMPLES 3
+/* Samples further apart than this do not belong to the same window */
+#define MAX_GAP_MS	(2 * WINDOW_MS)
+/* An event is posted at the latest this long after its trigger */
+#define MAX_POST_MS	(POST_SAMPLES * CONFIG_APP_HARSH_POLL_MS + WINDOW_MS)
+/* 1 km/h/s in milli-g */
+#define KMH_PER_S_TO_MG (1000.0f / 3.6f / 9.80665f)
+
+#define RING_SIZE 32
+BUILD_ASSERT(RING_SIZE >= PRE_SAMPLES, "Ring buffer too small for the pre-event window");
+
+struct speed_sample {
+	int64_t time_ms;
+	int16_t speed;
+};
+
+static struct speed_sample _ring[RING_SIZE];
+static size_t _ring_head;
+static size_t _ring_len;
+/* Time of the last sample with a non-zero speed */
+static int64_t _last_moving_ms;
+
+static struct {
+	bool active;
+	bool brake;
+	/* Re-armed once the acceleration falls back below half the threshold */
+	bool armed;
+	int32_t peak_mg;
+	int64_t trigger_ms;
+	struct speed_sample samples[PRE_SAMPLES + POST_SAMPLES];
+	size_t n_samples;
+} _event = {.armed = true};
+
+bool harsh_driving_enabled(void)
+{
+	return (get_harsh_accel_mg() > 0) || (get_harsh_brake_mg() > 0);
+}
+
+static const struct speed_sample *ring_at(size_t age)
+{
+	return &_ring[(_ring_head + RING_SIZE - 1 - age) % RING_SIZE];
+}
+
+static void ring_push(int64_t time_ms, int speed)
+{
+	_ring[_ring_head] = (struct speed_sample){.time_ms = time_ms, .speed = speed};
+	_ring_head = (_ring_head + 1) % RING_SIZE;
+	_ring_len = MIN(_ring_len + 1, RING_SIZE);
+}
+
+bool harsh_driving_busy(void)
+{
+	if (_event.active) {
+		return true;
+	}
+
+	/* Keep sampling a stop fast enough to fit the slope down to 0 km/h */
+	return (_ring_len > 0) && ((ring_at(0)->time_ms - _last_moving_ms) <= WINDOW_MS);
+}
+
+/* Least-squares slope of speed over time in the window, in milli-g */
+static int fit_accel_mg(int32_t *accel_mg)
+{
+	const struct speed_sample *newest = ring_at(0);
+	float sum_t = 0.0f, sum_v = 0.0f, sum_tt = 0.0f, sum_tv = 0.0f;
+	size_t n = 0;
+
+	for (size_t age = 0; age < _ring_len; age++) {
+		const struct speed_sample *s = ring_at(age);
+		float t = (newest->time_ms - s->time_ms) / -1000.0f;
+
+		if ((newest->time_ms - s->time_ms) > WINDOW_MS) {
+			break;
+		}
+
+		sum_t += t;
+		sum_v += s->speed;
+		sum_tt += t * t;
+		sum_tv += t * s->speed;
+		n++;
+	}
+
+	float denom = n * sum_tt - sum_t * sum_t;
+
+	if ((n < MIN_FIT_SAMPLES) || (denom <= 0.0f)) {
+		return -ENODATA;
+	}
+
+	*accel_mg = (int32_t)lroundf((n * sum_tv - sum_t * sum_v) / denom * KMH_PER_S_TO_MG);
+
+	return 0;
+}
+
+static void post_event(void)
+{
+	char t_str[(PRE_SAMPLES + POST_SAMPLES) * 7 + 1];
+	char v_str[(PRE_SAMPLES + POST_SAMPLES) * 4 + 1];
+	size_t t_len = 0;
+	size_t v_len = 0;
+
+	for (size_t i = 0; i < _event.n_samples; i++) {
+		const struct speed_sample *s = &_event.samples[i];
+		const char *sep = (i == 0) ? "" : ",";
+
+		t_len += snprintk(&t_str[t_len], sizeof(t_str) - MIN(t_len, sizeof(t_str)), "%s%d",
+				  sep, (int)(s->time_ms - _event.trigger_ms));
+		v_len += snprintk(&v_str[v_len], sizeof(v_str) - MIN(v_len, sizeof(v_str)), "%s%d",
+				  sep, s->speed);
+	}
+
+	LOG_WRN("Harsh %s: %d mg", _event.brake ? "braking" : "acceleration", _event.peak_mg);
+
+	app_events_post("harsh", _event.trigger_ms, true,
+			"\"type\":\"%s\",\"peak_mg\":%d,\"t_ms\":[%s],\"kmh\":[%s]",
+			_event.brake ? "brake" : "accel", _event.peak_mg, t_str, v_str);
+}
+
+static void start_event(bool brake, int32_t accel_mg)
+{
+	size_t n_pre = MIN(_ring_len, PRE_SAMPLES);
+
+	_event.active = true;
+	_event.armed = false;
+	_event.brake = brake;
+	_event.peak_mg = accel_mg;
+	_event.trigger_ms = ring_at(0)->time_ms;
+	_event.n_samples = 0;
+
+	/* Pre-event window, oldest first, ending with the trigger sample */
+	for (size_t age = n_pre; age > 0; age--) {
+		_event.samples[_event.n_samples++] = *ring_at(age - 1);
+	}
+}
+
+void harsh_driving_sample(int64_t time_ms, int vehicle_speed)
+{
+	int32_t accel_threshold_mg = get_harsh_accel_mg();
+	int32_t brake_threshold_mg = get_harsh_brake_mg();
+	int32_t accel_mg;
+	bool fitted;
+
+	if ((vehicle_speed < 0) ||
+	    ((_ring_len > 0) && ((time_ms - ring_at(0)->time_ms) > MAX_GAP_MS))) {
+		/* A gap in the samples: start over, but finish a pending event first */
+		if (_event.active) {
+			post_event();
+			_event.active = false;
+		}
+		_ring_len = 0;
+		_event.armed = true;
+		if (vehicle_speed < 0) {
+			return;
+		}
+	}
+
+	ring_push(time_ms, vehicle_speed);
+	if (vehicle_speed > 0) {
+		_last_moving_ms = time_ms;
+	}
+
+	fitted = (fit_accel_mg(&accel_mg) == 0);
+
+	if (_event.active) {
+		/* Post samples are kept even if too sparse to fit a slope */
+		_event.samples[_event.n_samples++] = *ring_at(0);
+		if (fitted && _event.brake) {
+			_event.peak_mg = MIN(_event.peak_mg, accel_mg);
+		} else if (fitted) {
+			_event.peak_mg = MAX(_event.peak_mg, accel_mg);
+		}
+
+		if ((_event.n_samples == ARRAY_SIZE(_event.samples)) ||
+		    ((time_ms - _event.trigger_ms) >= MAX_POST_MS)) {
+			post_event();
+			_event.active = false;
+		}
+		return;
+	}
+
+	if (!fitted) {
+		return;
+	}
+
+	if (!_event.armed) {
+		_event.armed = ((accel_threshold_mg == 0) || (accel_mg < accel_threshold_mg / 2)) &&
+			       ((brake_threshold_mg == 0) || (-accel_mg < brake_threshold_mg / 2));
+		return;
+	}
+
+	if ((accel_threshold_mg > 0) && (accel_mg >= accel_threshold_mg)) {
+		start_event(false, accel_mg);
+	} else if ((brake_threshold_mg > 0) && (-accel_mg >= brake_threshold_mg)) {
+		start_event(true, accel_mg);
+	}
+}
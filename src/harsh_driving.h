@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __HARSH_DRIVING_H__
+#define __HARSH_DRIVING_H__
+
+/** Harsh acceleration and braking detection from vehicle speed samples.
+ *
+ * Acceleration is the least-squares slope of the speed samples received in the
+ * last CONFIG_APP_HARSH_WINDOW_MS milliseconds. Fitting a line over several
+ * samples rejects the 1 km/h quantization of the OBD-II vehicle speed, which
+ * differentiating consecutive samples would amplify into spikes.
+ *
+ * When the acceleration crosses `HARSH_ACCEL_MG` (or the deceleration crosses
+ * `HARSH_BRAKE_MG`), the samples leading up to it are kept and an urgent
+ * "harsh" event is posted once CONFIG_APP_HARSH_POST_SAMPLES more samples have
+ * been received, or CONFIG_APP_HARSH_WINDOW_MS after they were expected at
+ * CONFIG_APP_HARSH_POLL_MS, whichever comes first. Urgent events wake the main
+ * loop, so they are uploaded within seconds instead of waiting for the next
+ * `LOOP_DELAY_S`.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Feed a vehicle speed sample.
+ *
+ * @param time_ms uptime in milliseconds at which the sample was received
+ * @param vehicle_speed vehicle speed in km/h, -1 if unknown
+ */
+void harsh_driving_sample(int64_t time_ms, int vehicle_speed);
+
+/** Return true if harsh driving detection is enabled in the settings. */
+bool harsh_driving_enabled(void);
+
+/**
+ * Return true while samples are needed at CONFIG_APP_HARSH_POLL_MS.
+ *
+ * That is while an event is being recorded, and for one window after the last
+ * sample with a non-zero speed, so that braking to a stop is still detected.
+ */
+bool harsh_driving_busy(void);
+
+#endif /* __HARSH_DRIVING_H__ */
@@ -9,13 +9,24 @@
 
 #include <zephyr/data/json.h>
 
+/*
+ * LightDB State fields, in the order of the JSON documents. Each is an integer
+ * X(name, default, min, max, on_change): a desired value in [min..max] is
+ * applied and on_change(value) called if not NULL. -1 is the "no change"
+ * value, so min must not be negative.
+ */
+#define APP_STATE_FIELDS(X)                                                                        \
+	X(example_int0, 0, 0, 65535, NULL)                                                         \
+	X(example_int1, 1, 0, 65535, NULL)
+
+#define APP_STATE_MEMBER(_name, _default, _min, _max, _on_change) int32_t _name;
+#define APP_STATE_DESCR(_name, _default, _min, _max, _on_change)                                   \
+	JSON_OBJ_DESCR_PRIM(struct app_state, _name, JSON_TOK_NUMBER),
+
 struct app_state {
-	int32_t example_int0;
-	int32_t example_int1;
+	APP_STATE_FIELDS(APP_STATE_MEMBER)
 };
 
-static const struct json_obj_descr app_state_descr[] = {
-	JSON_OBJ_DESCR_PRIM(struct app_state, example_int0, JSON_TOK_NUMBER),
-	JSON_OBJ_DESCR_PRIM(struct app_state, example_int1, JSON_TOK_NUMBER)};
+static const struct json_obj_descr app_state_descr[] = {APP_STATE_FIELDS(APP_STATE_DESCR)};
 
 #endif
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(log_shipper, LOG_LEVEL_DBG);
+
+#include <string.h>
+#include <golioth/client.h>
+#include <golioth/log.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log_backend.h>
+#include <zephyr/logging/log_ctrl.h>
+#include <zephyr/logging/log_output.h>
+
+#include "log_shipper.h"
+#include "track_queue.h"
+
+#define MAX_SOURCES CONFIG_APP_LOG_SHIPPER_MAX_SOURCES
+#define BATCH_TAG   "app"
+/* Prefix of the Golioth SDK log modules */
+#define SDK_PREFIX  "golioth"
+
+/* Tokens are kept in thousandths so buckets refill smoothly */
+#define TOKEN	    1000
+#define BUCKET_SIZE (CONFIG_APP_LOG_SHIPPER_BURST * TOKEN)
+
+/* Golioth client requests waiting to be sent above which uploads are backed up */
+#define CLIENT_QUEUE_BACKLOG 4
+
+/* Budget and duplicate suppression state of one log module */
+struct source_budget {
+	uint32_t tokens;
+	uint32_t refilled_ms;
+	uint32_t last_hash;
+	uint16_t repeats;
+	uint16_t dropped;
+};
+
+static struct golioth_client *_client;
+static bool _panic;
+
+/* The record being formatted, only used from the logging thread */
+static char _line[CONFIG_APP_LOG_SHIPPER_LINE_LEN];
+static size_t _line_len;
+
+/* Budgets and batch are shared by the logging thread and the flush work */
+K_MUTEX_DEFINE(batch_mutex);
+static struct source_budget _sources[MAX_SOURCES];
+static char _batch[CONFIG_APP_LOG_SHIPPER_BATCH_LEN];
+static size_t _batch_len;
+static uint8_t _batch_level = LOG_LEVEL_NONE;
+
+static int line_out(uint8_t *data, size_t length, void *ctx)
+{
+	size_t len = MIN(length, sizeof(_line) - 1 - _line_len);
+
+	memcpy(&_line[_line_len], data, len);
+	_line_len += len;
+	_line[_line_len] = '\0';
+
+	return length;
+}
+
+static uint8_t output_buf[32];
+LOG_OUTPUT_DEFINE(log_output_shipper, line_out, output_buf, sizeof(output_buf));
+
+static void flush_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(flush_work, flush_work_handler);
+
+static uint32_t fnv1a(const char *str)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*str) {
+		hash = (hash ^ (uint8_t)*str++) * 16777619U;
+	}
+
+	return hash;
+}
+
+static int16_t msg_source_id(struct log_msg *msg)
+{
+	void *source = (void *)log_msg_get_source(msg);
+
+	if (source == NULL) {
+		return -1;
+	}
+
+	return IS_ENABLED(CONFIG_LOG_RUNTIME_FILTERING) ? log_dynamic_source_id(source)
+						       : log_const_source_id(source);
+}
+
+static bool uploads_backed_up(void)
+{
+	return (track_queue_used() > (CONFIG_APP_TRACK_QUEUE_SIZE / 2)) ||
+	       (golioth_client_num_items_in_request_queue(_client) > CLIENT_QUEUE_BACKLOG);
+}
+
+static bool take_token(struct source_budget *budget, uint32_t backoff)
+{
+	uint32_t now = k_uptime_get_32();
+	uint64_t refill = (uint64_t)(now - budget->refilled_ms) * TOKEN *
+			  CONFIG_APP_LOG_SHIPPER_RATE_PER_MIN / (60 * MSEC_PER_SEC * backoff);
+
+	budget->tokens = MIN(BUCKET_SIZE, budget->tokens + refill);
+	budget->refilled_ms = now;
+
+	if (budget->tokens < TOKEN) {
+		return false;
+	}
+	budget->tokens -= TOKEN;
+
+	return true;
+}
+
+/*
+ * The Golioth SDK logs while sending. Its records are not shipped, so that
+ * sending a batch never feeds records back into the next one, and the backend
+ * is never re-entered from the send path when logging is not deferred.
+ */
+static bool is_sdk_source(int16_t source_id)
+{
+	const char *name = log_source_name_get(0, source_id);
+
+	return (name != NULL) && (strncmp(name, SDK_PREFIX, strlen(SDK_PREFIX)) == 0);
+}
+
+/* Only called from the flush work, never from the backend itself */
+static void send_batch_locked(void)
+{
+	switch (_batch_level) {
+	case LOG_LEVEL_ERR:
+		golioth_log_error_async(_client, BATCH_TAG, _batch, NULL, NULL);
+		break;
+	case LOG_LEVEL_WRN:
+		golioth_log_warn_async(_client, BATCH_TAG, _batch, NULL, NULL);
+		break;
+	case LOG_LEVEL_INF:
+		golioth_log_info_async(_client, BATCH_TAG, _batch, NULL, NULL);
+		break;
+	default:
+		golioth_log_debug_async(_client, BATCH_TAG, _batch, NULL, NULL);
+		break;
+	}
+
+	_batch_len = 0;
+	_batch[0] = '\0';
+	_batch_level = LOG_LEVEL_NONE;
+}
+
+/* Return false if the batch is full */
+static bool append_locked(uint8_t level, const char *line)
+{
+	size_t len = strlen(line);
+
+	if ((_batch_len + len + 2) > sizeof(_batch)) {
+		return false;
+	}
+
+	if (_batch_len) {
+		_batch[_batch_len++] = '\n';
+	}
+	memcpy(&_batch[_batch_len], line, len + 1);
+	_batch_len += len;
+
+	/* The batch is sent at the level of its most severe record */
+	if ((_batch_level == LOG_LEVEL_NONE) || (level < _batch_level)) {
+		_batch_level = level;
+	}
+
+	return true;
+}
+
+/* Report repeated and dropped records of a module that were not reported yet */
+static void append_notes_locked(int16_t source_id)
+{
+	struct source_budget *budget = &_sources[source_id];
+	const char *name = log_source_name_get(0, source_id);
+	char note[64];
+
+	/* Notes that do not fit are kept for the next batch */
+	if (budget->repeats) {
+		snprintk(note, sizeof(note), "<inf> %s: last message repeated %u times", name,
+			 budget->repeats);
+		if (append_locked(LOG_LEVEL_INF, note)) {
+			budget->repeats = 0;
+		}
+	}
+	if (budget->dropped) {
+		snprintk(note, sizeof(note), "<inf> %s: %u messages over budget dropped", name,
+			 budget->dropped);
+		if (append_locked(LOG_LEVEL_INF, note)) {
+			budget->dropped = 0;
+		}
+	}
+}
+
+static void append_all_notes_locked(void)
+{
+	for (int16_t i = 0; i < MIN(MAX_SOURCES, log_src_cnt_get(0)); i++) {
+		append_notes_locked(i);
+	}
+}
+
+static void flush_work_handler(struct k_work *work)
+{
+	k_mutex_lock(&batch_mutex, K_FOREVER);
+
+	append_all_notes_locked();
+	if (_batch_len == 0) {
+		goto unlock;
+	}
+
+	if (!golioth_client_is_connected(_client)) {
+		/* Kept until connected, new records are dropped once it is full */
+		k_work_reschedule(&flush_work, K_MSEC(CONFIG_APP_LOG_SHIPPER_FLUSH_MS));
+		goto unlock;
+	}
+
+	send_batch_locked();
+
+	/* Notes that did not fit in the batch just sent */
+	append_all_notes_locked();
+	if (_batch_len) {
+		k_work_reschedule(&flush_work, K_MSEC(CONFIG_APP_LOG_SHIPPER_FLUSH_MS));
+	}
+
+unlock:
+	k_mutex_unlock(&batch_mutex);
+}
+
+static void process(const struct log_backend *const backend, union log_msg_generic *msg)
+{
+	uint8_t level = log_msg_get_level(&msg->log);
+	int16_t source_id = msg_source_id(&msg->log);
+	uint32_t backoff = 1;
+	struct source_budget *budget = NULL;
+	bool flush_now = (level == LOG_LEVEL_ERR);
+	uint32_t hash;
+
+	/* Raw printk-style records have no level and are not shipped */
+	if (_panic || (_client == NULL) || (level == LOG_LEVEL_NONE)) {
+		return;
+	}
+
+	if ((source_id >= 0) && is_sdk_source(source_id)) {
+		return;
+	}
+
+	_line_len = 0;
+	_line[0] = '\0';
+	log_output_msg_process(&log_output_shipper, &msg->log,
+			       LOG_OUTPUT_FLAG_LEVEL | LOG_OUTPUT_FLAG_CRLF_NONE);
+
+	if (uploads_backed_up()) {
+		backoff = CONFIG_APP_LOG_SHIPPER_BACKOFF;
+	}
+
+	k_mutex_lock(&batch_mutex, K_FOREVER);
+
+	if ((source_id >= 0) && (source_id < MAX_SOURCES)) {
+		budget = &_sources[source_id];
+		hash = fnv1a(_line);
+
+		/* Suppressed records are still reported by the next flush */
+		if (hash == budget->last_hash) {
+			budget->repeats = MIN(budget->repeats + 1, UINT16_MAX);
+			goto schedule;
+		}
+		budget->last_hash = hash;
+
+		if ((level != LOG_LEVEL_ERR) && !take_token(budget, backoff)) {
+			budget->dropped = MIN(budget->dropped + 1, UINT16_MAX);
+			goto schedule;
+		}
+
+		append_notes_locked(source_id);
+	}
+
+	if (!append_locked(level, _line)) {
+		/* The batch is full until the flush work sends it */
+		if (budget) {
+			budget->dropped = MIN(budget->dropped + 1, UINT16_MAX);
+		}
+		flush_now = true;
+	}
+
+schedule:
+	if (flush_now && golioth_client_is_connected(_client)) {
+		k_work_reschedule(&flush_work, K_NO_WAIT);
+	} else {
+		/* No-op if a flush is already pending, so records are batched */
+		k_work_schedule(&flush_work, K_MSEC(CONFIG_APP_LOG_SHIPPER_FLUSH_MS * backoff));
+	}
+
+	k_mutex_unlock(&batch_mutex);
+}
+
+static void panic(const struct log_backend *const backend)
+{
+	/* Nothing can be sent from a panic context */
+	_panic = true;
+}
+
+static const struct log_backend_api log_shipper_api = {
+	.process = process,
+	.panic = panic,
+};
+
+LOG_BACKEND_DEFINE(log_backend_shipper, log_shipper_api, false);
+
+void log_shipper_start(struct golioth_client *client)
+{
+	const struct log_backend *sdk_backend = log_backend_get_by_name("log_backend_golioth");
+
+	for (int i = 0; i < MAX_SOURCES; i++) {
+		_sources[i].tokens = BUCKET_SIZE;
+	}
+	_client = client;
+
+	if (sdk_backend) {
+		log_backend_disable(sdk_backend);
+	} else {
+		LOG_WRN("Golioth SDK log backend not found, logs may be sent twice");
+	}
+
+	log_backend_enable(&log_backend_shipper, NULL, CONFIG_LOG_MAX_LEVEL);
+}
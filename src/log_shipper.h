@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __LOG_SHIPPER_H__
+#define __LOG_SHIPPER_H__
+
+/** Budgeted, batched log backend for the Golioth Logging service.
+ *
+ * Takes the place of the Golioth SDK log backend, which sends every log
+ * record in its own message. Instead:
+ *
+ * - each log module gets a token bucket of CONFIG_APP_LOG_SHIPPER_BURST
+ *   records, refilled at CONFIG_APP_LOG_SHIPPER_RATE_PER_MIN records per
+ *   minute. Records beyond the budget are dropped and counted. Errors are
+ *   never dropped.
+ * - a record identical to the previous one of the same module is counted
+ *   instead of sent, and reported as "repeated N times".
+ * - records are collected into batches of up to CONFIG_APP_LOG_SHIPPER_BATCH_LEN
+ *   bytes, sent every CONFIG_APP_LOG_SHIPPER_FLUSH_MS or right away on an
+ *   error. A batch is sent at the level of its most severe record.
+ *
+ * While the track upload queue or the Golioth client request queue is backed
+ * up, budgets refill and batches are sent CONFIG_APP_LOG_SHIPPER_BACKOFF times
+ * slower, leaving the radio to telemetry.
+ *
+ * Records of the Golioth SDK modules are not shipped, since the SDK logs
+ * while sending batches. They are still printed on the console.
+ *
+ * The `set_log_level` RPC still sets the level of every module, before any of
+ * the above.
+ */
+
+#include <golioth/client.h>
+
+/** Replace the Golioth SDK log backend and ship logs through @p client. */
+void log_shipper_start(struct golioth_client *client);
+
+#endif /* __LOG_SHIPPER_H__ */
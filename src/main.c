@@ -8,10 +8,15 @@
 LOG_MODULE_REGISTER(golioth_can_asset_tracker, LOG_LEVEL_DBG);
 
 #include <app_version.h>
+#include "app_geofence.h"
 #include "app_rpc.h"
 #include "app_settings.h"
 #include "app_state.h"
 #include "app_sensors.h"
+#include "follow_mode.h"
+#include "log_shipper.h"
+#include "runtime_monitor.h"
+#include "trace.h"
 #include <golioth/client.h>
 #include <golioth/fw_update.h>
 #include <samples/common/net_connect.h>
@@ -24,11 +29,15 @@ LOG_MODULE_REGISTER(golioth_can_asset_tracker, LOG_LEVEL_DBG);
 #ifdef CONFIG_LIB_OSTENTUS
 #include <libostentus.h>
 #include <libostentus_regmap.h>
+#include "display_cache.h"
 static const struct device *o_dev = DEVICE_DT_GET_ANY(golioth_ostentus);
 #endif
 #ifdef CONFIG_ALUDEL_BATTERY_MONITOR
 #include "battery_monitor/battery.h"
 #endif
+#ifdef CONFIG_APP_SIM
+#include "sim/sim.h"
+#endif
 
 #include <zephyr/drivers/gpio.h>
 
@@ -56,6 +65,7 @@ void golioth_connection_led_set(uint8_t state);
 
 void wake_system_thread(void)
 {
+	trace_event(TRACE_MAIN_WAKE, 0);
 	k_wakeup(_system_thread);
 }
 
@@ -73,25 +83,39 @@ static void on_client_event(struct golioth_client *client, enum golioth_client_e
 
 static void start_golioth_client(void)
 {
+#ifdef CONFIG_APP_SIM
+	/* Credentials of the local server that stands in for Golioth */
+	const struct golioth_client_config *client_config = sim_client_config();
+#else
 	/* Get the client configuration from auto-loaded settings */
 	const struct golioth_client_config *client_config = golioth_sample_credentials_get();
+#endif
 
 	/* Create and start a Golioth Client */
 	client = golioth_client_create(client_config);
 
+	/* Ship logs in budgeted batches instead of one message per record */
+	IF_ENABLED(CONFIG_APP_LOG_SHIPPER, (log_shipper_start(client);));
+
 	/* Register Golioth on_connect callback */
 	golioth_client_register_event_callback(client, on_client_event, NULL);
 
-	/* Initialize DFU components */
-	golioth_fw_update_init(client, _current_version);
+	/* Initialize DFU components, there are no image slots to update on native_sim */
+	if (!IS_ENABLED(CONFIG_APP_SIM)) {
+		golioth_fw_update_init(client, _current_version);
+	}
 
 	/*** Call Golioth APIs for other services in dedicated app files ***/
 
 	/* Observe State service data */
 	app_state_observe(client);
 
+	/* Observe geofences */
+	IF_ENABLED(CONFIG_APP_GEOFENCE, (app_geofence_observe(client);));
+
 	/* Set Golioth Client for streaming sensor data */
 	app_sensors_set_client(client);
+	IF_ENABLED(CONFIG_APP_FOLLOW_MODE, (follow_mode_init(client);));
 
 	/* Register Settings service */
 	app_settings_register(client);
@@ -211,6 +235,13 @@ int main(void)
 	LOG_INF("Connecting to LTE, this may take some time...");
 	lte_lc_connect_async(lte_handler);
 
+#elif defined(CONFIG_APP_SIM)
+	/* On native_sim, GNSS and vehicle are simulated and the host is the network.
+	 * Like on cellular, the pipeline runs while the client connects.
+	 */
+	start_golioth_client();
+	sim_start(client);
+
 #else
 	/* If nRF9160 is not used, start the Golioth Client and block until connected */
 
@@ -274,11 +305,17 @@ int main(void)
 
 		/* Start Ostentus slideshow with 30 second delay between slides */
 		ostentus_slideshow(o_dev, 30000);
+
+		/* Slides exist now, send the sensor values cached so far */
+		display_cache_start();
 	));
 
 	while (true) {
+		trace_event(TRACE_MAIN_LOOP_BEGIN, 0);
 		app_sensors_read_and_stream();
+		trace_event(TRACE_MAIN_LOOP_END, 0);
 
+		runtime_monitor_loop_checkin(RUNTIME_MONITOR_LOOP_MAIN, get_loop_delay_s() * 1000);
 		k_sleep(K_SECONDS(get_loop_delay_s()));
 	}
 }
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(perf_stats, LOG_LEVEL_DBG);
+
+#include <string.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/timing/timing.h>
+
+#include "perf_stats.h"
+
+#define NUM_BUCKETS CONFIG_APP_PERF_STATS_BUCKETS
+
+struct perf_hist {
+	uint32_t count;
+	uint32_t max_us;
+	uint64_t sum_us;
+	uint32_t buckets[NUM_BUCKETS];
+};
+
+static const char *const stage_names[PERF_STAGE_COUNT] = {
+	[PERF_STAGE_NMEA_PARSE] = "parse",
+	[PERF_STAGE_RMC_QUEUE] = "rmc_q",
+	[PERF_STAGE_FIX] = "fix",
+	[PERF_STAGE_UPLOAD_AGE] = "age",
+	[PERF_STAGE_ENCODE] = "encode",
+	[PERF_STAGE_STREAM] = "stream",
+	[PERF_STAGE_CAN_RTT] = "can_rtt",
+};
+
+static const char *const queue_names[PERF_QUEUE_COUNT] = {
+	[PERF_QUEUE_RMC] = "rmc",
+	[PERF_QUEUE_TRACK] = "track_b",
+	[PERF_QUEUE_EVENTS] = "events",
+};
+
+static struct k_spinlock perf_lock;
+static struct perf_hist _hists[PERF_STAGE_COUNT];
+static uint32_t _queue_hwm[PERF_QUEUE_COUNT];
+
+void perf_stats_record_us(enum perf_stage stage, uint32_t us)
+{
+	struct perf_hist *hist = &_hists[stage];
+	/* find_msb_set() is 1-based, 0 for 0: bucket b holds [2^(b-1), 2^b) */
+	uint32_t bucket = MIN(find_msb_set(us), NUM_BUCKETS - 1);
+	k_spinlock_key_t key = k_spin_lock(&perf_lock);
+
+	hist->count++;
+	hist->sum_us += us;
+	hist->max_us = MAX(hist->max_us, us);
+	hist->buckets[bucket]++;
+
+	k_spin_unlock(&perf_lock, key);
+}
+
+void perf_stats_record(enum perf_stage stage, perf_ts_t start)
+{
+	perf_ts_t end = timing_counter_get();
+	uint64_t ns = timing_cycles_to_ns(timing_cycles_get(&start, &end));
+
+	perf_stats_record_us(stage, (uint32_t)MIN(ns / 1000, UINT32_MAX));
+}
+
+void perf_stats_queue_depth(enum perf_queue queue, uint32_t depth)
+{
+	k_spinlock_key_t key = k_spin_lock(&perf_lock);
+
+	_queue_hwm[queue] = MAX(_queue_hwm[queue], depth);
+
+	k_spin_unlock(&perf_lock, key);
+}
+
+/* Encode a histogram as {"n","max","mean","lo","hist":[...]}, leaving out the
+ * empty buckets at both ends to keep the RPC response small.
+ */
+static bool encode_hist(zcbor_state_t *zse, const struct perf_hist *hist)
+{
+	int lo = 0;
+	int hi = NUM_BUCKETS - 1;
+	bool ok;
+
+	if (hist->count == 0) {
+		hi = -1;
+	}
+	while ((lo < hi) && (hist->buckets[lo] == 0)) {
+		lo++;
+	}
+	while ((hi > lo) && (hist->buckets[hi] == 0)) {
+		hi--;
+	}
+
+	ok = zcbor_map_start_encode(zse, 5) &&
+	     zcbor_tstr_put_lit(zse, "n") && zcbor_uint32_put(zse, hist->count) &&
+	     zcbor_tstr_put_lit(zse, "max") && zcbor_uint32_put(zse, hist->max_us) &&
+	     zcbor_tstr_put_lit(zse, "mean") &&
+	     zcbor_uint32_put(zse, hist->count ? (uint32_t)(hist->sum_us / hist->count) : 0) &&
+	     zcbor_tstr_put_lit(zse, "lo") && zcbor_uint32_put(zse, lo) &&
+	     zcbor_tstr_put_lit(zse, "hist") && zcbor_list_start_encode(zse, hi - lo + 1);
+
+	for (int i = lo; ok && (i <= hi); i++) {
+		ok = zcbor_uint32_put(zse, hist->buckets[i]);
+	}
+
+	return ok && zcbor_list_end_encode(zse, hi - lo + 1) && zcbor_map_end_encode(zse, 5);
+}
+
+bool perf_stats_add_to_map(zcbor_state_t *response_detail_map)
+{
+	struct perf_hist hists[PERF_STAGE_COUNT];
+	uint32_t queue_hwm[PERF_QUEUE_COUNT];
+	k_spinlock_key_t key;
+	bool ok = true;
+
+	/* Snapshot, so the lock is not held while encoding */
+	key = k_spin_lock(&perf_lock);
+	memcpy(hists, _hists, sizeof(hists));
+	memcpy(queue_hwm, _queue_hwm, sizeof(queue_hwm));
+	k_spin_unlock(&perf_lock, key);
+
+	for (int i = 0; ok && (i < PERF_STAGE_COUNT); i++) {
+		ok = zcbor_tstr_put_term(response_detail_map, stage_names[i], 16) &&
+		     encode_hist(response_detail_map, &hists[i]);
+	}
+
+	ok = ok && zcbor_tstr_put_lit(response_detail_map, "hwm") &&
+	     zcbor_map_start_encode(response_detail_map, PERF_QUEUE_COUNT);
+	for (int i = 0; ok && (i < PERF_QUEUE_COUNT); i++) {
+		ok = zcbor_tstr_put_term(response_detail_map, queue_names[i], 16) &&
+		     zcbor_uint32_put(response_detail_map, queue_hwm[i]);
+	}
+
+	return ok && zcbor_map_end_encode(response_detail_map, PERF_QUEUE_COUNT);
+}
+
+/* Upper bound of the bucket holding the sample of rank ceil(n * permille / 1000) */
+static uint32_t hist_percentile(const struct perf_hist *hist, uint32_t permille)
+{
+	uint64_t rank = ((uint64_t)hist->count * permille + 999) / 1000;
+	uint64_t seen = 0;
+
+	for (int i = 0; i < NUM_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if ((seen >= rank) && (seen > 0)) {
+			return MIN(BIT64(i), hist->max_us);
+		}
+	}
+
+	return hist->max_us;
+}
+
+void perf_stats_get(enum perf_stage stage, struct perf_stats_summary *summary)
+{
+	struct perf_hist hist;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&perf_lock);
+	memcpy(&hist, &_hists[stage], sizeof(hist));
+	k_spin_unlock(&perf_lock, key);
+
+	summary->n = hist.count;
+	summary->mean_us = hist.count ? (uint32_t)(hist.sum_us / hist.count) : 0;
+	summary->max_us = hist.max_us;
+	summary->p50_us = hist_percentile(&hist, 500);
+	summary->p99_us = hist_percentile(&hist, 990);
+}
+
+const char *perf_stats_stage_name(enum perf_stage stage)
+{
+	return stage_names[stage];
+}
+
+static int perf_stats_init(void)
+{
+	timing_init();
+	timing_start();
+
+	return 0;
+}
+
+SYS_INIT(perf_stats_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
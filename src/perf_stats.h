@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __PERF_STATS_H__
+#define __PERF_STATS_H__
+
+/** Latency histograms and queue high-watermarks of the tracking pipeline.
+ *
+ * Each stage of the pipeline is timed with the hardware cycle counter (the
+ * Zephyr timing API, backed by the DWT cycle counter on Cortex-M) and the
+ * duration is added to a histogram of CONFIG_APP_PERF_STATS_BUCKETS log2
+ * buckets: bucket 0 counts durations under 1 us and bucket b counts durations
+ * in [2^(b-1), 2^b) us, the last bucket also collecting everything above.
+ *
+ * Recording a sample costs a counter read, a bit scan and a few additions
+ * under a spinlock, so it can be used from ISRs.
+ *
+ * Without CONFIG_APP_PERF_STATS every function below is an empty inline and
+ * the instrumentation compiles out completely.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zcbor_encode.h>
+
+enum perf_stage {
+	/** NMEA sentence parsing in the UART ISR */
+	PERF_STAGE_NMEA_PARSE,
+	/** Time an RMC sentence waits in rmc_msgq */
+	PERF_STAGE_RMC_QUEUE,
+	/** Fusion, geofencing, trip, policy, simplification and track queue encoding */
+	PERF_STAGE_FIX,
+	/** Age of a track point when its upload starts (capture to upload) */
+	PERF_STAGE_UPLOAD_AGE,
+	/** JSON encoding of a track point */
+	PERF_STAGE_ENCODE,
+	/** golioth_stream_set_sync() of a track point, until acknowledged */
+	PERF_STAGE_STREAM,
+	/** OBD-II vehicle speed request to response */
+	PERF_STAGE_CAN_RTT,
+	PERF_STAGE_COUNT,
+};
+
+enum perf_queue {
+	/** Sentences in rmc_msgq */
+	PERF_QUEUE_RMC,
+	/** Bytes used in the track queue */
+	PERF_QUEUE_TRACK,
+	/** Events in the event queue */
+	PERF_QUEUE_EVENTS,
+	PERF_QUEUE_COUNT,
+};
+
+/** Summary of the histogram of one stage, in microseconds. */
+struct perf_stats_summary {
+	uint32_t n;
+	uint32_t mean_us;
+	uint32_t max_us;
+	/** Percentiles, rounded up to the upper bound of their bucket */
+	uint32_t p50_us;
+	uint32_t p99_us;
+};
+
+#ifdef CONFIG_APP_PERF_STATS
+
+#include <zephyr/timing/timing.h>
+
+typedef timing_t perf_ts_t;
+
+/** Current value of the cycle counter, the start of a stage. */
+static inline perf_ts_t perf_stats_now(void)
+{
+	return timing_counter_get();
+}
+
+/** Add the time elapsed since @p start to the histogram of @p stage. */
+void perf_stats_record(enum perf_stage stage, perf_ts_t start);
+
+/** Add a duration measured by other means to the histogram of @p stage. */
+void perf_stats_record_us(enum perf_stage stage, uint32_t us);
+
+/** Update the high-watermark of @p queue with its current depth. */
+void perf_stats_queue_depth(enum perf_queue queue, uint32_t depth);
+
+/**
+ * Encode the histograms and high-watermarks into an RPC response map.
+ *
+ * @return true on success, false if the response buffer is too small
+ */
+bool perf_stats_add_to_map(zcbor_state_t *response_detail_map);
+
+/** Summarize the histogram of @p stage. */
+void perf_stats_get(enum perf_stage stage, struct perf_stats_summary *summary);
+
+/** Name of @p stage, as used in the get_perf_stats RPC response. */
+const char *perf_stats_stage_name(enum perf_stage stage);
+
+#else /* CONFIG_APP_PERF_STATS */
+
+typedef uint32_t perf_ts_t;
+
+static inline perf_ts_t perf_stats_now(void)
+{
+	return 0;
+}
+
+static inline void perf_stats_record(enum perf_stage stage, perf_ts_t start)
+{
+}
+
+static inline void perf_stats_record_us(enum perf_stage stage, uint32_t us)
+{
+}
+
+static inline void perf_stats_queue_depth(enum perf_queue queue, uint32_t depth)
+{
+}
+
+#endif /* CONFIG_APP_PERF_STATS */
+
+#endif /* __PERF_STATS_H__ */
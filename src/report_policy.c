@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(report_policy, LOG_LEVEL_DBG);
+
+#include <math.h>
+
+#include "report_policy.h"
+
+/* Course over ground is noise when (almost) stationary, so ignore it below this speed */
+#define HEADING_MIN_SPEED_KMH 5.0f
+
+static struct {
+	struct geo_fix fix;
+	int64_t time_ms;
+	bool has_fix;
+} _last_report;
+
+static bool heading_changed(const struct geo_fix *fix, int32_t threshold_deg)
+{
+	if (isnan(fix->course) || isnan(_last_report.fix.course) || isnan(fix->speed)) {
+		return false;
+	}
+
+	if (fix->speed < HEADING_MIN_SPEED_KMH) {
+		return false;
+	}
+
+	return geo_heading_diff(fix->course, _last_report.fix.course) >= (float)threshold_deg;
+}
+
+enum report_policy_result report_policy_check(const struct geo_fix *fix,
+					      const struct report_policy_thresholds *thresholds,
+					      int64_t now_ms)
+{
+	enum report_policy_result result = REPORT_POLICY_REPORT;
+	int32_t distance_m = thresholds->distance_m;
+	int32_t heading_deg = thresholds->heading_deg;
+	int32_t max_interval_s = thresholds->max_interval_s;
+	const char *reason = NULL;
+
+	if (!_last_report.has_fix) {
+		reason = "first fix";
+	} else if (fix->valid != _last_report.fix.valid) {
+		reason = "fix validity";
+	} else if (!distance_m && !heading_deg && !max_interval_s) {
+		reason = "policy disabled";
+	} else if (max_interval_s &&
+		   (now_ms - _last_report.time_ms) >= ((int64_t)max_interval_s * 1000)) {
+		reason = "interval";
+		result = REPORT_POLICY_HEARTBEAT;
+	} else if (distance_m && geo_distance_m(_last_report.fix.lat, _last_report.fix.lon,
+						fix->lat, fix->lon) >= (float)distance_m) {
+		reason = "distance";
+	} else if (heading_deg && heading_changed(fix, heading_deg)) {
+		reason = "heading";
+	}
+
+	if (!reason) {
+		return REPORT_POLICY_SKIP;
+	}
+
+	LOG_DBG("Reporting fix (%s)", reason);
+
+	_last_report.fix = *fix;
+	_last_report.time_ms = now_ms;
+	_last_report.has_fix = true;
+
+	return result;
+}
+
+void report_policy_reset(void)
+{
+	_last_report.has_fix = false;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __REPORT_POLICY_H__
+#define __REPORT_POLICY_H__
+
+/** Decide which GNSS fixes are worth uploading.
+ *
+ * A fix is reported when it crosses any of the dead-band thresholds configured
+ * through the Golioth Settings service, measured against the last reported fix:
+ *
+ *  - distance moved (`REPORT_DISTANCE_M`)
+ *  - change of heading while moving (`REPORT_HEADING_DEG`)
+ *  - time elapsed (`REPORT_MAX_INTERVAL_S`)
+ *
+ * A threshold set to 0 is disabled. When all thresholds are disabled every fix
+ * is reported.
+ *
+ * A fix that is not reported lies within `REPORT_DISTANCE_M` of the last
+ * reported one. Reported fixes then go through track simplification, which
+ * keeps them within `TRACK_MAX_ERROR_M` of the uploaded track, so every fix is
+ * within `REPORT_DISTANCE_M + TRACK_MAX_ERROR_M` of it.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "geo_helper.h"
+
+/* Thresholds, from the REPORT_* settings */
+struct report_policy_thresholds {
+	int32_t distance_m;
+	int32_t heading_deg;
+	int32_t max_interval_s;
+};
+
+enum report_policy_result {
+	/** Inside all dead-bands, do not report */
+	REPORT_POLICY_SKIP = 0,
+	/** Crossed a distance/heading threshold (or the first fix), report */
+	REPORT_POLICY_REPORT,
+	/** `REPORT_MAX_INTERVAL_S` elapsed, report even if nothing else changed */
+	REPORT_POLICY_HEARTBEAT,
+};
+
+/**
+ * Run a fix through the reporting policy.
+ *
+ * @param fix the new fix
+ * @param thresholds dead-band thresholds, 0 to disable one
+ * @param now_ms current uptime in milliseconds
+ *
+ * @return REPORT_POLICY_SKIP if the fix is not reported. Otherwise the fix
+ * becomes the new reference for the following fixes.
+ */
+enum report_policy_result report_policy_check(const struct geo_fix *fix,
+					      const struct report_policy_thresholds *thresholds,
+					      int64_t now_ms);
+
+/**
+ * Forget the last reported fix so that the next one is always reported, as
+ * the first fix after the GNSS receiver wakes up is.
+ */
+void report_policy_reset(void);
+
+#endif /* __REPORT_POLICY_H__ */
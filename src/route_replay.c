@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(route_replay, LOG_LEVEL_DBG);
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include <zephyr/kernel.h>
+
+#include "app_sensors.h"
+#include "geo_helper.h"
+#include "route_replay.h"
+#include "time_base.h"
+
+#define MAX_WAYPOINTS CONFIG_APP_ROUTE_REPLAY_MAX_WAYPOINTS
+
+/* Encoded polyline coordinates are in 1e-5 degrees */
+#define ROUTE_E7_PER_UNIT 100
+#define ROUTE_MAX_SPEED_KMH 400
+/* Fixes are dated from here until the UTC time is known (2024-01-01T00:00:00Z) */
+#define ROUTE_FALLBACK_UTC_MS 1704067200000LL
+
+#define KMH_PER_MPS   3.6f
+#define KNOTS_PER_KMH (1.0f / 1.852f)
+
+struct route_waypoint {
+	/* Coordinates in 1e-7 degrees */
+	int32_t lat;
+	int32_t lon;
+	/* Speed when passing the waypoint */
+	uint16_t speed_kmh;
+};
+
+/* The route built into the image */
+static const char builtin_route[] = {
+#include "route_replay.inc"
+};
+
+K_MUTEX_DEFINE(replay_mutex);
+static struct route_waypoint _route[MAX_WAYPOINTS];
+static size_t _route_len;
+static float _route_length_m;
+/* The last waypoint is the first one, the route starts over from there */
+static bool _route_closed;
+
+static struct {
+	bool active;
+	uint32_t period_ms;
+	/* Start waypoint of the current segment, and distance driven along it */
+	size_t seg;
+	float seg_pos_m;
+	float seg_len_m;
+	float speed_mps;
+	/* Stopped at the last waypoint of an open route */
+	bool parked;
+	int64_t last_ms;
+	int64_t next_ms;
+	/* UTC time minus uptime, used when the UTC time is not known */
+	int64_t fallback_offset_ms;
+} _replay;
+
+static void replay_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(replay_work, replay_work_handler);
+
+static bool decode_value(const char **pos, const char *end, int32_t *value)
+{
+	uint32_t result = 0;
+	int shift = 0;
+	int c;
+
+	do {
+		/* Skip line breaks of the route file */
+		while ((*pos < end) && ((**pos == '\n') || (**pos == '\r') || (**pos == ' '))) {
+			(*pos)++;
+		}
+		if ((*pos == end) || (shift >= 30)) {
+			return false;
+		}
+
+		c = **pos - 63;
+		(*pos)++;
+		if ((c < 0) || (c > 63)) {
+			return false;
+		}
+
+		result |= (uint32_t)(c & 0x1F) << shift;
+		shift += 5;
+	} while (c & 0x20);
+
+	*value = (result & 1) ? ~(int32_t)(result >> 1) : (int32_t)(result >> 1);
+
+	return true;
+}
+
+static bool at_end(const char *pos, const char *end)
+{
+	while ((pos < end) && ((*pos == '\n') || (*pos == '\r') || (*pos == ' ') || (*pos == '\0'))) {
+		pos++;
+	}
+
+	return pos == end;
+}
+
+/*
+ * Decode an encoded route into out, or only validate it if out is NULL.
+ * Returns the number of waypoints.
+ *
+ * A valid route goes somewhere, and never has two stops in a row at different
+ * places: the vehicle would never get from one to the other.
+ */
+static int route_decode(const char *route, size_t len, struct route_waypoint *out)
+{
+	const char *pos = route;
+	const char *end = route + len;
+	int32_t lat = 0;
+	int32_t lon = 0;
+	int32_t speed = 0;
+	int32_t delta[3];
+	bool moves = false;
+	int count = 0;
+
+	while (!at_end(pos, end)) {
+		if (!decode_value(&pos, end, &delta[0]) || !decode_value(&pos, end, &delta[1]) ||
+		    !decode_value(&pos, end, &delta[2])) {
+			return -EINVAL;
+		}
+
+		lat += delta[0];
+		lon += delta[1];
+		speed += delta[2];
+		if ((abs(lat) > 90 * 100000) || (abs(lon) > 180 * 100000) || (speed < 0) ||
+		    (speed > ROUTE_MAX_SPEED_KMH)) {
+			return -EINVAL;
+		}
+
+		if ((count > 0) && ((delta[0] != 0) || (delta[1] != 0))) {
+			/* This waypoint and the previous one, at speed - delta[2], are stops */
+			if ((speed == 0) && (delta[2] == 0)) {
+				return -EINVAL;
+			}
+			moves = true;
+		}
+
+		if (count == MAX_WAYPOINTS) {
+			return -ENOMEM;
+		}
+
+		if (out) {
+			out[count].lat = lat * ROUTE_E7_PER_UNIT;
+			out[count].lon = lon * ROUTE_E7_PER_UNIT;
+			out[count].speed_kmh = speed;
+		}
+		count++;
+	}
+
+	return moves ? count : -EINVAL;
+}
+
+static float segment_length_m(size_t seg)
+{
+	const struct route_waypoint *a = &_route[seg];
+	const struct route_waypoint *b = &_route[seg + 1];
+
+	return geo_distance_m(a->lat, a->lon, b->lat, b->lon);
+}
+
+/* Speed at distance pos_m along a segment, accelerating evenly between its waypoints */
+static float segment_speed_mps(size_t seg, float pos_m, float len_m)
+{
+	float v0 = _route[seg].speed_kmh / KMH_PER_MPS;
+	float v1 = _route[seg + 1].speed_kmh / KMH_PER_MPS;
+
+	return sqrtf(MAX(v0 * v0 + (v1 * v1 - v0 * v0) * pos_m / len_m, 0.0f));
+}
+
+static void enter_segment(size_t seg)
+{
+	_replay.seg = seg;
+	_replay.seg_pos_m = 0.0f;
+	_replay.seg_len_m = segment_length_m(seg);
+	_replay.speed_mps = _route[seg].speed_kmh / KMH_PER_MPS;
+}
+
+static void next_segment(void)
+{
+	if (_replay.seg + 2 < _route_len) {
+		enter_segment(_replay.seg + 1);
+	} else if (_route_closed) {
+		enter_segment(0);
+	} else {
+		/* Jumping back to the first waypoint would be a teleport, stay at the last one */
+		_replay.seg_pos_m = _replay.seg_len_m;
+		_replay.speed_mps = 0.0f;
+		_replay.parked = true;
+		LOG_INF("Route replay parked at the last waypoint");
+	}
+}
+
+/*
+ * Drive dt_s seconds further along the route. This ends, as the validated route
+ * has segments with a length, and the vehicle moves on each of those.
+ */
+static void advance(float dt_s)
+{
+	float v0;
+	float v1;
+	float acc;
+	float t_end;
+
+	while ((dt_s > 0.0f) && !_replay.parked) {
+		if (_replay.seg_len_m <= 0.0f) {
+			next_segment();
+			continue;
+		}
+
+		v0 = _route[_replay.seg].speed_kmh / KMH_PER_MPS;
+		v1 = _route[_replay.seg + 1].speed_kmh / KMH_PER_MPS;
+		acc = (v1 * v1 - v0 * v0) / (2 * _replay.seg_len_m);
+
+		/* Time to the end of the segment, where the speed is v1 */
+		if (acc != 0.0f) {
+			t_end = (v1 - _replay.speed_mps) / acc;
+		} else {
+			/* Same speed at both ends, and it is not 0 */
+			t_end = (_replay.seg_len_m - _replay.seg_pos_m) / _replay.speed_mps;
+		}
+
+		if (dt_s < t_end) {
+			_replay.seg_pos_m = MIN(_replay.seg_pos_m + _replay.speed_mps * dt_s +
+							acc * dt_s * dt_s / 2,
+						_replay.seg_len_m);
+			_replay.speed_mps =
+				segment_speed_mps(_replay.seg, _replay.seg_pos_m, _replay.seg_len_m);
+			return;
+		}
+
+		dt_s -= MAX(t_end, 0.0f);
+		next_segment();
+	}
+}
+
+static void make_rmc(struct minmea_sentence_rmc *frame, int64_t uptime_ms)
+{
+	const struct route_waypoint *a = &_route[_replay.seg];
+	const struct route_waypoint *b = &_route[_replay.seg + 1];
+	float t = (_replay.seg_len_m > 0.0f) ? (_replay.seg_pos_m / _replay.seg_len_m) : 0.0f;
+	int32_t lat = a->lat + (int32_t)lroundf((b->lat - a->lat) * t);
+	int32_t lon = a->lon + (int32_t)lroundf((b->lon - a->lon) * t);
+	int64_t utc_ms = time_base_utc_ms(uptime_ms);
+	time_t secs;
+	struct tm tm;
+
+	if (utc_ms == 0) {
+		utc_ms = uptime_ms + _replay.fallback_offset_ms;
+	}
+	secs = utc_ms / 1000;
+	gmtime_r(&secs, &tm);
+
+	*frame = (struct minmea_sentence_rmc){
+		.time = {tm.tm_hour, tm.tm_min, tm.tm_sec, (utc_ms % 1000) * 1000},
+		.valid = true,
+		.speed = {lroundf(_replay.speed_mps * KMH_PER_MPS * KNOTS_PER_KMH * 100), 100},
+		.course = {lroundf(geo_bearing_deg(a->lat, a->lon, b->lat, b->lon) * 10), 10},
+		.date = {tm.tm_mday, tm.tm_mon + 1, tm.tm_year % 100},
+	};
+
+	/* Both are within range, as the route was validated */
+	geo_e7_to_minmea(&frame->latitude, lat);
+	geo_e7_to_minmea(&frame->longitude, lon);
+}
+
+static void replay_work_handler(struct k_work *work)
+{
+	struct minmea_sentence_rmc frame;
+	int64_t now = k_uptime_get();
+
+	k_mutex_lock(&replay_mutex, K_FOREVER);
+
+	if (!_replay.active) {
+		k_mutex_unlock(&replay_mutex);
+		return;
+	}
+
+	/* Positions follow the time actually elapsed, even if this work runs late */
+	advance((now - _replay.last_ms) / 1000.0f);
+	_replay.last_ms = now;
+
+	make_rmc(&frame, now);
+	app_sensors_inject_rmc(&frame, now);
+
+	/* Keep the rate without catching up on fixes missed while late */
+	_replay.next_ms = MAX(_replay.next_ms + _replay.period_ms, now);
+	k_work_reschedule(&replay_work, K_TIMEOUT_ABS_MS(_replay.next_ms));
+
+	k_mutex_unlock(&replay_mutex);
+}
+
+int route_replay_start(const char *route, size_t len, uint32_t rate_hz)
+{
+	int64_t now = k_uptime_get();
+	int count;
+
+	if (route == NULL) {
+		route = builtin_route;
+		len = sizeof(builtin_route);
+	}
+
+	if (rate_hz == 0) {
+		rate_hz = CONFIG_APP_ROUTE_REPLAY_RATE_HZ;
+	} else if (rate_hz > ROUTE_REPLAY_MAX_RATE_HZ) {
+		return -EINVAL;
+	}
+
+	/* Validate before replacing the route being replayed */
+	count = route_decode(route, len, NULL);
+	if (count < 0) {
+		return count;
+	}
+
+	k_mutex_lock(&replay_mutex, K_FOREVER);
+
+	_route_len = route_decode(route, len, _route);
+
+	_route_length_m = 0.0f;
+	for (size_t i = 0; i + 1 < _route_len; i++) {
+		_route_length_m += segment_length_m(i);
+	}
+	_route_closed = (_route[0].lat == _route[_route_len - 1].lat) &&
+			(_route[0].lon == _route[_route_len - 1].lon);
+
+	if (time_base_utc_ms(now) == 0) {
+		/* Pick up the network time if there is one already */
+		time_base_update();
+	}
+	if (time_base_utc_ms(now) == 0) {
+		LOG_WRN("UTC time not known yet, replayed fixes start at 2024-01-01");
+	}
+	_replay.fallback_offset_ms = ROUTE_FALLBACK_UTC_MS - now;
+
+	enter_segment(0);
+	_replay.parked = false;
+	_replay.period_ms = MSEC_PER_SEC / rate_hz;
+	_replay.last_ms = now;
+	_replay.next_ms = now;
+	_replay.active = true;
+	k_work_reschedule(&replay_work, K_NO_WAIT);
+
+	k_mutex_unlock(&replay_mutex);
+
+	LOG_INF("Replaying a %d waypoint, %d m %s route at %u Hz", count, (int)_route_length_m,
+		_route_closed ? "closed" : "open", rate_hz);
+
+	return count;
+}
+
+void route_replay_stop(void)
+{
+	k_mutex_lock(&replay_mutex, K_FOREVER);
+	_replay.active = false;
+	k_work_cancel_delayable(&replay_work);
+	k_mutex_unlock(&replay_mutex);
+
+	LOG_INF("Route replay stopped");
+}
+
+float route_replay_length_m(void)
+{
+	return _route_length_m;
+}
+
+bool route_replay_active(void)
+{
+	return _replay.active;
+}
+
+int route_replay_speed(void)
+{
+	int speed = -1;
+
+	k_mutex_lock(&replay_mutex, K_FOREVER);
+	if (_replay.active) {
+		speed = (int)lroundf(_replay.speed_mps * KMH_PER_MPS);
+	}
+	k_mutex_unlock(&replay_mutex);
+
+	return speed;
+}
+
+void route_replay_init(void)
+{
+	int err;
+
+	if (!IS_ENABLED(CONFIG_APP_ROUTE_REPLAY_AT_BOOT)) {
+		return;
+	}
+
+	err = route_replay_start(NULL, 0, 0);
+	if (err < 0) {
+		LOG_ERR("Invalid built-in route %s: %d", CONFIG_APP_ROUTE_REPLAY_FILE, err);
+	}
+}
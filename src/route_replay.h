@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __ROUTE_REPLAY_H__
+#define __ROUTE_REPLAY_H__
+
+/** Route replay in place of the GNSS receiver and the vehicle ECU.
+ *
+ * A route is a polyline with a speed at each waypoint, stored as the Encoded
+ * Polyline Algorithm Format extended with a third, speed, value per waypoint
+ * (see scripts/route_encode.py). The replay drives along it, accelerating
+ * evenly between the speeds of consecutive waypoints, and injects an RMC
+ * fix into rmc_msgq CONFIG_APP_ROUTE_REPLAY_RATE_HZ times per second, where
+ * fixes from the GNSS receiver enter the pipeline. The same speed is returned
+ * in place of the OBD-II vehicle speed. A closed route, whose last waypoint is
+ * its first one, starts over once at the end. On an open route, the vehicle
+ * stops at the last waypoint and stays there until the replay is stopped or
+ * another route is started.
+ *
+ * While a route is replayed, sentences from the GNSS receiver are ignored and
+ * the ECU is not polled. The route built in from CONFIG_APP_ROUTE_REPLAY_FILE,
+ * or one pushed with the route_replay RPC, is replayed.
+ *
+ * Without CONFIG_APP_ROUTE_REPLAY, route_replay_active() is always false.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROUTE_REPLAY_MAX_RATE_HZ 50
+
+#ifdef CONFIG_APP_ROUTE_REPLAY
+
+/** Start replaying the built-in route if CONFIG_APP_ROUTE_REPLAY_AT_BOOT is set. */
+void route_replay_init(void);
+
+/**
+ * Start replaying a route from its first waypoint.
+ *
+ * @param route encoded route, NULL to replay the built-in route
+ * @param len length of @p route
+ * @param rate_hz fixes per second, 0 for CONFIG_APP_ROUTE_REPLAY_RATE_HZ
+ *
+ * @return number of waypoints, -EINVAL if the route or rate is invalid, -ENOMEM
+ *	   if the route has more than CONFIG_APP_ROUTE_REPLAY_MAX_WAYPOINTS
+ */
+int route_replay_start(const char *route, size_t len, uint32_t rate_hz);
+
+/** Stop the replay, the GNSS receiver and the ECU are used again. */
+void route_replay_stop(void);
+
+/** Length in meters of the route last started. */
+float route_replay_length_m(void);
+
+/** True while a route is being replayed. */
+bool route_replay_active(void);
+
+/** Replayed vehicle speed in km/h, -1 if no route is being replayed. */
+int route_replay_speed(void);
+
+#else /* CONFIG_APP_ROUTE_REPLAY */
+
+static inline bool route_replay_active(void)
+{
+	return false;
+}
+
+static inline int route_replay_speed(void)
+{
+	return -1;
+}
+
+#endif /* CONFIG_APP_ROUTE_REPLAY */
+
+#endif /* __ROUTE_REPLAY_H__ */
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(runtime_monitor, LOG_LEVEL_DBG);
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/sys_heap.h>
+
+#if defined(CONFIG_MBEDTLS_ENABLE_HEAP) && defined(CONFIG_MBEDTLS_MEMORY_DEBUG)
+#include <mbedtls/memory_buffer_alloc.h>
+#endif
+
+#include "runtime_monitor.h"
+
+#define MAX_THREADS CONFIG_APP_RUNTIME_MONITOR_MAX_THREADS
+
+struct loop_stats {
+	/** Uptime at which the next iteration is due, 0 while paused */
+	int64_t due_ms;
+	uint32_t checkins;
+	uint32_t misses;
+	uint32_t worst_late_ms;
+};
+
+/* Execution cycles of a thread at the previous sample */
+struct thread_sample {
+	const struct k_thread *thread;
+	uint64_t cycles;
+};
+
+/* State of one sample while iterating over the threads */
+struct sample_ctx {
+	zcbor_state_t *zse;
+	uint64_t total_delta;
+	size_t count;
+	bool ok;
+};
+
+static const char *const loop_names[RUNTIME_MONITOR_LOOP_COUNT] = {
+	[RUNTIME_MONITOR_LOOP_MAIN] = "main",
+	[RUNTIME_MONITOR_LOOP_CAN] = "can",
+};
+
+static struct k_spinlock loop_lock;
+static struct loop_stats _loops[RUNTIME_MONITOR_LOOP_COUNT];
+
+/* Samples are only taken from the RPC handler, one at a time */
+K_MUTEX_DEFINE(sample_mutex);
+static struct thread_sample _prev[MAX_THREADS];
+static struct thread_sample _next[MAX_THREADS];
+static size_t _prev_count;
+static uint64_t _prev_total_cycles;
+
+#if CONFIG_HEAP_MEM_POOL_SIZE > 0
+extern struct sys_heap _system_heap;
+#endif
+
+void runtime_monitor_loop_checkin(enum runtime_monitor_loop loop, uint32_t next_ms)
+{
+	struct loop_stats *stats = &_loops[loop];
+	int64_t now = k_uptime_get();
+	int64_t late_ms = 0;
+	k_spinlock_key_t key = k_spin_lock(&loop_lock);
+
+	if (stats->due_ms && (now > (stats->due_ms + CONFIG_APP_RUNTIME_MONITOR_SLACK_MS))) {
+		late_ms = now - stats->due_ms;
+		stats->misses++;
+		stats->worst_late_ms = MAX(stats->worst_late_ms, (uint32_t)MIN(late_ms, UINT32_MAX));
+	}
+	stats->checkins++;
+	stats->due_ms = now + next_ms;
+
+	k_spin_unlock(&loop_lock, key);
+
+	if (late_ms) {
+		LOG_WRN("%s loop missed its deadline by %d ms", loop_names[loop], (int)late_ms);
+	}
+}
+
+void runtime_monitor_loop_pause(enum runtime_monitor_loop loop)
+{
+	k_spinlock_key_t key = k_spin_lock(&loop_lock);
+
+	_loops[loop].due_ms = 0;
+
+	k_spin_unlock(&loop_lock, key);
+}
+
+static uint64_t prev_cycles(const struct k_thread *thread)
+{
+	for (size_t i = 0; i < _prev_count; i++) {
+		if (_prev[i].thread == thread) {
+			return _prev[i].cycles;
+		}
+	}
+
+	/* New thread, all of its cycles fall in this sample */
+	return 0;
+}
+
+/* Encode one thread as [name, stack size, stack unused, CPU permille] */
+static void sample_thread(const struct k_thread *cthread, void *user_data)
+{
+	struct k_thread *thread = (struct k_thread *)cthread;
+	struct sample_ctx *ctx = user_data;
+	k_thread_runtime_stats_t rt_stats;
+	const char *name = k_thread_name_get(thread);
+	size_t unused = 0;
+	uint32_t cpu_permille = 0;
+	uint64_t delta;
+
+	if (!ctx->ok || (ctx->count >= MAX_THREADS)) {
+		return;
+	}
+
+	k_thread_runtime_stats_get(thread, &rt_stats);
+	k_thread_stack_space_get(thread, &unused);
+
+	delta = rt_stats.execution_cycles - prev_cycles(thread);
+	if (ctx->total_delta) {
+		cpu_permille = (uint32_t)(delta * 1000 / ctx->total_delta);
+	}
+	_next[ctx->count].thread = thread;
+	_next[ctx->count].cycles = rt_stats.execution_cycles;
+	ctx->count++;
+
+	ctx->ok = zcbor_list_start_encode(ctx->zse, 4) &&
+		  zcbor_tstr_put_term(ctx->zse, (name && name[0]) ? name : "?",
+				      CONFIG_THREAD_MAX_NAME_LEN) &&
+		  zcbor_uint32_put(ctx->zse, thread->stack_info.size) &&
+		  zcbor_uint32_put(ctx->zse, unused) && zcbor_uint32_put(ctx->zse, cpu_permille) &&
+		  zcbor_list_end_encode(ctx->zse, 4);
+}
+
+static bool encode_heaps(zcbor_state_t *zse)
+{
+	bool ok = true;
+
+	/* Heaps are encoded as [size, used, peak] */
+#if CONFIG_HEAP_MEM_POOL_SIZE > 0
+	struct sys_memory_stats heap_stats;
+
+	sys_heap_runtime_stats_get(&_system_heap, &heap_stats);
+	ok = ok && zcbor_tstr_put_lit(zse, "heap") && zcbor_list_start_encode(zse, 3) &&
+	     zcbor_uint32_put(zse, heap_stats.allocated_bytes + heap_stats.free_bytes) &&
+	     zcbor_uint32_put(zse, heap_stats.allocated_bytes) &&
+	     zcbor_uint32_put(zse, heap_stats.max_allocated_bytes) &&
+	     zcbor_list_end_encode(zse, 3);
+#endif
+
+#if defined(CONFIG_MBEDTLS_ENABLE_HEAP) && defined(CONFIG_MBEDTLS_MEMORY_DEBUG)
+	size_t cur_used, cur_blocks, max_used, max_blocks;
+
+	mbedtls_memory_buffer_alloc_cur_get(&cur_used, &cur_blocks);
+	mbedtls_memory_buffer_alloc_max_get(&max_used, &max_blocks);
+	ok = ok && zcbor_tstr_put_lit(zse, "mbedtls") && zcbor_list_start_encode(zse, 3) &&
+	     zcbor_uint32_put(zse, CONFIG_MBEDTLS_HEAP_SIZE) &&
+	     zcbor_uint32_put(zse, cur_used) && zcbor_uint32_put(zse, max_used) &&
+	     zcbor_list_end_encode(zse, 3);
+#endif
+
+	return ok;
+}
+
+static bool encode_loops(zcbor_state_t *zse)
+{
+	struct loop_stats loops[RUNTIME_MONITOR_LOOP_COUNT];
+	k_spinlock_key_t key;
+	bool ok;
+
+	key = k_spin_lock(&loop_lock);
+	memcpy(loops, _loops, sizeof(loops));
+	k_spin_unlock(&loop_lock, key);
+
+	/* Loops are encoded as [check-ins, missed deadlines, worst lateness (ms)] */
+	ok = zcbor_tstr_put_lit(zse, "loops") &&
+	     zcbor_map_start_encode(zse, RUNTIME_MONITOR_LOOP_COUNT);
+	for (int i = 0; ok && (i < RUNTIME_MONITOR_LOOP_COUNT); i++) {
+		ok = zcbor_tstr_put_term(zse, loop_names[i], 8) &&
+		     zcbor_list_start_encode(zse, 3) && zcbor_uint32_put(zse, loops[i].checkins) &&
+		     zcbor_uint32_put(zse, loops[i].misses) &&
+		     zcbor_uint32_put(zse, loops[i].worst_late_ms) &&
+		     zcbor_list_end_encode(zse, 3);
+	}
+
+	return ok && zcbor_map_end_encode(zse, RUNTIME_MONITOR_LOOP_COUNT);
+}
+
+bool runtime_monitor_add_to_map(zcbor_state_t *response_detail_map)
+{
+	k_thread_runtime_stats_t all_stats;
+	struct sample_ctx ctx = {
+		.zse = response_detail_map,
+		.ok = true,
+	};
+
+	k_mutex_lock(&sample_mutex, K_FOREVER);
+
+	k_thread_runtime_stats_all_get(&all_stats);
+	ctx.total_delta = all_stats.execution_cycles - _prev_total_cycles;
+
+	/* Threads are encoded as [name, stack size, stack unused, CPU permille] */
+	ctx.ok = zcbor_tstr_put_lit(response_detail_map, "threads") &&
+		 zcbor_list_start_encode(response_detail_map, MAX_THREADS);
+	k_thread_foreach_unlocked(sample_thread, &ctx);
+	ctx.ok = ctx.ok && zcbor_list_end_encode(response_detail_map, MAX_THREADS);
+
+	/* CPU utilization of the next sample is relative to this one */
+	memcpy(_prev, _next, ctx.count * sizeof(_next[0]));
+	_prev_count = ctx.count;
+	_prev_total_cycles = all_stats.execution_cycles;
+
+	k_mutex_unlock(&sample_mutex);
+
+	return ctx.ok && encode_heaps(response_detail_map) && encode_loops(response_detail_map);
+}
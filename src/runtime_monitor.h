@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __RUNTIME_MONITOR_H__
+#define __RUNTIME_MONITOR_H__
+
+/** Thread, stack and heap usage monitor.
+ *
+ * Samples the CPU utilization of every thread since the previous sample,
+ * the stack high-watermark of every thread, and the current and peak usage of
+ * the system heap and of the mbedTLS heap, so stack and heap sizes can be set
+ * from measurements.
+ *
+ * The periodic loops of the application check in once per iteration, right
+ * before sleeping, with the time until the next iteration is due. A loop that
+ * checks in again more than CONFIG_APP_RUNTIME_MONITOR_SLACK_MS after that
+ * counts a missed deadline.
+ *
+ * Without CONFIG_APP_RUNTIME_MONITOR the loop hooks are empty inlines.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zcbor_encode.h>
+
+enum runtime_monitor_loop {
+	/** Upload loop of the main thread */
+	RUNTIME_MONITOR_LOOP_MAIN,
+	/** Vehicle speed polling loop of the CAN thread */
+	RUNTIME_MONITOR_LOOP_CAN,
+	RUNTIME_MONITOR_LOOP_COUNT,
+};
+
+#ifdef CONFIG_APP_RUNTIME_MONITOR
+
+/**
+ * Check in from a periodic loop, right before it sleeps.
+ *
+ * @param loop the calling loop
+ * @param next_ms time until the next iteration is due
+ */
+void runtime_monitor_loop_checkin(enum runtime_monitor_loop loop, uint32_t next_ms);
+
+/** Stop deadline checks of a loop until its next check-in (e.g. while idle). */
+void runtime_monitor_loop_pause(enum runtime_monitor_loop loop);
+
+/**
+ * Take a sample and encode it into an RPC response map.
+ *
+ * @return true on success, false if the response buffer is too small
+ */
+bool runtime_monitor_add_to_map(zcbor_state_t *response_detail_map);
+
+#else /* CONFIG_APP_RUNTIME_MONITOR */
+
+static inline void runtime_monitor_loop_checkin(enum runtime_monitor_loop loop, uint32_t next_ms)
+{
+}
+
+static inline void runtime_monitor_loop_pause(enum runtime_monitor_loop loop)
+{
+}
+
+#endif /* CONFIG_APP_RUNTIME_MONITOR */
+
+#endif /* __RUNTIME_MONITOR_H__ */
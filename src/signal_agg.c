@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(signal_agg, LOG_LEVEL_DBG);
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include "signal_agg.h"
+
+void signal_agg_add(struct signal_agg *agg, int32_t value)
+{
+	k_spinlock_key_t key = k_spin_lock(&agg->lock);
+	struct signal_agg_window *w = &agg->current;
+	int32_t bucket = (value > 0) ? (value / agg->bucket_width) : 0;
+
+	if ((w->count == 0) || (value < w->min)) {
+		w->min = value;
+	}
+	if ((w->count == 0) || (value > w->max)) {
+		w->max = value;
+	}
+	w->last = value;
+	w->sum += value;
+	w->count++;
+	w->hist[MIN(bucket, SIGNAL_AGG_HIST_BUCKETS - 1)]++;
+
+	k_spin_unlock(&agg->lock, key);
+}
+
+/* Fold the newer window src into dst */
+static void window_merge(struct signal_agg_window *dst, const struct signal_agg_window *src)
+{
+	if (src->count == 0) {
+		return;
+	}
+
+	if (dst->count == 0) {
+		*dst = *src;
+		return;
+	}
+
+	dst->min = MIN(dst->min, src->min);
+	dst->max = MAX(dst->max, src->max);
+	dst->last = src->last;
+	dst->sum += src->sum;
+	dst->count += src->count;
+	for (int i = 0; i < SIGNAL_AGG_HIST_BUCKETS; i++) {
+		dst->hist[i] += src->hist[i];
+	}
+}
+
+int signal_agg_rollup(struct signal_agg *agg, char *buf, size_t len)
+{
+	struct signal_agg_window snapshot;
+	k_spinlock_key_t key = k_spin_lock(&agg->lock);
+	int64_t mean_x100;
+	size_t pos;
+
+	window_merge(&agg->unacked, &agg->current);
+	memset(&agg->current, 0, sizeof(agg->current));
+	snapshot = agg->unacked;
+
+	k_spin_unlock(&agg->lock, key);
+
+	if (snapshot.count == 0) {
+		return 0;
+	}
+
+	/* Mean with two decimals, rounded half away from zero */
+	mean_x100 = (snapshot.sum * 100 + ((snapshot.sum < 0) ? -1 : 1) * (snapshot.count / 2)) /
+		    snapshot.count;
+
+	pos = snprintk(buf, len,
+		       "\"%s\":{\"min\":%d,\"max\":%d,\"mean\":%s%d.%02d,\"last\":%d,\"count\":%u,"
+		       "\"hist\":[",
+		       agg->name, snapshot.min, snapshot.max, (mean_x100 < 0) ? "-" : "",
+		       (int)(llabs(mean_x100) / 100), (int)(llabs(mean_x100) % 100),
+		       snapshot.last, snapshot.count);
+
+	for (int i = 0; (i < SIGNAL_AGG_HIST_BUCKETS) && (pos < len); i++) {
+		pos += snprintk(&buf[pos], len - pos, "%s%u", (i == 0) ? "" : ",",
+				snapshot.hist[i]);
+	}
+	if (pos < len) {
+		pos += snprintk(&buf[pos], len - pos, "]}");
+	}
+
+	if (pos >= len) {
+		LOG_ERR("Rollup of \"%s\" does not fit in %zu bytes", agg->name, len);
+		return -ENOMEM;
+	}
+
+	return pos;
+}
+
+void signal_agg_ack(struct signal_agg *agg)
+{
+	k_spinlock_key_t key = k_spin_lock(&agg->lock);
+
+	memset(&agg->unacked, 0, sizeof(agg->unacked));
+
+	k_spin_unlock(&agg->lock, key);
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __SIGNAL_AGG_H__
+#define __SIGNAL_AGG_H__
+
+/** Streaming aggregation of vehicle signals between uploads.
+ *
+ * Every sample of a signal is folded into its minimum, maximum, sum, count and
+ * a fixed-bucket histogram. Once per upload window the aggregate is rolled up
+ * into a compact JSON object, so every sample contributes to what is uploaded
+ * instead of only the one that lines up with a GPS fix.
+ *
+ * A rolled up window is kept until signal_agg_ack() confirms its upload. If
+ * the upload fails, the next rollup covers both windows, so no sample is lost.
+ *
+ * Samples may be added from any thread; the rollup is taken atomically.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/spinlock.h>
+
+#define SIGNAL_AGG_HIST_BUCKETS CONFIG_APP_SIGNAL_AGG_HIST_BUCKETS
+
+struct signal_agg_window {
+	int32_t min;
+	int32_t max;
+	int32_t last;
+	int64_t sum;
+	uint32_t count;
+	uint32_t hist[SIGNAL_AGG_HIST_BUCKETS];
+};
+
+struct signal_agg {
+	/** Name of the signal in the rollup */
+	const char *name;
+	/** Width of a histogram bucket; the last bucket is open-ended */
+	int32_t bucket_width;
+	struct k_spinlock lock;
+	/** Samples since the last rollup */
+	struct signal_agg_window current;
+	/** Rolled up samples waiting for signal_agg_ack() */
+	struct signal_agg_window unacked;
+};
+
+/**
+ * Statically define an aggregator.
+ *
+ * @param _var variable name
+ * @param _name name of the signal in the rollup
+ * @param _bucket_width width of a histogram bucket, starting at 0
+ */
+#define SIGNAL_AGG_DEFINE(_var, _name, _bucket_width)                                              \
+	static struct signal_agg _var = {.name = _name, .bucket_width = _bucket_width}
+
+/** Fold a sample into the aggregate. */
+void signal_agg_add(struct signal_agg *agg, int32_t value);
+
+/**
+ * Format the aggregate as a JSON member and start a new window.
+ *
+ * Writes `"<name>":{"min":..,"max":..,"mean":..,"last":..,"count":..,"hist":[..]}`.
+ * The rollup includes any earlier window that was not acknowledged.
+ *
+ * @return length of the string written, 0 if there were no samples in the
+ *         window, or -ENOMEM if @p buf is too small
+ */
+int signal_agg_rollup(struct signal_agg *agg, char *buf, size_t len);
+
+/** Drop the last rollup once it has been uploaded. */
+void signal_agg_ack(struct signal_agg *agg);
+
+#endif /* __SIGNAL_AGG_H__ */
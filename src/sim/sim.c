@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(sim, LOG_LEVEL_DBG);
+
+#include <string.h>
+#include <golioth/client.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include "cmdline.h"
+#include "posix_board_if.h"
+#include "posix_native_task.h"
+
+#include "app_stats.h"
+#include "perf_stats.h"
+#include "sim.h"
+#include "track_queue.h"
+
+#define REPORT_LEN  2048
+#define SAMPLE_LEN  256
+#define MAX_STACKS  16
+
+struct sim_options sim_options = {
+	.speedup = 1.0,
+	.ecu_delay_ms = CONFIG_APP_SIM_ECU_DELAY_MS,
+	.psk_id = CONFIG_APP_SIM_PSK_ID,
+	.psk = CONFIG_APP_SIM_PSK,
+};
+
+/* Track queue and connection state followed every second for soak tests */
+struct soak_stats {
+	uint32_t queue_peak_bytes;
+	/* Track queue size when the client was last disconnected */
+	uint32_t outage_queue_bytes;
+	/* Uptime at which the client reconnected, 0 when recovered */
+	int64_t recovering_since_ms;
+	uint32_t connections;
+	uint32_t recoveries;
+	uint32_t recovery_total_ms;
+	uint32_t recovery_max_ms;
+	/* Disconnections before the queue drained */
+	uint32_t unrecovered;
+	bool was_connected;
+};
+
+/* Stack high-watermarks, formatted from k_thread_foreach() */
+struct stacks_ctx {
+	char *buf;
+	size_t len;
+	int pos;
+	int count;
+};
+
+extern struct sys_heap _system_heap;
+
+static struct golioth_client *_client;
+static char _report[REPORT_LEN];
+static struct soak_stats _soak;
+
+static void sim_add_options(void)
+{
+	static struct args_struct_t sim_args[] = {
+		{
+			.option = "speedup",
+			.name = "factor",
+			.type = 'd',
+			.dest = (void *)&sim_options.speedup,
+			.descript = "Replay the NMEA recording this many times faster",
+		},
+		{
+			.option = "duration",
+			.name = "s",
+			.type = 'u',
+			.dest = (void *)&sim_options.duration_s,
+			.descript = "Print the benchmark report and exit after this many seconds",
+		},
+		{
+			.option = "ecu_delay_ms",
+			.name = "ms",
+			.type = 'u',
+			.dest = (void *)&sim_options.ecu_delay_ms,
+			.descript = "Emulated ECU response time",
+		},
+		{
+			.option = "sample_s",
+			.name = "s",
+			.type = 'u',
+			.dest = (void *)&sim_options.sample_s,
+			.descript = "Print a SIM_SAMPLE line every this many seconds",
+		},
+		{
+			.option = "psk_id",
+			.name = "id",
+			.type = 's',
+			.dest = (void *)&sim_options.psk_id,
+			.descript = "PSK ID the local Golioth server expects",
+		},
+		{
+			.option = "psk",
+			.name = "psk",
+			.type = 's',
+			.dest = (void *)&sim_options.psk,
+			.descript = "PSK the local Golioth server expects",
+		},
+		ARG_TABLE_ENDMARKER,
+	};
+
+	native_add_command_line_opts(sim_args);
+}
+
+NATIVE_TASK(sim_add_options, PRE_BOOT_1, 10);
+
+const struct golioth_client_config *sim_client_config(void)
+{
+	static struct golioth_client_config config = {
+		.credentials = {
+			.auth_type = GOLIOTH_TLS_AUTH_TYPE_PSK,
+		},
+	};
+
+	config.credentials.psk.psk_id = sim_options.psk_id;
+	config.credentials.psk.psk_id_len = strlen(sim_options.psk_id);
+	config.credentials.psk.psk = sim_options.psk;
+	config.credentials.psk.psk_len = strlen(sim_options.psk);
+
+	return &config;
+}
+
+static int format_latencies(char *buf, size_t len)
+{
+	int pos = 0;
+
+#ifdef CONFIG_APP_PERF_STATS
+	struct perf_stats_summary summary;
+
+	for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+		perf_stats_get(i, &summary);
+		pos += snprintk(&buf[pos], (pos < len) ? (len - pos) : 0,
+				"%s\"%s\":[%u,%u,%u,%u,%u]", (i == 0) ? "" : ",",
+				perf_stats_stage_name(i), summary.n, summary.mean_us,
+				summary.p50_us, summary.p99_us, summary.max_us);
+	}
+#endif /* CONFIG_APP_PERF_STATS */
+
+	return pos;
+}
+
+static void format_stack(const struct k_thread *cthread, void *user_data)
+{
+	struct k_thread *thread = (struct k_thread *)cthread;
+	struct stacks_ctx *ctx = user_data;
+	const char *name = k_thread_name_get(thread);
+	size_t unused = 0;
+
+	if (ctx->count >= MAX_STACKS) {
+		return;
+	}
+
+	k_thread_stack_space_get(thread, &unused);
+
+	/* [size, peak used] */
+	ctx->pos += snprintk(&ctx->buf[ctx->pos], (ctx->pos < ctx->len) ? (ctx->len - ctx->pos) : 0,
+			     "%s\"%s\":[%zu,%zu]", (ctx->count == 0) ? "" : ",",
+			     (name && name[0]) ? name : "?", thread->stack_info.size,
+			     thread->stack_info.size - unused);
+	ctx->count++;
+}
+
+static int format_memory(char *buf, size_t len)
+{
+	struct stacks_ctx ctx = {.buf = buf, .len = len};
+	struct sys_memory_stats heap_stats;
+
+	sys_heap_runtime_stats_get(&_system_heap, &heap_stats);
+
+	ctx.pos = snprintk(buf, len, "\"heap\":[%zu,%zu,%zu],\"stacks\":{",
+			   heap_stats.allocated_bytes + heap_stats.free_bytes,
+			   heap_stats.allocated_bytes, heap_stats.max_allocated_bytes);
+	k_thread_foreach(format_stack, &ctx);
+	ctx.pos += snprintk(&buf[ctx.pos], (ctx.pos < len) ? (len - ctx.pos) : 0, "}");
+
+	return ctx.pos;
+}
+
+/* Outages are seen as the client loses its connection to the server */
+static void soak_update(int64_t now_ms, bool connected)
+{
+	uint32_t queue_bytes = track_queue_used();
+	uint32_t recovery_ms;
+
+	_soak.queue_peak_bytes = MAX(_soak.queue_peak_bytes, queue_bytes);
+
+	if (_soak.was_connected && !connected) {
+		if (_soak.recovering_since_ms) {
+			_soak.unrecovered++;
+			_soak.recovering_since_ms = 0;
+		} else {
+			_soak.outage_queue_bytes = queue_bytes;
+		}
+	} else if (!_soak.was_connected && connected) {
+		/* The first connection is not a recovery */
+		if (_soak.connections++ > 0) {
+			_soak.recovering_since_ms = now_ms;
+		}
+	}
+	_soak.was_connected = connected;
+
+	/* Recovered once the backlog of the outage is uploaded */
+	if (_soak.recovering_since_ms && (queue_bytes <= _soak.outage_queue_bytes)) {
+		recovery_ms = (uint32_t)(now_ms - _soak.recovering_since_ms);
+		_soak.recoveries++;
+		_soak.recovery_total_ms += recovery_ms;
+		_soak.recovery_max_ms = MAX(_soak.recovery_max_ms, recovery_ms);
+		_soak.recovering_since_ms = 0;
+	}
+}
+
+static void print_sample(int64_t now_ms, bool connected)
+{
+	static char sample[SAMPLE_LEN];
+	struct sys_memory_stats heap_stats;
+	struct sim_gnss_stats gnss;
+
+	sim_gnss_get_stats(&gnss);
+	sys_heap_runtime_stats_get(&_system_heap, &heap_stats);
+
+	snprintk(sample, sizeof(sample),
+		 "{\"t\":%u,\"rmc\":%u,\"track_seq\":%u,\"queue_bytes\":%u,\"heap_used\":%zu,"
+		 "\"connected\":%d}",
+		 (uint32_t)(now_ms / MSEC_PER_SEC), gnss.rmc, app_stats_last_seq(APP_SEQ_TRACK),
+		 (uint32_t)track_queue_used(), heap_stats.allocated_bytes, connected);
+	printk("SIM_SAMPLE %s\n", sample);
+}
+
+static void tick_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(tick_work, tick_work_handler);
+
+static void tick_work_handler(struct k_work *work)
+{
+	static uint32_t ticks;
+	int64_t now_ms = k_uptime_get();
+	bool connected = golioth_client_is_connected(_client);
+
+	soak_update(now_ms, connected);
+
+	ticks++;
+	if (sim_options.sample_s && ((ticks % sim_options.sample_s) == 0)) {
+		print_sample(now_ms, connected);
+	}
+
+	k_work_schedule(&tick_work, K_SECONDS(1));
+}
+
+static void report_work_handler(struct k_work *work)
+{
+	struct sim_gnss_stats gnss;
+	uint32_t can_requests;
+	uint32_t can_replies;
+	int pos;
+
+	sim_gnss_get_stats(&gnss);
+	sim_ecu_get_stats(&can_requests, &can_replies);
+
+	pos = snprintk(_report, sizeof(_report),
+		       "{\"speedup\":%.3f,\"duration_s\":%u,\"nmea_lines\":%u,\"rmc\":%u,"
+		       "\"uart_overrun_bytes\":%u,\"can_requests\":%u,\"can_replies\":%u,"
+		       "\"track_seq\":%u,\"event_seq\":%u,\"track_queue_bytes\":%u,"
+		       "\"drops\":{\"gnss_queue\":%u,\"track_queue\":%u,\"track_upload\":%u,"
+		       "\"event_queue\":%u,\"stream\":%u},\"latency_us\":{",
+		       sim_options.speedup, (uint32_t)(k_uptime_get() / 1000), gnss.lines, gnss.rmc,
+		       gnss.overrun_bytes, can_requests, can_replies,
+		       app_stats_last_seq(APP_SEQ_TRACK), app_stats_last_seq(APP_SEQ_EVENT),
+		       (uint32_t)track_queue_used(), app_stats_get(APP_STAT_GNSS_QUEUE_DROPS),
+		       app_stats_get(APP_STAT_TRACK_QUEUE_DROPS),
+		       app_stats_get(APP_STAT_TRACK_UPLOAD_ERRORS),
+		       app_stats_get(APP_STAT_EVENT_QUEUE_DROPS),
+		       app_stats_get(APP_STAT_STREAM_ERRORS));
+	pos += format_latencies(&_report[pos], MAX(0, (int)sizeof(_report) - pos));
+	pos += snprintk(&_report[pos], MAX(0, (int)sizeof(_report) - pos),
+			"},\"soak\":{\"queue_peak_bytes\":%u,\"reconnects\":%u,\"recoveries\":%u,"
+			"\"recovery_mean_ms\":%u,\"recovery_max_ms\":%u,\"unrecovered\":%u},",
+			_soak.queue_peak_bytes, MAX(_soak.connections, 1) - 1, _soak.recoveries,
+			_soak.recoveries ? (_soak.recovery_total_ms / _soak.recoveries) : 0,
+			_soak.recovery_max_ms, _soak.unrecovered);
+	pos += format_memory(&_report[pos], MAX(0, (int)sizeof(_report) - pos));
+	pos += snprintk(&_report[pos], MAX(0, (int)sizeof(_report) - pos), "}");
+
+	if (pos >= sizeof(_report)) {
+		LOG_ERR("Benchmark report truncated, increase REPORT_LEN");
+	}
+
+	/* Bypasses the log, which may drop messages under load */
+	printk("SIM_RESULT %s\n", _report);
+
+	posix_exit(0);
+}
+static K_WORK_DELAYABLE_DEFINE(report_work, report_work_handler);
+
+void sim_start(struct golioth_client *client)
+{
+	_client = client;
+
+	sim_ecu_start();
+	sim_gnss_start();
+
+	k_work_schedule(&tick_work, K_SECONDS(1));
+
+	if (sim_options.duration_s) {
+		k_work_schedule(&report_work, K_SECONDS(sim_options.duration_s));
+	}
+}
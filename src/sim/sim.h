@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+/** Simulated GNSS receiver and vehicle for native_sim.
+ *
+ * - sim_gnss.c replays the NMEA recording CONFIG_APP_SIM_NMEA_FILE into the
+ *   emulated GNSS UART, -speedup times faster than it was recorded.
+ * - sim_ecu.c answers OBD-II vehicle speed requests on the loopback CAN
+ *   controller with the speed of the last RMC sentence replayed.
+ *
+ * Golioth itself is not simulated in the image: the Golioth client connects
+ * over DTLS PSK, through the host sockets, to the local CoAP server of
+ * scripts/sim_cloud.py, which stands in for the Golioth device API and adds
+ * the latency, packet loss, throttling and outages of a network profile.
+ *
+ * With -sample_s, a `SIM_SAMPLE {...}` line is printed every that many
+ * seconds for soak tests. With -duration, a benchmark report is printed as a
+ * `SIM_RESULT {...}` line after that many seconds and the simulation exits.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <golioth/client.h>
+
+struct sim_options {
+	double speedup;
+	uint32_t duration_s;
+	uint32_t ecu_delay_ms;
+	uint32_t sample_s;
+	char *psk_id;
+	char *psk;
+};
+
+struct sim_gnss_stats {
+	uint32_t lines;
+	uint32_t rmc;
+	/* Bytes that did not fit in the UART RX FIFO */
+	uint32_t overrun_bytes;
+	uint32_t loops;
+};
+
+extern struct sim_options sim_options;
+
+/** Golioth client configuration for the local server, from -psk_id and -psk. */
+const struct golioth_client_config *sim_client_config(void);
+
+/** Start the simulation once the Golioth client is started. */
+void sim_start(struct golioth_client *client);
+
+void sim_gnss_start(void);
+void sim_gnss_get_stats(struct sim_gnss_stats *stats);
+/** Speed over ground of the last RMC sentence replayed. */
+uint8_t sim_gnss_speed_kmh(void);
+
+void sim_ecu_start(void);
+void sim_ecu_get_stats(uint32_t *requests, uint32_t *replies);
+
+#endif /* __SIM_H__ */
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(sim_ecu, LOG_LEVEL_DBG);
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "sim.h"
+
+#define OBD2_PID_REQUEST_ID	       0x7DF
+#define OBD2_PID_RESPONSE_ID	       0x7E8
+#define OBD2_PID_RESPONSE_DLC	       8
+#define OBD2_SERVICE_SHOW_CURRENT_DATA 0x01
+#define OBD2_PID_VEHICLE_SPEED	       0x0D
+
+static const struct device *const can_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
+
+static atomic_t _requests;
+static atomic_t _replies;
+
+static void reply_work_handler(struct k_work *work)
+{
+	struct can_frame frame = {
+		.id = OBD2_PID_RESPONSE_ID,
+		.dlc = OBD2_PID_RESPONSE_DLC,
+		.data = {3, OBD2_SERVICE_SHOW_CURRENT_DATA + 0x40, OBD2_PID_VEHICLE_SPEED,
+			 sim_gnss_speed_kmh(), 0xCC, 0xCC, 0xCC, 0xCC},
+	};
+	int err;
+
+	err = can_send(can_dev, &frame, K_MSEC(100), NULL, NULL);
+	if (err) {
+		LOG_ERR("Unable to send vehicle speed reply: %d", err);
+		return;
+	}
+
+	atomic_inc(&_replies);
+}
+static K_WORK_DELAYABLE_DEFINE(reply_work, reply_work_handler);
+
+/* Called from the CAN controller's receive context, the reply is sent from a work item */
+static void request_cb(const struct device *dev, struct can_frame *frame, void *user_data)
+{
+	if ((can_dlc_to_bytes(frame->dlc) < 3) ||
+	    (frame->data[1] != OBD2_SERVICE_SHOW_CURRENT_DATA) ||
+	    (frame->data[2] != OBD2_PID_VEHICLE_SPEED)) {
+		return;
+	}
+
+	atomic_inc(&_requests);
+	k_work_reschedule(&reply_work, K_MSEC(sim_options.ecu_delay_ms));
+}
+
+void sim_ecu_get_stats(uint32_t *requests, uint32_t *replies)
+{
+	*requests = (uint32_t)atomic_get(&_requests);
+	*replies = (uint32_t)atomic_get(&_replies);
+}
+
+void sim_ecu_start(void)
+{
+	const struct can_filter filter = {
+		.flags = 0U, .id = OBD2_PID_REQUEST_ID, .mask = CAN_STD_ID_MASK};
+	int filter_id;
+
+	filter_id = can_add_rx_filter(can_dev, request_cb, NULL, &filter);
+	if (filter_id < 0) {
+		LOG_ERR("Unable to add ECU request filter: %d", filter_id);
+		return;
+	}
+
+	LOG_INF("Emulated ECU answering vehicle speed requests after %u ms",
+		sim_options.ecu_delay_ms);
+}
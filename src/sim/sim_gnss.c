@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(sim_gnss, LOG_LEVEL_DBG);
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/serial/uart_emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+
+#include "sim.h"
+
+#define SIM_GNSS_THREAD_STACK_SIZE 1024
+/* Above the application threads, like a UART receiving on its own */
+#define SIM_GNSS_THREAD_PRIORITY   K_PRIO_COOP(1)
+
+#define KNOTS_TO_KMH 1.852
+
+/* Fields are "$GPRMC,hhmmss.ss,", the talker ID may vary */
+#define SENTENCE_TYPE_POS 3
+#define SENTENCE_TIME_POS 7
+
+static const uint8_t nmea[] = {
+#include "sim_nmea.inc"
+};
+
+static const struct device *const uart_dev = DEVICE_DT_GET(DT_ALIAS(click_uart));
+
+static struct k_spinlock stats_lock;
+static struct sim_gnss_stats _stats;
+static uint8_t _speed_kmh;
+
+K_THREAD_STACK_DEFINE(sim_gnss_stack, SIM_GNSS_THREAD_STACK_SIZE);
+static struct k_thread sim_gnss_thread_data;
+
+static bool is_sentence(const char *line, size_t len, const char *type)
+{
+	return (len > (SENTENCE_TIME_POS + 6)) && (line[0] == '$') &&
+	       (strncmp(&line[SENTENCE_TYPE_POS], type, 4) == 0);
+}
+
+/* UTC time of an RMC or GGA sentence in seconds of the day, -1 if it has none */
+static int sentence_time_s(const char *line, size_t len)
+{
+	const char *t = &line[SENTENCE_TIME_POS];
+
+	if (!is_sentence(line, len, "RMC,") && !is_sentence(line, len, "GGA,")) {
+		return -1;
+	}
+
+	for (int i = 0; i < 6; i++) {
+		if ((t[i] < '0') || (t[i] > '9')) {
+			return -1;
+		}
+	}
+
+	return ((t[0] - '0') * 10 + (t[1] - '0')) * 3600 + ((t[2] - '0') * 10 + (t[3] - '0')) * 60 +
+	       (t[4] - '0') * 10 + (t[5] - '0');
+}
+
+/* Speed over ground (field 7) of an RMC sentence, -1 if empty */
+static int rmc_speed_kmh(const char *line, size_t len)
+{
+	const char *field = line;
+
+	for (int i = 0; i < 7; i++) {
+		field = memchr(field, ',', len - (field - line));
+		if (field == NULL) {
+			return -1;
+		}
+		field++;
+	}
+
+	if ((*field == ',') || (*field == '*')) {
+		return -1;
+	}
+
+	return (int)(strtod(field, NULL) * KNOTS_TO_KMH + 0.5);
+}
+
+static void sleep_file_time(int seconds)
+{
+	k_sleep(K_USEC((int64_t)(seconds * USEC_PER_SEC / sim_options.speedup)));
+}
+
+static void sim_gnss_thread(void *arg1, void *arg2, void *arg3)
+{
+	const char *line;
+	const char *end;
+	k_spinlock_key_t key;
+	size_t pos = 0;
+	int prev_s = -1;
+	uint32_t put;
+	size_t len;
+	int time_s;
+	int speed;
+	bool rmc;
+
+	while (1) {
+		line = (const char *)&nmea[pos];
+		end = memchr(line, '\n', sizeof(nmea) - pos);
+		len = end ? (end - line + 1) : (sizeof(nmea) - pos);
+
+		/* Sentences of one fix are sent back to back, fixes are paced by their time */
+		time_s = sentence_time_s(line, len);
+		if ((time_s >= 0) && (time_s != prev_s)) {
+			if (prev_s >= 0) {
+				sleep_file_time((time_s - prev_s + 86400) % 86400);
+			}
+			prev_s = time_s;
+		}
+
+		rmc = is_sentence(line, len, "RMC,");
+		speed = rmc ? rmc_speed_kmh(line, len) : -1;
+
+		put = uart_emul_put_rx_data(uart_dev, (const uint8_t *)line, len);
+
+		key = k_spin_lock(&stats_lock);
+		_stats.lines++;
+		if (rmc) {
+			_stats.rmc++;
+		}
+		/* No speed while there is no fix, the vehicle keeps going */
+		if (speed >= 0) {
+			_speed_kmh = MIN(speed, UINT8_MAX);
+		}
+		_stats.overrun_bytes += len - put;
+		k_spin_unlock(&stats_lock, key);
+
+		pos += len;
+		if (pos >= sizeof(nmea)) {
+			key = k_spin_lock(&stats_lock);
+			_stats.loops++;
+			k_spin_unlock(&stats_lock, key);
+
+			/* The recording restarts one fix interval later */
+			pos = 0;
+			prev_s = -1;
+			sleep_file_time(1);
+		}
+	}
+}
+
+void sim_gnss_get_stats(struct sim_gnss_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+	*stats = _stats;
+	k_spin_unlock(&stats_lock, key);
+}
+
+uint8_t sim_gnss_speed_kmh(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+	uint8_t speed = _speed_kmh;
+
+	k_spin_unlock(&stats_lock, key);
+
+	return speed;
+}
+
+void sim_gnss_start(void)
+{
+	k_tid_t tid;
+
+	if (!device_is_ready(uart_dev)) {
+		LOG_ERR("GNSS UART emulator not ready");
+		return;
+	}
+
+	LOG_INF("Replaying %s (%zu bytes) at %d.%02dx", CONFIG_APP_SIM_NMEA_FILE, sizeof(nmea),
+		(int)sim_options.speedup, (int)(sim_options.speedup * 100) % 100);
+
+	tid = k_thread_create(&sim_gnss_thread_data, sim_gnss_stack,
+			      K_THREAD_STACK_SIZEOF(sim_gnss_stack), sim_gnss_thread, NULL, NULL,
+			      NULL, SIM_GNSS_THREAD_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(tid, "sim_gnss");
+}
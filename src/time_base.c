@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(time_base, LOG_LEVEL_DBG);
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#ifdef CONFIG_DATE_TIME
+#include <date_time.h>
+#endif
+
+#include "time_base.h"
+
+/* Network time is only used if GNSS time has not been seen for this long */
+#define GNSS_HOLDOVER_MS      (60 * 60 * 1000LL)
+/* Errors larger than this are stepped instead of being used to estimate drift */
+#define STEP_THRESHOLD_MS     1000
+/* Shortest interval over which the drift is measured; RMC time has 10 ms resolution */
+#define DRIFT_MIN_BASELINE_MS (10 * 60 * 1000LL)
+/* Larger measured drifts are not plausible for a crystal oscillator */
+#define DRIFT_MAX_PPM	      500.0f
+/* Weight of a new drift measurement in the estimate */
+#define DRIFT_GAIN	      0.25f
+
+static struct k_spinlock _lock;
+static struct {
+	bool synced;
+	enum time_base_source source;
+	/* Last disciplining measurement */
+	int64_t ref_uptime_ms;
+	int64_t ref_utc_ms;
+	/* Start of the current drift measurement, 0 if none */
+	int64_t drift_ref_uptime_ms;
+	int64_t drift_ref_utc_ms;
+	float drift_ppm;
+	bool has_drift;
+	int64_t last_gnss_uptime_ms;
+	bool has_gnss;
+} _tb;
+
+static int64_t to_utc_locked(int64_t uptime_ms)
+{
+	int64_t elapsed_ms = uptime_ms - _tb.ref_uptime_ms;
+
+	return _tb.ref_utc_ms + elapsed_ms + (int64_t)(elapsed_ms * (double)_tb.drift_ppm / 1e6);
+}
+
+static void update_drift_locked(int64_t utc_ms, int64_t uptime_ms)
+{
+	int64_t baseline_ms = uptime_ms - _tb.drift_ref_uptime_ms;
+	float measured_ppm;
+
+	if (!_tb.drift_ref_uptime_ms) {
+		_tb.drift_ref_uptime_ms = uptime_ms;
+		_tb.drift_ref_utc_ms = utc_ms;
+		return;
+	}
+
+	if (baseline_ms < DRIFT_MIN_BASELINE_MS) {
+		return;
+	}
+
+	measured_ppm = (float)((utc_ms - _tb.drift_ref_utc_ms) - baseline_ms) * 1e6f / baseline_ms;
+	if (fabsf(measured_ppm) <= DRIFT_MAX_PPM) {
+		_tb.drift_ppm = _tb.has_drift
+					? _tb.drift_ppm + (measured_ppm - _tb.drift_ppm) * DRIFT_GAIN
+					: measured_ppm;
+		_tb.has_drift = true;
+	}
+
+	_tb.drift_ref_uptime_ms = uptime_ms;
+	_tb.drift_ref_utc_ms = utc_ms;
+}
+
+void time_base_discipline(int64_t utc_ms, int64_t uptime_ms, enum time_base_source source)
+{
+	k_spinlock_key_t key = k_spin_lock(&_lock);
+	int64_t error_ms = 0;
+
+	if ((source == TIME_BASE_SOURCE_NETWORK) && _tb.has_gnss &&
+	    ((uptime_ms - _tb.last_gnss_uptime_ms) < GNSS_HOLDOVER_MS)) {
+		/* GNSS time is far more accurate, keep using it */
+		goto unlock;
+	}
+
+	if (_tb.synced) {
+		error_ms = utc_ms - to_utc_locked(uptime_ms);
+	}
+
+	if (!_tb.synced || (source != _tb.source) || (llabs(error_ms) > STEP_THRESHOLD_MS)) {
+		/* Restart the drift measurement, keep the drift estimate */
+		_tb.drift_ref_uptime_ms = 0;
+	}
+	update_drift_locked(utc_ms, uptime_ms);
+
+	_tb.ref_uptime_ms = uptime_ms;
+	_tb.ref_utc_ms = utc_ms;
+	_tb.source = source;
+	if (source == TIME_BASE_SOURCE_GNSS) {
+		_tb.last_gnss_uptime_ms = uptime_ms;
+		_tb.has_gnss = true;
+	}
+
+	if (!_tb.synced || (llabs(error_ms) > STEP_THRESHOLD_MS)) {
+		_tb.synced = true;
+		k_spin_unlock(&_lock, key);
+		LOG_INF("UTC time set from %s (error: %d ms)",
+			(source == TIME_BASE_SOURCE_GNSS) ? "GNSS" : "network", (int)error_ms);
+		return;
+	}
+
+unlock:
+	k_spin_unlock(&_lock, key);
+}
+
+int64_t time_base_utc_ms(int64_t uptime_ms)
+{
+	k_spinlock_key_t key = k_spin_lock(&_lock);
+	int64_t utc_ms = _tb.synced ? to_utc_locked(uptime_ms) : 0;
+
+	k_spin_unlock(&_lock, key);
+
+	return utc_ms;
+}
+
+void time_base_update(void)
+{
+#ifdef CONFIG_DATE_TIME
+	int64_t utc_ms;
+	int64_t uptime_ms = k_uptime_get();
+
+	if (date_time_now(&utc_ms) == 0) {
+		time_base_discipline(utc_ms, uptime_ms, TIME_BASE_SOURCE_NETWORK);
+	}
+#endif
+}
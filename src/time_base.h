@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __TIME_BASE_H__
+#define __TIME_BASE_H__
+
+/** Mapping between the monotonic uptime and UTC.
+ *
+ * Records are timestamped with the uptime at which they were captured and
+ * converted to UTC through this mapping, so every record gets an exact
+ * timestamp even when it is captured without a valid GNSS fix, and no matter
+ * how long it waits for upload.
+ *
+ * The mapping is disciplined by the UTC time of valid RMC sentences and, when
+ * no GNSS time has been seen for a while, by the cellular network time. The
+ * drift of the uptime clock against UTC is estimated from consecutive
+ * disciplining samples, which keeps the mapping accurate while the GNSS
+ * receiver is off.
+ */
+
+#include <stdint.h>
+
+enum time_base_source {
+	TIME_BASE_SOURCE_GNSS,
+	TIME_BASE_SOURCE_NETWORK,
+};
+
+/**
+ * Discipline the mapping with a UTC time measurement.
+ *
+ * @param utc_ms UTC time in milliseconds since the Unix epoch
+ * @param uptime_ms uptime at which @p utc_ms was valid
+ * @param source where the measurement comes from
+ */
+void time_base_discipline(int64_t utc_ms, int64_t uptime_ms, enum time_base_source source);
+
+/**
+ * Convert an uptime to UTC.
+ *
+ * @return UTC time in milliseconds since the Unix epoch, 0 if not known yet
+ */
+int64_t time_base_utc_ms(int64_t uptime_ms);
+
+/** Discipline the mapping from the network time if GNSS time is not available. */
+void time_base_update(void);
+
+#endif /* __TIME_BASE_H__ */
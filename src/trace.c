@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(trace, LOG_LEVEL_DBG);
+
+#include <errno.h>
+#include <string.h>
+#include <golioth/stream.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "trace.h"
+
+#define GOLIOTH_STREAM_TIMEOUT_S 2
+
+#define RECORDS	     CONFIG_APP_TRACE_RECORDS
+#define CHUNK_EVENTS CONFIG_APP_TRACE_CHUNK_EVENTS
+
+/* "[4294967295,65535,4294967295]," */
+#define CHUNK_EVENT_MAX_LEN (1 + 10 + 1 + 5 + 1 + 10 + 2)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(RECORDS), "CONFIG_APP_TRACE_RECORDS must be a power of two");
+
+struct trace_record trace_ring[RECORDS];
+atomic_t trace_head;
+atomic_t trace_armed;
+
+K_MUTEX_DEFINE(trace_mutex);
+
+static struct {
+	bool active;
+	/* Index of the next record to stream and of the end of the ring */
+	uint32_t next;
+	uint32_t end;
+	uint32_t seq;
+} _download;
+
+/* Only used by the thread calling trace_stream() */
+static char _chunk_json[CHUNK_EVENTS * CHUNK_EVENT_MAX_LEN + 64];
+
+static uint32_t frozen_count(void)
+{
+	return MIN((uint32_t)atomic_get(&trace_head), RECORDS);
+}
+
+int trace_command(const char *cmd, size_t len)
+{
+	uint32_t head;
+
+	k_mutex_lock(&trace_mutex, K_FOREVER);
+
+	if ((len == 3) && (strncmp(cmd, "arm", len) == 0)) {
+		atomic_clear(&trace_armed);
+		_download.active = false;
+		memset(trace_ring, 0, sizeof(trace_ring));
+		atomic_clear(&trace_head);
+		atomic_set(&trace_armed, 1);
+		LOG_INF("Trace armed, %d records", RECORDS);
+	} else if ((len == 6) && (strncmp(cmd, "freeze", len) == 0)) {
+		atomic_clear(&trace_armed);
+		LOG_INF("Trace frozen, %u records", frozen_count());
+	} else if ((len == 8) && (strncmp(cmd, "download", len) == 0)) {
+		atomic_clear(&trace_armed);
+		head = (uint32_t)atomic_get(&trace_head);
+		_download.next = head - frozen_count();
+		_download.end = head;
+		_download.seq = 0;
+		_download.active = true;
+		LOG_INF("Trace download of %u records requested", frozen_count());
+	} else {
+		k_mutex_unlock(&trace_mutex);
+		return -EINVAL;
+	}
+
+	k_mutex_unlock(&trace_mutex);
+
+	return frozen_count();
+}
+
+static size_t format_chunk(uint32_t first, size_t n, uint32_t seq, bool last)
+{
+	size_t pos;
+
+	pos = snprintk(_chunk_json, sizeof(_chunk_json),
+		       "{\"seq\":%u,\"last\":%s,\"hz\":%u,\"events\":[", seq,
+		       last ? "true" : "false", (uint32_t)timing_freq_get());
+
+	for (size_t i = 0; i < n; i++) {
+		const struct trace_record *rec = &trace_ring[(first + i) & (RECORDS - 1)];
+
+		pos += snprintk(&_chunk_json[pos], sizeof(_chunk_json) - pos, "%s[%u,%u,%u]",
+				(i == 0) ? "" : ",", rec->cycles, rec->event, rec->arg);
+	}
+
+	pos += snprintk(&_chunk_json[pos], sizeof(_chunk_json) - pos, "]}");
+
+	return pos;
+}
+
+void trace_stream(struct golioth_client *client)
+{
+	uint32_t first;
+	uint32_t seq;
+	size_t len;
+	size_t n;
+	bool last;
+	int err;
+
+	while (1) {
+		k_mutex_lock(&trace_mutex, K_FOREVER);
+
+		if (!_download.active) {
+			k_mutex_unlock(&trace_mutex);
+			return;
+		}
+
+		first = _download.next;
+		seq = _download.seq;
+		n = MIN(_download.end - first, CHUNK_EVENTS);
+		last = (first + n) == _download.end;
+
+		/* The ring is frozen, and re-arming waits for the mutex */
+		len = format_chunk(first, n, seq, last);
+
+		k_mutex_unlock(&trace_mutex);
+
+		err = golioth_stream_set_sync(client, TRACE_STREAM_ENDP, GOLIOTH_CONTENT_TYPE_JSON,
+					      _chunk_json, len, GOLIOTH_STREAM_TIMEOUT_S);
+		if (err) {
+			/* Retry from the same record on the next call */
+			LOG_ERR("Failed to send trace chunk to Golioth: %d", err);
+			return;
+		}
+
+		k_mutex_lock(&trace_mutex, K_FOREVER);
+		if (_download.active && (_download.next == first) && (_download.seq == seq)) {
+			_download.next += n;
+			_download.seq++;
+			_download.active = !last;
+		}
+		k_mutex_unlock(&trace_mutex);
+	}
+}
+
+static int trace_init(void)
+{
+	timing_init();
+	timing_start();
+
+	IF_ENABLED(CONFIG_APP_TRACE_ARM_AT_BOOT, (atomic_set(&trace_armed, 1);));
+
+	return 0;
+}
+
+SYS_INIT(trace_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/** Binary trace of hot-path events.
+ *
+ * Events are recorded as (cycle counter, event ID, 32-bit argument) into a
+ * ring of CONFIG_APP_TRACE_RECORDS records in RAM. Recording an event takes an
+ * interrupt lock around a slot increment and a cycle counter read, and three
+ * stores, so it can be used in ISRs and at microsecond-scale points where a
+ * log line would cost more than the event itself.
+ *
+ * The ring is controlled with the `trace` RPC: "arm" clears it and starts
+ * recording (oldest records are overwritten), "freeze" stops recording and
+ * "download" freezes it and streams it to the "trace" LightDB Stream endpoint.
+ * scripts/trace_to_perfetto.py converts the downloaded records to a Chrome
+ * trace that can be opened in https://ui.perfetto.dev.
+ *
+ * Without CONFIG_APP_TRACE, trace_event() is an empty inline.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <golioth/client.h>
+
+#define TRACE_STREAM_ENDP "trace"
+
+/*
+ * Event IDs. The first word after TRACE_ names the track an event is shown on,
+ * _BEGIN/_END pairs are shown as slices and every other event as an instant.
+ * scripts/trace_to_perfetto.py reads the names from this enum, so only append.
+ */
+enum trace_event {
+	/** UART RX interrupt (CONFIG_APP_TRACE_UART_ISR only) */
+	TRACE_ISR_UART,
+	/** NMEA line received, arg: length */
+	TRACE_ISR_NMEA_LINE,
+	/** RMC reading queued, arg: k_msgq_put() result */
+	TRACE_ISR_RMC_QUEUED,
+	/** RMC thread starts processing a reading */
+	TRACE_RMC_BEGIN,
+	/** RMC thread done with a reading, arg: TRACK_POINT_* flags, -1 if no position */
+	TRACE_RMC_END,
+	/** Vehicle speed request sent to the CAN controller */
+	TRACE_CAN_TX_BEGIN,
+	/** Vehicle speed request sent, arg: can_send() result */
+	TRACE_CAN_TX_END,
+	/** Vehicle speed reply received, arg: speed (km/h) */
+	TRACE_CAN_RX,
+	/** Main loop iteration starts */
+	TRACE_MAIN_LOOP_BEGIN,
+	/** Main loop iteration ends */
+	TRACE_MAIN_LOOP_END,
+	/** Track point upload starts, arg: seq */
+	TRACE_MAIN_STREAM_BEGIN,
+	/** Track point upload acknowledged, arg: golioth_stream_set_sync() result */
+	TRACE_MAIN_STREAM_END,
+	/** Main thread woken up early */
+	TRACE_MAIN_WAKE,
+	TRACE_EVENT_COUNT,
+};
+
+#ifdef CONFIG_APP_TRACE
+
+#include <zephyr/irq.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/timing/timing.h>
+
+struct trace_record {
+	/** Low 32 bits of the cycle counter */
+	uint32_t cycles;
+	uint16_t event;
+	uint16_t reserved;
+	uint32_t arg;
+};
+
+extern struct trace_record trace_ring[CONFIG_APP_TRACE_RECORDS];
+extern atomic_t trace_head;
+extern atomic_t trace_armed;
+
+/** Record an event if the trace is armed. Safe to call from an ISR. */
+static inline void trace_event(enum trace_event event, uint32_t arg)
+{
+	struct trace_record *rec;
+	uint32_t cycles;
+	unsigned int key;
+
+	if (!atomic_get(&trace_armed)) {
+		return;
+	}
+
+	/* Slots are claimed in timestamp order, even if an ISR preempts this */
+	key = irq_lock();
+	rec = &trace_ring[(uint32_t)atomic_inc(&trace_head) & (CONFIG_APP_TRACE_RECORDS - 1)];
+	cycles = (uint32_t)timing_counter_get();
+	irq_unlock(key);
+
+	rec->cycles = cycles;
+	rec->event = event;
+	rec->arg = arg;
+}
+
+/**
+ * Run a trace command: "arm", "freeze" or "download".
+ *
+ * @return number of records in the ring, -EINVAL for an unknown command
+ */
+int trace_command(const char *cmd, size_t len);
+
+/** Stream a downloaded trace in chunks. Called from the upload loop. */
+void trace_stream(struct golioth_client *client);
+
+#else /* CONFIG_APP_TRACE */
+
+static inline void trace_event(enum trace_event event, uint32_t arg)
+{
+}
+
+#endif /* CONFIG_APP_TRACE */
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+
+#include "track_codec.h"
+
+static inline uint64_t zigzag_encode(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static int varint_put(int64_t value, uint8_t *buf, size_t len)
+{
+	uint64_t zz = zigzag_encode(value);
+	size_t pos = 0;
+
+	do {
+		if (pos >= len) {
+			return -ENOMEM;
+		}
+
+		buf[pos] = zz & 0x7F;
+		zz >>= 7;
+		if (zz) {
+			buf[pos] |= 0x80;
+		}
+		pos++;
+	} while (zz);
+
+	return pos;
+}
+
+static int varint_get(int64_t *value, const uint8_t *buf, size_t len)
+{
+	uint64_t zz = 0;
+	size_t pos = 0;
+	bool more;
+
+	do {
+		if ((pos >= len) || (pos >= 10)) {
+			return -EINVAL;
+		}
+
+		zz |= (uint64_t)(buf[pos] & 0x7F) << (7 * pos);
+		more = buf[pos] & 0x80;
+		pos++;
+	} while (more);
+
+	*value = zigzag_decode(zz);
+
+	return pos;
+}
+
+int track_codec_encode(const struct track_point *prev, const struct track_point *pt,
+		       uint8_t *buf, size_t len)
+{
+	const int64_t deltas[] = {
+		pt->time_ms - prev->time_ms,
+		(int64_t)pt->lat - prev->lat,
+		(int64_t)pt->lon - prev->lon,
+		(int64_t)pt->speed - prev->speed,
+		(int64_t)pt->seq - prev->seq,
+	};
+	size_t pos = 0;
+	int ret;
+
+	if (len < 1) {
+		return -ENOMEM;
+	}
+	buf[pos++] = pt->flags;
+
+	for (int i = 0; i < ARRAY_SIZE(deltas); i++) {
+		ret = varint_put(deltas[i], &buf[pos], len - pos);
+		if (ret < 0) {
+			return ret;
+		}
+		pos += ret;
+	}
+
+	return pos;
+}
+
+int track_codec_decode(const struct track_point *prev, struct track_point *pt,
+		       const uint8_t *buf, size_t len)
+{
+	int64_t deltas[5];
+	size_t pos = 0;
+	int ret;
+
+	if (len < 1) {
+		return -EINVAL;
+	}
+	pt->flags = buf[pos++];
+
+	for (int i = 0; i < ARRAY_SIZE(deltas); i++) {
+		ret = varint_get(&deltas[i], &buf[pos], len - pos);
+		if (ret < 0) {
+			return ret;
+		}
+		pos += ret;
+	}
+
+	pt->time_ms = prev->time_ms + deltas[0];
+	pt->lat = (int32_t)(prev->lat + deltas[1]);
+	pt->lon = (int32_t)(prev->lon + deltas[2]);
+	pt->speed = (int16_t)(prev->speed + deltas[3]);
+	pt->seq = (uint32_t)(prev->seq + deltas[4]);
+
+	return pos;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __TRACK_CODEC_H__
+#define __TRACK_CODEC_H__
+
+/** Compact binary encoding of track points.
+ *
+ * Each point is stored as a flags byte followed by the zig-zag varint encoded
+ * difference of every field from the previous point. Consecutive fixes of a
+ * moving vehicle differ by small amounts, so a point typically takes 7-11 bytes
+ * instead of the ~32 bytes of struct track_point.
+ *
+ * Encoder and decoder each keep their own copy of the previous point and must
+ * see the same sequence of points. Start both from a zeroed point (or the same
+ * key point) to encode/decode a stream.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+
+/** Position is fake (substituted from the FAKE_GPS_* settings) */
+#define TRACK_POINT_FAKE      BIT(0)
+/** Position is dead-reckoned from vehicle speed during a GNSS fix gap */
+#define TRACK_POINT_ESTIMATED BIT(1)
+
+struct track_point {
+	/** UTC time in milliseconds since the Unix epoch, 0 if unknown */
+	int64_t time_ms;
+	/** Latitude in 1e-7 degrees */
+	int32_t lat;
+	/** Longitude in 1e-7 degrees */
+	int32_t lon;
+	/** Vehicle speed in km/h, -1 if unknown */
+	int16_t speed;
+	/** TRACK_POINT_* flags */
+	uint8_t flags;
+	/** Upload sequence number (see app_stats.h), 0 if not queued for upload */
+	uint32_t seq;
+};
+
+/** Upper bound of the encoded size of a single point */
+#define TRACK_POINT_MAX_ENCODED_LEN (1 + 10 + 5 + 5 + 3 + 5)
+
+/**
+ * Encode a point as the delta from the previous one.
+ *
+ * @param prev previously encoded point
+ * @param pt point to encode
+ * @param buf output buffer
+ * @param len size of the output buffer
+ *
+ * @return number of bytes written, or -ENOMEM if the buffer is too small
+ */
+int track_codec_encode(const struct track_point *prev, const struct track_point *pt,
+		       uint8_t *buf, size_t len);
+
+/**
+ * Decode a point encoded by track_codec_encode().
+ *
+ * @param prev previously decoded point
+ * @param pt decoded point
+ * @param buf input buffer
+ * @param len number of bytes available in the input buffer
+ *
+ * @return number of bytes consumed, or -EINVAL if the input is truncated
+ */
+int track_codec_decode(const struct track_point *prev, struct track_point *pt,
+		       const uint8_t *buf, size_t len);
+
+#endif /* __TRACK_CODEC_H__ */
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(track_history, LOG_LEVEL_DBG);
+
+#include <golioth/stream.h>
+#include <zephyr/kernel.h>
+
+#include "format_helper.h"
+#include "track_history.h"
+
+#define GOLIOTH_STREAM_TIMEOUT_S 2
+
+#define BLOCK_SIZE   CONFIG_APP_HISTORY_BLOCK_SIZE
+#define CHUNK_POINTS CONFIG_APP_HISTORY_CHUNK_POINTS
+
+/* "[1700000000.000,-180.0000000,-180.0000000,-1,255]," */
+#define CHUNK_POINT_MAX_LEN (1 + 14 + 1 + 12 + 1 + 12 + 1 + 6 + 1 + 3 + 2)
+
+struct history_block {
+	/* UTC time of the first and last point in the block */
+	int64_t first_ms;
+	int64_t last_ms;
+	uint16_t used;
+	/* Records of a length byte followed by the encoded point */
+	uint8_t data[BLOCK_SIZE];
+};
+
+struct history_tier {
+	struct history_block *blocks;
+	size_t n_blocks;
+	/* Ring of blocks in use, starting at the oldest */
+	size_t oldest;
+	size_t count;
+	/* Minimum time between two points, 0 to keep every point */
+	int64_t interval_ms;
+	/* Blocks older than this are dropped, 0 to keep them until the tier is full */
+	int64_t max_age_ms;
+	/* Last point added, the encoder state of the newest block */
+	struct track_point last;
+};
+
+static struct history_block full_blocks[CONFIG_APP_HISTORY_FULL_BLOCKS];
+static struct history_block downsampled_blocks[CONFIG_APP_HISTORY_DOWNSAMPLED_BLOCKS];
+static struct history_block summary_blocks[CONFIG_APP_HISTORY_SUMMARY_BLOCKS];
+
+/* Ordered from the finest to the coarsest resolution */
+static struct history_tier _tiers[] = {
+	{
+		.blocks = full_blocks,
+		.n_blocks = ARRAY_SIZE(full_blocks),
+		.interval_ms = 0,
+		.max_age_ms = CONFIG_APP_HISTORY_FULL_S * 1000LL,
+	},
+	{
+		.blocks = downsampled_blocks,
+		.n_blocks = ARRAY_SIZE(downsampled_blocks),
+		.interval_ms = CONFIG_APP_HISTORY_DOWNSAMPLED_INTERVAL_S * 1000LL,
+		.max_age_ms = CONFIG_APP_HISTORY_DOWNSAMPLED_S * 1000LL,
+	},
+	{
+		.blocks = summary_blocks,
+		.n_blocks = ARRAY_SIZE(summary_blocks),
+		.interval_ms = CONFIG_APP_HISTORY_SUMMARY_INTERVAL_S * 1000LL,
+		.max_age_ms = 0,
+	},
+};
+
+K_MUTEX_DEFINE(history_mutex);
+
+static struct {
+	bool active;
+	/* Incremented by every request, so a replaced request is not resumed */
+	uint32_t generation;
+	/* Earliest time of the next point to stream */
+	int64_t next_ms;
+	int64_t end_ms;
+	int64_t resolution_ms;
+	uint32_t seq;
+} _request;
+
+/* Only used by the thread calling track_history_stream() */
+static struct track_point _chunk_points[CHUNK_POINTS];
+static char _chunk_json[CHUNK_POINTS * CHUNK_POINT_MAX_LEN + 48];
+
+typedef bool (*history_point_cb)(const struct track_point *pt, void *arg);
+
+static struct history_block *tier_block(struct history_tier *tier, size_t i)
+{
+	return &tier->blocks[(tier->oldest + i) % tier->n_blocks];
+}
+
+static int64_t tier_oldest_ms(struct history_tier *tier)
+{
+	return tier->count ? tier_block(tier, 0)->first_ms : INT64_MAX;
+}
+
+static void tier_drop_oldest(struct history_tier *tier)
+{
+	tier->oldest = (tier->oldest + 1) % tier->n_blocks;
+	tier->count--;
+}
+
+static void tier_add(struct history_tier *tier, const struct track_point *pt)
+{
+	struct track_point zero = {0};
+	const struct track_point *prev = &tier->last;
+	struct history_block *block;
+	int len;
+
+	if (tier->count && ((pt->time_ms <= tier->last.time_ms) ||
+			    ((pt->time_ms - tier->last.time_ms) < tier->interval_ms))) {
+		return;
+	}
+
+	while (tier->count && tier->max_age_ms &&
+	       (tier_block(tier, 0)->last_ms < (pt->time_ms - tier->max_age_ms))) {
+		tier_drop_oldest(tier);
+	}
+
+	block = tier->count ? tier_block(tier, tier->count - 1) : NULL;
+	if (!block || ((block->used + 1 + TRACK_POINT_MAX_ENCODED_LEN) > BLOCK_SIZE)) {
+		if (tier->count == tier->n_blocks) {
+			tier_drop_oldest(tier);
+		}
+		tier->count++;
+		block = tier_block(tier, tier->count - 1);
+		block->first_ms = pt->time_ms;
+		block->used = 0;
+
+		/* Start every block from a key point, so blocks decode on their own */
+		prev = &zero;
+	}
+
+	len = track_codec_encode(prev, pt, &block->data[block->used + 1],
+				 BLOCK_SIZE - block->used - 1);
+	if (len < 0) {
+		LOG_ERR("Unable to encode history point: %d", len);
+		return;
+	}
+
+	block->data[block->used] = len;
+	block->used += len + 1;
+	block->last_ms = pt->time_ms;
+	tier->last = *pt;
+}
+
+/* Call cb for each point of the tier, oldest first, skipping blocks that end before from_ms */
+static void tier_foreach(struct history_tier *tier, int64_t from_ms, history_point_cb cb,
+			 void *arg)
+{
+	for (size_t i = 0; i < tier->count; i++) {
+		struct history_block *block = tier_block(tier, i);
+		struct track_point prev = {0};
+		struct track_point pt;
+		size_t off = 0;
+
+		if (block->last_ms < from_ms) {
+			continue;
+		}
+
+		while (off < block->used) {
+			uint8_t len = block->data[off];
+
+			if (track_codec_decode(&prev, &pt, &block->data[off + 1], len) < 0) {
+				LOG_ERR("Corrupt history block");
+				break;
+			}
+			if (!cb(&pt, arg)) {
+				return;
+			}
+
+			prev = pt;
+			off += len + 1;
+		}
+	}
+}
+
+struct collect_ctx {
+	int64_t next_ms;
+	int64_t end_ms;
+	int64_t resolution_ms;
+	/* Points from this time on are taken from a finer tier */
+	int64_t upper_ms;
+	/* Output array, NULL to only count points */
+	struct track_point *out;
+	size_t max;
+	size_t n;
+};
+
+static bool collect_cb(const struct track_point *pt, void *arg)
+{
+	struct collect_ctx *ctx = arg;
+
+	if ((pt->time_ms >= ctx->upper_ms) || (pt->time_ms > ctx->end_ms)) {
+		return false;
+	}
+
+	if (pt->time_ms < ctx->next_ms) {
+		return true;
+	}
+
+	if (ctx->out) {
+		ctx->out[ctx->n] = *pt;
+	}
+	ctx->n++;
+	ctx->next_ms = pt->time_ms + MAX(ctx->resolution_ms, 1);
+
+	return ctx->n < ctx->max;
+}
+
+/* Collect points in range using the finest tier covering each part of it. Call with the lock held. */
+static void collect(struct collect_ctx *ctx)
+{
+	for (int t = ARRAY_SIZE(_tiers) - 1; (t >= 0) && (ctx->n < ctx->max); t--) {
+		ctx->upper_ms = INT64_MAX;
+		for (int finer = 0; finer < t; finer++) {
+			ctx->upper_ms = MIN(ctx->upper_ms, tier_oldest_ms(&_tiers[finer]));
+		}
+
+		tier_foreach(&_tiers[t], ctx->next_ms, collect_cb, ctx);
+	}
+}
+
+void track_history_add(const struct track_point *pt)
+{
+	if ((pt->time_ms == 0) || (pt->flags & TRACK_POINT_FAKE)) {
+		return;
+	}
+
+	k_mutex_lock(&history_mutex, K_FOREVER);
+
+	for (size_t t = 0; t < ARRAY_SIZE(_tiers); t++) {
+		tier_add(&_tiers[t], pt);
+	}
+
+	k_mutex_unlock(&history_mutex);
+}
+
+int track_history_request(int64_t start_ms, int64_t end_ms, int64_t resolution_ms)
+{
+	struct collect_ctx ctx = {
+		.next_ms = start_ms,
+		.end_ms = end_ms,
+		.resolution_ms = resolution_ms,
+		.max = SIZE_MAX,
+	};
+
+	if ((end_ms < start_ms) || (resolution_ms < 0)) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&history_mutex, K_FOREVER);
+
+	collect(&ctx);
+
+	if (_request.active) {
+		LOG_WRN("Replacing history request still in progress");
+	}
+	_request.active = true;
+	_request.generation++;
+	_request.next_ms = start_ms;
+	_request.end_ms = end_ms;
+	_request.resolution_ms = resolution_ms;
+	_request.seq = 0;
+
+	k_mutex_unlock(&history_mutex);
+
+	LOG_INF("History request: %zu points", ctx.n);
+
+	return ctx.n;
+}
+
+static size_t format_chunk(size_t n, uint32_t seq, bool last)
+{
+	char lat_str[FORMAT_COORD_LEN];
+	char lon_str[FORMAT_COORD_LEN];
+	size_t pos;
+
+	pos = snprintk(_chunk_json, sizeof(_chunk_json), "{\"seq\":%u,\"last\":%s,\"points\":[",
+		       seq, last ? "true" : "false");
+
+	for (size_t i = 0; i < n; i++) {
+		const struct track_point *pt = &_chunk_points[i];
+
+		format_coord_e7(lat_str, sizeof(lat_str), pt->lat);
+		format_coord_e7(lon_str, sizeof(lon_str), pt->lon);
+		pos += snprintk(&_chunk_json[pos], sizeof(_chunk_json) - pos,
+				"%s[%u.%03u,%s,%s,%d,%u]", (i == 0) ? "" : ",",
+				(uint32_t)(pt->time_ms / 1000), (uint32_t)(pt->time_ms % 1000),
+				lat_str, lon_str, pt->speed, pt->flags);
+	}
+
+	pos += snprintk(&_chunk_json[pos], sizeof(_chunk_json) - pos, "]}");
+
+	return pos;
+}
+
+void track_history_stream(struct golioth_client *client)
+{
+	struct collect_ctx ctx;
+	uint32_t generation;
+	uint32_t seq;
+	size_t len;
+	bool last;
+	int err;
+
+	while (1) {
+		k_mutex_lock(&history_mutex, K_FOREVER);
+
+		if (!_request.active) {
+			k_mutex_unlock(&history_mutex);
+			return;
+		}
+
+		ctx = (struct collect_ctx){
+			.next_ms = _request.next_ms,
+			.end_ms = _request.end_ms,
+			.resolution_ms = _request.resolution_ms,
+			.out = _chunk_points,
+			.max = CHUNK_POINTS,
+		};
+		collect(&ctx);
+		generation = _request.generation;
+		seq = _request.seq;
+
+		k_mutex_unlock(&history_mutex);
+
+		last = ctx.n < CHUNK_POINTS;
+		len = format_chunk(ctx.n, seq, last);
+
+		err = golioth_stream_set_sync(client, TRACK_HISTORY_STREAM_ENDP,
+					      GOLIOTH_CONTENT_TYPE_JSON, _chunk_json, len,
+					      GOLIOTH_STREAM_TIMEOUT_S);
+		if (err) {
+			/* Retry from the same point on the next call */
+			LOG_ERR("Failed to send history chunk to Golioth: %d", err);
+			return;
+		}
+
+		k_mutex_lock(&history_mutex, K_FOREVER);
+		if (_request.generation == generation) {
+			_request.next_ms = ctx.next_ms;
+			_request.seq++;
+			_request.active = !last;
+		}
+		k_mutex_unlock(&history_mutex);
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __TRACK_HISTORY_H__
+#define __TRACK_HISTORY_H__
+
+/** Multi-resolution on-device track history.
+ *
+ * Every timestamped fix is kept in RAM in three tiers of decreasing resolution:
+ *
+ *  - full: every fix, for the last CONFIG_APP_HISTORY_FULL_S seconds
+ *  - downsampled: one fix every CONFIG_APP_HISTORY_DOWNSAMPLED_INTERVAL_S,
+ *    for the last CONFIG_APP_HISTORY_DOWNSAMPLED_S seconds
+ *  - summary: one fix every CONFIG_APP_HISTORY_SUMMARY_INTERVAL_S, for as
+ *    long as it fits
+ *
+ * Each tier is a ring of fixed-size blocks of delta-encoded points (see
+ * track_codec.h). The first point of each block is encoded against a zeroed
+ * point, so the oldest block can be dropped without decoding the rest.
+ *
+ * A range query streams the matching points to the "history" LightDB Stream
+ * endpoint in chunks, using the finest tier available for each part of the
+ * range.
+ */
+
+#include <stdint.h>
+#include <golioth/client.h>
+#include "track_codec.h"
+
+#define TRACK_HISTORY_STREAM_ENDP "history"
+
+/** Record a fix. Fake points and points without a UTC timestamp are ignored. */
+void track_history_add(const struct track_point *pt);
+
+/**
+ * Request points in a time range to be streamed by track_history_stream().
+ *
+ * Replaces any request still being streamed.
+ *
+ * @param start_ms start of the range, UTC milliseconds since the Unix epoch
+ * @param end_ms end of the range (inclusive)
+ * @param resolution_ms minimum time between two returned points, 0 for all
+ *
+ * @return number of points that will be streamed, or -EINVAL for an empty range
+ */
+int track_history_request(int64_t start_ms, int64_t end_ms, int64_t resolution_ms);
+
+/** Stream the points of a pending request, if any. */
+void track_history_stream(struct golioth_client *client);
+
+#endif /* __TRACK_HISTORY_H__ */
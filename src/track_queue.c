@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include "track_queue.h"
+
+/* Each record is stored as a length byte followed by the encoded point */
+RING_BUF_DECLARE(track_ring, CONFIG_APP_TRACK_QUEUE_SIZE);
+K_MUTEX_DEFINE(track_ring_mutex);
+
+/* Encoder and decoder state, see track_codec.h */
+static struct track_point _last_put;
+static struct track_point _last_get;
+
+int track_queue_put(const struct track_point *pt)
+{
+	uint8_t buf[1 + TRACK_POINT_MAX_ENCODED_LEN];
+	int len;
+	int err = 0;
+
+	k_mutex_lock(&track_ring_mutex, K_FOREVER);
+
+	len = track_codec_encode(&_last_put, pt, &buf[1], sizeof(buf) - 1);
+	if (len < 0) {
+		err = len;
+		goto unlock;
+	}
+	buf[0] = len;
+
+	if (ring_buf_space_get(&track_ring) < (len + 1)) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	ring_buf_put(&track_ring, buf, len + 1);
+	_last_put = *pt;
+
+unlock:
+	k_mutex_unlock(&track_ring_mutex);
+	return err;
+}
+
+int track_queue_get(struct track_point *pt)
+{
+	uint8_t buf[TRACK_POINT_MAX_ENCODED_LEN];
+	uint8_t len;
+	int ret;
+	int err = 0;
+
+	k_mutex_lock(&track_ring_mutex, K_FOREVER);
+
+	if (ring_buf_get(&track_ring, &len, 1) != 1) {
+		err = -EAGAIN;
+		goto unlock;
+	}
+
+	ring_buf_get(&track_ring, buf, len);
+
+	ret = track_codec_decode(&_last_get, pt, buf, len);
+	if (ret < 0) {
+		/* Should never happen; resync by dropping everything */
+		ring_buf_reset(&track_ring);
+		_last_put = (struct track_point){0};
+		_last_get = (struct track_point){0};
+		err = ret;
+		goto unlock;
+	}
+
+	_last_get = *pt;
+
+unlock:
+	k_mutex_unlock(&track_ring_mutex);
+	return err;
+}
+
+size_t track_queue_used(void)
+{
+	return ring_buf_size_get(&track_ring);
+}
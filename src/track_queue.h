@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __TRACK_QUEUE_H__
+#define __TRACK_QUEUE_H__
+
+/** FIFO of track points waiting to be uploaded to Golioth.
+ *
+ * Points are stored delta-encoded (see track_codec.h) in a byte ring buffer of
+ * CONFIG_APP_TRACK_QUEUE_SIZE bytes, so several times more points fit in RAM
+ * while the device is out of cellular coverage than with a struct queue.
+ */
+
+#include <stddef.h>
+#include "track_codec.h"
+
+/**
+ * Append a point to the queue.
+ *
+ * @return 0 on success, -ENOMEM if the queue is full (the point is dropped)
+ */
+int track_queue_put(const struct track_point *pt);
+
+/**
+ * Remove the oldest point from the queue.
+ *
+ * @return 0 on success, -EAGAIN if the queue is empty
+ */
+int track_queue_get(struct track_point *pt);
+
+/** Number of bytes currently used in the queue. */
+size_t track_queue_used(void);
+
+#endif /* __TRACK_QUEUE_H__ */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(track_simplify, LOG_LEVEL_DBG);
+
+#include <stdbool.h>
+#include <zephyr/kernel.h>
+
+#include "geo_helper.h"
+#include "track_simplify.h"
+
+#define WINDOW_SIZE  CONFIG_APP_TRACK_SIMPLIFY_WINDOW
+#define MAX_DELAY_MS ((int64_t)CONFIG_APP_TRACK_SIMPLIFY_MAX_DELAY_S * MSEC_PER_SEC)
+
+static struct track_point _anchor;
+static bool _has_anchor;
+
+/* Points received since the anchor; the last one is the "floater" */
+static struct track_point _window[WINDOW_SIZE];
+static size_t _window_len;
+/* Uptime when the first point of the window was received */
+static int64_t _window_start_ms;
+
+static bool window_fits(const struct track_point *pt, float max_error_m)
+{
+	for (size_t i = 0; i < _window_len; i++) {
+		float err = geo_segment_distance_m(_anchor.lat, _anchor.lon, pt->lat, pt->lon,
+						   _window[i].lat, _window[i].lon);
+		if (err > max_error_m) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool window_expired(int64_t now_ms)
+{
+	return (_window_len > 0) && ((now_ms - _window_start_ms) >= MAX_DELAY_MS);
+}
+
+static void window_restart(const struct track_point *pt, int64_t now_ms)
+{
+	_window[0] = *pt;
+	_window_len = 1;
+	_window_start_ms = now_ms;
+}
+
+/* Retain the floater, make it the new anchor and restart the window at pt */
+static void retain_floater(const struct track_point *pt, int64_t now_ms, struct track_point *out)
+{
+	*out = _window[_window_len - 1];
+	_anchor = *out;
+
+	window_restart(pt, now_ms);
+}
+
+/* Retain the floater, if any, and empty the window */
+static int flush_floater(struct track_point *out)
+{
+	if (_window_len == 0) {
+		return 0;
+	}
+
+	*out = _window[_window_len - 1];
+	_anchor = *out;
+	_window_len = 0;
+
+	return 1;
+}
+
+int track_simplify_push(const struct track_point *pt, int32_t max_error_m, int64_t now_ms,
+			bool keep, struct track_point out[2])
+{
+	if (!_has_anchor) {
+		/* The first point is always retained */
+		_anchor = *pt;
+		_has_anchor = true;
+		out[0] = *pt;
+		return 1;
+	}
+
+	if (keep || (max_error_m == 0)) {
+		/* Flush anything pending and pass the point through */
+		int count = flush_floater(&out[0]);
+
+		out[count++] = *pt;
+		_anchor = *pt;
+
+		return count;
+	}
+
+	if (_window_len == 0) {
+		window_restart(pt, now_ms);
+		return 0;
+	}
+
+	/* Never simplify across a switch between real and fake positions */
+	if ((pt->flags != _window[_window_len - 1].flags) || (_window_len == WINDOW_SIZE) ||
+	    window_expired(now_ms) || !window_fits(pt, (float)max_error_m)) {
+		retain_floater(pt, now_ms, &out[0]);
+		return 1;
+	}
+
+	_window[_window_len++] = *pt;
+
+	return 0;
+}
+
+int track_simplify_poll(int64_t now_ms, struct track_point *out)
+{
+	if (!window_expired(now_ms)) {
+		return 0;
+	}
+
+	return flush_floater(out);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __TRACK_SIMPLIFY_H__
+#define __TRACK_SIMPLIFY_H__
+
+/** Streaming track simplification with a bounded cross-track error.
+ *
+ * Implements the opening-window algorithm: starting from the last retained
+ * point (the anchor), incoming points are collected as long as every collected
+ * point lies within the maximum error (the `TRACK_MAX_ERROR_M` setting) of the
+ * segment from the anchor to the newest point. When a point breaks that bound,
+ * the point before it is retained and becomes the new anchor.
+ *
+ * Every discarded point is therefore guaranteed to lie within the configured
+ * error of the uploaded polyline. Only fixes reported by the report policy are
+ * pushed, the fixes it skips are only bounded by REPORT_DISTANCE_M from a
+ * pushed one (see report_policy.h). The window holds at most
+ * CONFIG_APP_TRACK_SIMPLIFY_WINDOW points; a full window forces a point to be
+ * retained, which bounds memory. Points are never held back for more than
+ * CONFIG_APP_TRACK_SIMPLIFY_MAX_DELAY_S either: track_simplify_poll() releases a
+ * pending point once that time has passed, even if no new point arrives.
+ *
+ * Points that must be uploaded (e.g. the `REPORT_MAX_INTERVAL_S` heartbeat) are
+ * pushed with `keep` set, which retains them without simplification.
+ *
+ * A maximum error of 0 disables simplification.
+ */
+
+#include <stdbool.h>
+#include "track_codec.h"
+
+/**
+ * Feed a point to the simplifier.
+ *
+ * @param pt new point
+ * @param max_error_m maximum distance of a dropped point from the track, in meters
+ * @param now_ms current uptime in milliseconds
+ * @param keep always retain @p pt
+ * @param out retained points, in order, ready for upload
+ *
+ * @return number of points written to @p out (0, 1 or 2)
+ */
+int track_simplify_push(const struct track_point *pt, int32_t max_error_m, int64_t now_ms,
+			bool keep, struct track_point out[2]);
+
+/**
+ * Release the pending point if it has been held back for too long.
+ *
+ * Called for every fix, including the ones not pushed to the simplifier.
+ *
+ * @param now_ms current uptime in milliseconds
+ * @param out retained point, ready for upload
+ *
+ * @return number of points written to @p out (0 or 1)
+ */
+int track_simplify_poll(int64_t now_ms, struct track_point *out);
+
+#endif /* __TRACK_SIMPLIFY_H__ */
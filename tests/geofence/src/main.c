@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <zcbor_encode.h>
+#include <zephyr/ztest.h>
+
+#include "geo_helper.h"
+#include "geofence.h"
+
+/* Depots on a square grid, about 2.2 km apart */
+#define DEPOT_LAT0	  45.0
+#define DEPOT_LON0	  -122.0
+#define DEPOT_SPACING_DEG 0.02
+#define DEPOT_RADIUS_M	  300
+#define DEPOT_HALF_DEG	  0.002
+
+#define TIMED_FIXES 1024
+#define TIMED_RUNS  5
+
+static uint8_t payload[128 * 1024];
+static size_t payload_len;
+
+static int enter_count;
+static int exit_count;
+static int32_t last_id;
+
+static void on_event(int32_t id, bool enter, const struct track_point *pt)
+{
+	if (enter) {
+		enter_count++;
+	} else {
+		exit_count++;
+	}
+	last_id = id;
+}
+
+static struct track_point point_deg(double lat, double lon)
+{
+	return (struct track_point){
+		.lat = (int32_t)llround(lat * GEO_E7_PER_DEG),
+		.lon = (int32_t)llround(lon * GEO_E7_PER_DEG),
+	};
+}
+
+static void evaluate(double lat, double lon)
+{
+	struct track_point pt = point_deg(lat, lon);
+
+	geofence_evaluate(&pt, on_event);
+}
+
+static bool encode_depot(zcbor_state_t *zse, int side, int i)
+{
+	double lat = DEPOT_LAT0 + (i / side) * DEPOT_SPACING_DEG;
+	double lon = DEPOT_LON0 + (i % side) * DEPOT_SPACING_DEG;
+	bool ok = zcbor_map_start_encode(zse, 4) && zcbor_tstr_put_lit(zse, "id") &&
+		  zcbor_int32_put(zse, i + 1);
+
+	/* Alternate circles and square polygons */
+	if ((i % 2) == 0) {
+		return ok && zcbor_tstr_put_lit(zse, "lat") && zcbor_float64_put(zse, lat) &&
+		       zcbor_tstr_put_lit(zse, "lon") && zcbor_float64_put(zse, lon) &&
+		       zcbor_tstr_put_lit(zse, "radius") && zcbor_uint32_put(zse, DEPOT_RADIUS_M) &&
+		       zcbor_map_end_encode(zse, 4);
+	}
+
+	ok = ok && zcbor_tstr_put_lit(zse, "poly") && zcbor_list_start_encode(zse, 4);
+	for (int v = 0; v < 4; v++) {
+		double dlat = (v < 2) ? -DEPOT_HALF_DEG : DEPOT_HALF_DEG;
+		double dlon = ((v == 0) || (v == 3)) ? -DEPOT_HALF_DEG : DEPOT_HALF_DEG;
+
+		ok = ok && zcbor_list_start_encode(zse, 2) && zcbor_float64_put(zse, lat + dlat) &&
+		     zcbor_float64_put(zse, lon + dlon) && zcbor_list_end_encode(zse, 2);
+	}
+
+	return ok && zcbor_list_end_encode(zse, 4) && zcbor_map_end_encode(zse, 4);
+}
+
+/* side x side depots */
+static void encode_depots(int side)
+{
+	ZCBOR_STATE_E(zse, 6, payload, sizeof(payload), 1);
+	bool ok = zcbor_map_start_encode(zse, 2) && zcbor_tstr_put_lit(zse, "version") &&
+		  zcbor_int32_put(zse, side) && zcbor_tstr_put_lit(zse, "fences") &&
+		  zcbor_list_start_encode(zse, side * side);
+
+	for (int i = 0; ok && (i < side * side); i++) {
+		ok = encode_depot(zse, side, i);
+	}
+
+	ok = ok && zcbor_list_end_encode(zse, side * side) && zcbor_map_end_encode(zse, 2);
+	zassert_true(ok, "Unable to encode %d geofences", side * side);
+
+	payload_len = zse->payload - payload;
+}
+
+/* A single circle */
+static void encode_circle(double lat, double lon, double radius_m)
+{
+	ZCBOR_STATE_E(zse, 4, payload, sizeof(payload), 1);
+	bool ok = zcbor_map_start_encode(zse, 1) && zcbor_tstr_put_lit(zse, "fences") &&
+		  zcbor_list_start_encode(zse, 1) && zcbor_map_start_encode(zse, 4) &&
+		  zcbor_tstr_put_lit(zse, "id") && zcbor_int32_put(zse, 7) &&
+		  zcbor_tstr_put_lit(zse, "lat") && zcbor_float64_put(zse, lat) &&
+		  zcbor_tstr_put_lit(zse, "lon") && zcbor_float64_put(zse, lon) &&
+		  zcbor_tstr_put_lit(zse, "radius") && zcbor_float64_put(zse, radius_m) &&
+		  zcbor_map_end_encode(zse, 4) && zcbor_list_end_encode(zse, 1) &&
+		  zcbor_map_end_encode(zse, 1);
+
+	zassert_true(ok, "Unable to encode geofence");
+
+	payload_len = zse->payload - payload;
+}
+
+/* Best of TIMED_RUNS, in host nanoseconds per fix spread over the depots */
+static uint32_t time_evaluate(int side)
+{
+	double extent = side * DEPOT_SPACING_DEG;
+	uint64_t best = UINT64_MAX;
+	struct timespec start;
+	struct timespec end;
+
+	for (int run = 0; run < TIMED_RUNS; run++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int i = 0; i < TIMED_FIXES; i++) {
+			/* Low-discrepancy sequence, so that every size is sampled alike */
+			double u = fmod(i * 0.6180339887, 1.0);
+			double v = fmod(i * 0.7548776662, 1.0);
+
+			evaluate(DEPOT_LAT0 + u * extent, DEPOT_LON0 + v * extent);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		best = MIN(best, (uint64_t)((end.tv_sec - start.tv_sec) * NSEC_PER_SEC +
+					    (end.tv_nsec - start.tv_nsec)));
+	}
+
+	return (uint32_t)(best / TIMED_FIXES);
+}
+
+static void geofence_before(void *fixture)
+{
+	geofence_clear();
+
+	/* Leave whatever the previous test entered */
+	evaluate(0.0, 0.0);
+	enter_count = 0;
+	exit_count = 0;
+	last_id = 0;
+}
+
+ZTEST(geofence, test_enter_exit)
+{
+	encode_depots(4);
+	zassert_ok(geofence_load(payload, payload_len));
+
+	/* Circle, then polygon */
+	evaluate(DEPOT_LAT0, DEPOT_LON0);
+	zassert_equal(enter_count, 1);
+	zassert_equal(last_id, 1);
+
+	evaluate(DEPOT_LAT0, DEPOT_LON0 + DEPOT_SPACING_DEG);
+	zassert_equal(exit_count, 1);
+	zassert_equal(enter_count, 2);
+	zassert_equal(last_id, 2);
+
+	/* Between depots */
+	evaluate(DEPOT_LAT0 + DEPOT_SPACING_DEG / 2, DEPOT_LON0 + DEPOT_SPACING_DEG / 2);
+	zassert_equal(exit_count, 2);
+	zassert_equal(enter_count, 2);
+}
+
+ZTEST(geofence, test_radius_range)
+{
+	encode_circle(45.0, -122.0, GEOFENCE_MAX_RADIUS_M + 1);
+	zassert_equal(geofence_load(payload, payload_len), -EINVAL);
+
+	encode_circle(45.0, -122.0, 1e12);
+	zassert_equal(geofence_load(payload, payload_len), -EINVAL);
+
+	encode_circle(45.0, -122.0, NAN);
+	zassert_equal(geofence_load(payload, payload_len), -EINVAL);
+
+	encode_circle(45.0, -122.0, 0.5);
+	zassert_equal(geofence_load(payload, payload_len), -EINVAL);
+
+	/* The largest circle, near a pole, still has a valid bounding box */
+	encode_circle(89.0, 179.0, GEOFENCE_MAX_RADIUS_M);
+	zassert_ok(geofence_load(payload, payload_len));
+
+	evaluate(85.0, 179.0);
+	zassert_equal(enter_count, 1);
+	zassert_equal(last_id, 7);
+}
+
+ZTEST(geofence, test_invalid_document_disables_all)
+{
+	encode_depots(4);
+	zassert_ok(geofence_load(payload, payload_len));
+
+	encode_circle(45.0, -122.0, GEOFENCE_MAX_RADIUS_M * 2.0);
+	zassert_not_equal(geofence_load(payload, payload_len), 0);
+
+	evaluate(DEPOT_LAT0, DEPOT_LON0);
+	zassert_equal(enter_count, 0);
+}
+
+ZTEST(geofence, test_evaluate_time_1k)
+{
+	static const int sides[] = {4, 16, 32};
+	uint32_t ns_per_fix[ARRAY_SIZE(sides)];
+
+	for (size_t i = 0; i < ARRAY_SIZE(sides); i++) {
+		encode_depots(sides[i]);
+		zassert_ok(geofence_load(payload, payload_len), "Unable to load %d geofences",
+			   sides[i] * sides[i]);
+
+		ns_per_fix[i] = time_evaluate(sides[i]);
+
+		TC_PRINT("%4d geofences: %u ns per fix\n", sides[i] * sides[i], ns_per_fix[i]);
+	}
+
+	/* At the same density, 64 times more geofences barely cost more per fix */
+	zassert_true(ns_per_fix[2] <= (4 * ns_per_fix[0]) + 200,
+		     "Evaluation grows with the number of geofences: %u ns vs %u ns",
+		     ns_per_fix[2], ns_per_fix[0]);
+}
+
+ZTEST_SUITE(geofence, NULL, NULL, geofence_before, NULL, NULL);
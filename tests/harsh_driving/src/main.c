@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#include "app_events.h"
+#include "app_settings.h"
+#include "harsh_driving.h"
+
+#define ACCEL_MG	300
+#define BRAKE_MG	400
+/* Polling period while parked, as VEHICLE_SPEED_DELAY_S */
+#define SLOW_POLL_MS	5000
+/* Latest time an event may be posted after its trigger */
+#define MAX_POST_MS                                                                                \
+	(CONFIG_APP_HARSH_POST_SAMPLES * CONFIG_APP_HARSH_POLL_MS + CONFIG_APP_HARSH_WINDOW_MS)
+
+/* Uptime of the samples, never goes backwards across tests */
+static int64_t now_ms;
+
+static int event_count;
+static int64_t event_uptime_ms;
+static int64_t event_posted_ms;
+static char event_body[512];
+
+int32_t get_harsh_accel_mg(void)
+{
+	return ACCEL_MG;
+}
+
+int32_t get_harsh_brake_mg(void)
+{
+	return BRAKE_MG;
+}
+
+int app_events_post(const char *type, int64_t uptime_ms, bool urgent, const char *fmt, ...)
+{
+	va_list args;
+
+	zassert_str_equal(type, "harsh");
+	zassert_true(urgent);
+
+	va_start(args, fmt);
+	vsnprintk(event_body, sizeof(event_body), fmt, args);
+	va_end(args);
+
+	event_count++;
+	event_uptime_ms = uptime_ms;
+	event_posted_ms = now_ms;
+
+	return 0;
+}
+
+/* Feed a sample, then wait for the next one as the CAN thread does */
+static void sample(int speed)
+{
+	harsh_driving_sample(now_ms, speed);
+
+	if ((speed > 0) || harsh_driving_busy()) {
+		now_ms += CONFIG_APP_HARSH_POLL_MS;
+	} else {
+		now_ms += SLOW_POLL_MS;
+	}
+}
+
+static void harsh_driving_before(void *fixture)
+{
+	/* Drop whatever the previous test left in the window */
+	harsh_driving_sample(now_ms, -1);
+	now_ms += SLOW_POLL_MS;
+	event_count = 0;
+	event_body[0] = '\0';
+}
+
+ZTEST(harsh_driving, test_brake_to_standstill)
+{
+	/* Cruise at 50 km/h, then brake at 30 km/h/s (850 mg) down to a stop */
+	for (int i = 0; i < 10; i++) {
+		sample(50);
+	}
+	for (int speed = 44; speed > 0; speed -= 6) {
+		sample(speed);
+	}
+	for (int i = 0; (i < 20) && (event_count == 0); i++) {
+		sample(0);
+	}
+
+	zassert_equal(event_count, 1);
+	zassert_not_null(strstr(event_body, "\"type\":\"brake\""), "%s", event_body);
+	zassert_true(event_posted_ms - event_uptime_ms <= MAX_POST_MS,
+		     "Posted %d ms after the trigger",
+		     (int)(event_posted_ms - event_uptime_ms));
+
+	/* Back to slow polling once parked for a window */
+	for (int i = 0; i < 10; i++) {
+		sample(0);
+	}
+	zassert_false(harsh_driving_busy());
+	zassert_equal(event_count, 1);
+}
+
+ZTEST(harsh_driving, test_sparse_post_samples)
+{
+	/* Brake at 30 km/h/s from 50 to 20 km/h, then slow down the polling */
+	for (int i = 0; i < 10; i++) {
+		sample(50);
+	}
+	for (int speed = 44; speed >= 20; speed -= 6) {
+		sample(speed);
+	}
+	zassert_equal(event_count, 0);
+
+	/* Too far apart to fit a slope, but close enough not to be a gap */
+	for (int i = 0; i < 4; i++) {
+		harsh_driving_sample(now_ms, 20);
+		now_ms += 1500;
+	}
+
+	zassert_equal(event_count, 1);
+	zassert_not_null(strstr(event_body, "\"type\":\"brake\""), "%s", event_body);
+	zassert_true(event_posted_ms - event_uptime_ms <= MAX_POST_MS + 1500,
+		     "Posted %d ms after the trigger",
+		     (int)(event_posted_ms - event_uptime_ms));
+}
+
+ZTEST_SUITE(harsh_driving, NULL, NULL, harsh_driving_before, NULL, NULL);
@@ -0,0 +1,8 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Only the client handle is referenced by the application headers */
+struct golioth_client;
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <zephyr/timing/timing.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_ARCH_POSIX
+#include <time.h>
+#endif
+
+#include "battery_monitor/battery_level.h"
+#include "fix_window.h"
+#include "format_helper.h"
+#include "geo_helper.h"
+#include "json_helper.h"
+#include "track_codec.h"
+#include "lib/minmea/minmea.h"
+
+#define BENCH_ITERATIONS 1000
+
+/* A vehicle in Portland, OR, as received from the GNSS receiver */
+#define RMC_SENTENCE "$GPRMC,173125.00,A,4530.9146,N,12240.8138,W,26.99,90.0,150524,,,A*7A\r\n"
+#define DESIRED_JSON "{\"example_int0\":1234,\"example_int1\":-1}"
+
+/* Results of the last run, also keep the compiler from optimizing the runs away */
+static volatile bool _ok;
+static struct minmea_sentence_rmc _rmc;
+static struct minmea_float _minmea[2];
+static struct geo_fix _fix;
+static char _json[FORMAT_TRACK_POINT_LEN];
+static uint8_t _encoded[TRACK_POINT_MAX_ENCODED_LEN];
+static struct track_point _decoded;
+static struct app_state _state;
+static volatile float _distance;
+static volatile unsigned int _level_pptt;
+
+static const struct track_point _prev_point = {
+	.time_ms = 1715794284000LL,
+	.lat = 455152410,
+	.lon = -1226802301,
+	.speed = 49,
+	.seq = 41,
+};
+static const struct track_point _point = {
+	.time_ms = 1715794285000LL,
+	.lat = 455152435,
+	.lon = -1226801230,
+	.speed = 50,
+	.seq = 42,
+};
+
+/* The Aludel-mini discharge curve of battery.c */
+static const struct battery_level_point _batt_levels[] = {
+	{10000, 3950},
+	{625, 3550},
+	{0, 3100},
+};
+
+static void run_nmea_parse_rmc(void)
+{
+	/* What process_reading() does with every line from the GNSS UART */
+	_ok = (minmea_sentence_id(RMC_SENTENCE, false) == MINMEA_SENTENCE_RMC) &&
+	      minmea_parse_rmc(&_rmc, RMC_SENTENCE);
+}
+
+static void run_geo_fix_from_rmc(void)
+{
+	_ok = (geo_fix_from_rmc(&_fix, &_rmc) == 0);
+}
+
+static void run_geo_coord_to_minmea(void)
+{
+	_ok = (geo_coord_to_minmea(&_minmea[0], 45.5152435f) == 0) &&
+	      (geo_coord_to_minmea(&_minmea[1], -122.6802301f) == 0);
+}
+
+static void run_format_track_point_json(void)
+{
+	_ok = (format_track_point_json(_json, sizeof(_json), &_point) < sizeof(_json));
+}
+
+static void run_track_codec_encode(void)
+{
+	_ok = (track_codec_encode(&_prev_point, &_point, _encoded, sizeof(_encoded)) > 0);
+}
+
+static void run_track_codec_decode(void)
+{
+	_ok = (track_codec_decode(&_prev_point, &_decoded, _encoded, sizeof(_encoded)) > 0);
+}
+
+static void run_geo_distance_m(void)
+{
+	_distance = geo_distance_m(_prev_point.lat, _prev_point.lon, _point.lat, _point.lon);
+}
+
+static void run_app_state_parse(void)
+{
+	/* json_obj_parse() modifies the payload, as app_state_desired_handler() gets it */
+	char payload[] = DESIRED_JSON;
+
+	_ok = (json_obj_parse(payload, sizeof(payload) - 1, app_state_descr,
+			      ARRAY_SIZE(app_state_descr), &_state) == 0x3);
+}
+
+static void run_battery_level_pptt(void)
+{
+	_level_pptt = battery_level_pptt(3750, _batt_levels);
+}
+
+/*
+ * Print the cost per call of a kernel whose result was checked, as a BENCH line
+ * for scripts/kernel_bench.py. Counted in cycles where the timing functions are
+ * repeatable, in host nanoseconds on native_sim, where simulated time stands
+ * still while code runs.
+ */
+static void bench(const char *name, void (*run)(void))
+{
+#ifdef CONFIG_ARCH_POSIX
+	struct timespec start;
+	struct timespec end;
+	uint64_t ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		run();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ns = (end.tv_sec - start.tv_sec) * NSEC_PER_SEC + (end.tv_nsec - start.tv_nsec);
+
+	TC_PRINT("BENCH {\"board\":\"%s\",\"kernel\":\"%s\",\"iterations\":%d,"
+		 "\"cycles_per_call\":null,\"ns_per_call\":%u}\n",
+		 CONFIG_BOARD, name, BENCH_ITERATIONS, (uint32_t)(ns / BENCH_ITERATIONS));
+#else
+	timing_t start;
+	timing_t end;
+	uint64_t cycles;
+
+	start = timing_counter_get();
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		run();
+	}
+	end = timing_counter_get();
+	cycles = timing_cycles_get(&start, &end);
+
+	TC_PRINT("BENCH {\"board\":\"%s\",\"kernel\":\"%s\",\"iterations\":%d,"
+		 "\"cycles_per_call\":%u,\"ns_per_call\":%u}\n",
+		 CONFIG_BOARD, name, BENCH_ITERATIONS, (uint32_t)(cycles / BENCH_ITERATIONS),
+		 (uint32_t)(timing_cycles_to_ns(cycles) / BENCH_ITERATIONS));
+#endif
+}
+
+ZTEST(kernels, test_nmea_parse_rmc)
+{
+	run_nmea_parse_rmc();
+	zassert_true(_ok);
+	zassert_true(_rmc.valid);
+	zassert_equal(_rmc.latitude.value, 45309146);
+	zassert_equal(_rmc.latitude.scale, 10000);
+
+	bench("nmea_parse_rmc", run_nmea_parse_rmc);
+}
+
+ZTEST(kernels, test_geo_fix_from_rmc)
+{
+	run_nmea_parse_rmc();
+	run_geo_fix_from_rmc();
+	zassert_true(_ok);
+	zassert_equal(_fix.lat, 455152433);
+	zassert_equal(_fix.lon, -1226802300);
+
+	bench("geo_fix_from_rmc", run_geo_fix_from_rmc);
+}
+
+ZTEST(kernels, test_geo_coord_to_minmea)
+{
+	struct minmea_float f;
+
+	/* Rounded to the nearest 1e-5 minute, not to the precision of a float */
+	run_geo_coord_to_minmea();
+	zassert_true(_ok);
+	zassert_equal(_minmea[0].value, 453091461);
+	zassert_equal(_minmea[0].scale, GEO_MINMEA_SCALE);
+
+	/* The extremes fit in int32_t, anything beyond is rejected */
+	zassert_ok(geo_coord_to_minmea(&f, 180.0f));
+	zassert_equal(f.value, 1800000000);
+	zassert_ok(geo_coord_to_minmea(&f, -180.0f));
+	zassert_equal(f.value, -1800000000);
+	zassert_equal(geo_coord_to_minmea(&f, 180.1f), -ERANGE);
+	zassert_equal(geo_coord_to_minmea(&f, -1000.0f), -ERANGE);
+	zassert_equal(geo_coord_to_minmea(&f, NAN), -ERANGE);
+
+	bench("geo_coord_to_minmea", run_geo_coord_to_minmea);
+}
+
+ZTEST(kernels, test_geo_distance_m)
+{
+	/* 0.28 m north, 8.35 m east */
+	run_geo_distance_m();
+	zassert_within(_distance, 8.35f, 0.35f);
+
+	bench("geo_distance_m", run_geo_distance_m);
+}
+
+ZTEST(kernels, test_track_codec)
+{
+	run_track_codec_encode();
+	zassert_true(_ok);
+	run_track_codec_decode();
+	zassert_true(_ok);
+	zassert_equal(_decoded.time_ms, _point.time_ms);
+	zassert_equal(_decoded.lat, _point.lat);
+	zassert_equal(_decoded.lon, _point.lon);
+	zassert_equal(_decoded.speed, _point.speed);
+	zassert_equal(_decoded.flags, _point.flags);
+	zassert_equal(_decoded.seq, _point.seq);
+
+	bench("track_codec_encode", run_track_codec_encode);
+	bench("track_codec_decode", run_track_codec_decode);
+}
+
+ZTEST(kernels, test_format_track_point_json)
+{
+	run_format_track_point_json();
+	zassert_true(_ok);
+	zassert_equal(strcmp(_json, "{\"time\":\"2024-05-15T17:31:25.000Z\",\"seq\":42,"
+				    "\"gps\":{\"lat\":45.5152435,\"lon\":-122.6801230,"
+				    "\"fake\":false,\"estimated\":false},"
+				    "\"vehicle\":{\"speed\":50}}"),
+		      0, "%s", _json);
+
+	bench("format_track_point_json", run_format_track_point_json);
+}
+
+ZTEST(kernels, test_app_state_parse)
+{
+	run_app_state_parse();
+	zassert_true(_ok);
+	zassert_equal(_state.example_int0, 1234);
+	zassert_equal(_state.example_int1, -1);
+
+	bench("app_state_parse", run_app_state_parse);
+}
+
+ZTEST(kernels, test_battery_level_pptt)
+{
+	unsigned int prev = 10000;
+	unsigned int level;
+
+	/* Capped at both ends of the curve */
+	zassert_equal(battery_level_pptt(4200, _batt_levels), 10000);
+	zassert_equal(battery_level_pptt(3950, _batt_levels), 10000);
+	zassert_equal(battery_level_pptt(3100, _batt_levels), 0);
+	zassert_equal(battery_level_pptt(2500, _batt_levels), 0);
+	zassert_equal(battery_level_pptt(0, _batt_levels), 0);
+
+	/* On the points, and linear between them */
+	zassert_equal(battery_level_pptt(3550, _batt_levels), 625);
+	zassert_equal(battery_level_pptt(3750, _batt_levels), 625 + (10000 - 625) / 2);
+	zassert_equal(battery_level_pptt(3325, _batt_levels), 625 / 2);
+
+	for (unsigned int mv = 4000; mv >= 3000; mv--) {
+		level = battery_level_pptt(mv, _batt_levels);
+		zassert_true(level <= prev, "Level rises from %u to %u at %u mV", prev, level, mv);
+		prev = level;
+	}
+
+	bench("battery_level_pptt", run_battery_level_pptt);
+}
+
+ZTEST(kernels, test_fix_window)
+{
+	int64_t last_ms = 0;
+	int taken = 0;
+
+	/* One sentence a second, one taken every 5 s. The first window starts at boot. */
+	for (int64_t now_ms = 1000; now_ms <= 30000; now_ms += 1000) {
+		taken += fix_window_take(&last_ms, now_ms, 5000, false) ? 1 : 0;
+	}
+	zassert_equal(taken, 6);
+	zassert_equal(last_ms, 30000);
+
+	/* Taken once the window has fully passed */
+	zassert_false(fix_window_take(&last_ms, 34999, 5000, false));
+	zassert_equal(last_ms, 30000);
+	zassert_true(fix_window_take(&last_ms, 35000, 5000, false));
+	zassert_equal(last_ms, 35000);
+
+	/* Taken regardless of the window, which then starts from there */
+	zassert_true(fix_window_take(&last_ms, 35001, 5000, true));
+	zassert_false(fix_window_take(&last_ms, 36000, 5000, false));
+
+	/* Starting the window over takes the next sentence */
+	last_ms = 0;
+	zassert_true(fix_window_take(&last_ms, 36500, 5000, false));
+
+	/* Without a window, every sentence is taken */
+	zassert_true(fix_window_take(&last_ms, 36500, 0, false));
+	zassert_true(fix_window_take(&last_ms, 36500, 0, false));
+}
+
+static void *kernels_setup(void)
+{
+	timing_init();
+	timing_start();
+
+	return NULL;
+}
+
+static void kernels_teardown(void *fixture)
+{
+	timing_stop();
+}
+
+ZTEST_SUITE(kernels, NULL, kernels_setup, NULL, NULL, kernels_teardown);
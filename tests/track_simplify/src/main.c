@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <zephyr/ztest.h>
+
+#include "geo_helper.h"
+#include "report_policy.h"
+#include "track_simplify.h"
+
+#define FIX_INTERVAL_MS 1000
+#define MAX_DELAY_MS    (CONFIG_APP_TRACK_SIMPLIFY_MAX_DELAY_S * MSEC_PER_SEC)
+#define MAX_FIXES       512
+
+static const uint8_t nmea[] = {
+#include "drive_nmea.inc"
+};
+
+static struct track_point fixes[MAX_FIXES];
+static struct geo_fix geo_fixes[MAX_FIXES];
+static size_t fix_count;
+
+/* Retained points, in order; seq is the index of the fix in fixes[] */
+static struct track_point retained[MAX_FIXES];
+static size_t retained_count;
+
+/* Uptime seen by the simplifier, never goes backwards across tests */
+static int64_t now_ms;
+
+static void collect(const struct track_point *out, int count)
+{
+	for (int i = 0; i < count; i++) {
+		zassert_true(retained_count < ARRAY_SIZE(retained));
+		retained[retained_count++] = out[i];
+	}
+}
+
+static struct track_point point_at(int32_t lat, int32_t lon, uint32_t seq)
+{
+	return (struct track_point){.lat = lat, .lon = lon, .speed = -1, .seq = seq};
+}
+
+/* Start from a retained anchor with nothing pending */
+static void restart(const struct track_point *anchor)
+{
+	struct track_point out[2];
+
+	now_ms += MAX_DELAY_MS;
+	track_simplify_poll(now_ms, out);
+	track_simplify_push(anchor, 10, now_ms, true, out);
+	retained_count = 0;
+}
+
+static void load_fixes(void)
+{
+	struct minmea_sentence_rmc frame;
+	struct geo_fix fix;
+	char line[MINMEA_MAX_SENTENCE_LENGTH + 1];
+	size_t len = 0;
+
+	for (size_t i = 0; i < sizeof(nmea); i++) {
+		if ((nmea[i] != '\n') && (nmea[i] != '\r')) {
+			if (len < (sizeof(line) - 1)) {
+				line[len++] = nmea[i];
+			}
+			continue;
+		}
+
+		line[len] = '\0';
+		len = 0;
+
+		if ((minmea_sentence_id(line, false) != MINMEA_SENTENCE_RMC) ||
+		    !minmea_parse_rmc(&frame, line) || (geo_fix_from_rmc(&fix, &frame) != 0)) {
+			/* Sentences without coordinates are skipped, like in the application */
+			continue;
+		}
+
+		zassert_true(fix_count < ARRAY_SIZE(fixes));
+		fixes[fix_count] = point_at(fix.lat, fix.lon, fix_count);
+		geo_fixes[fix_count] = fix;
+		fix_count++;
+	}
+}
+
+static void *track_simplify_setup(void)
+{
+	load_fixes();
+
+	return NULL;
+}
+
+/*
+ * Replay the drive and return the largest distance of a dropped fix from the
+ * track. With thresholds, fixes go through the report policy first, as in the
+ * application.
+ */
+static float replay(int32_t max_error_m, const struct report_policy_thresholds *thresholds)
+{
+	enum report_policy_result policy = REPORT_POLICY_REPORT;
+	const struct track_point *last;
+	struct track_point out[2];
+	float worst = 0.0f;
+
+	restart(&fixes[0]);
+	retained[retained_count++] = fixes[0];
+	if (thresholds) {
+		report_policy_reset();
+		report_policy_check(&geo_fixes[0], thresholds, now_ms);
+	}
+
+	for (size_t i = 1; i < fix_count; i++) {
+		now_ms += FIX_INTERVAL_MS;
+		if (thresholds) {
+			policy = report_policy_check(&geo_fixes[i], thresholds, now_ms);
+		}
+		if (policy == REPORT_POLICY_SKIP) {
+			collect(out, track_simplify_poll(now_ms, out));
+		} else {
+			collect(out, track_simplify_push(&fixes[i], max_error_m, now_ms,
+							 (policy == REPORT_POLICY_HEARTBEAT), out));
+		}
+	}
+
+	/* The tail is released by the time limit */
+	now_ms += MAX_DELAY_MS;
+	collect(out, track_simplify_poll(now_ms, out));
+
+	last = &retained[retained_count - 1];
+	if (!thresholds) {
+		zassert_equal(last->seq, fix_count - 1, "Last fix not retained");
+	}
+
+	/* Fixes after the last reported one are within the dead-band around it */
+	for (uint32_t i = last->seq + 1; i < fix_count; i++) {
+		worst = MAX(worst, geo_distance_m(last->lat, last->lon, fixes[i].lat,
+						  fixes[i].lon));
+	}
+
+	for (size_t r = 1; r < retained_count; r++) {
+		const struct track_point *a = &retained[r - 1];
+		const struct track_point *b = &retained[r];
+
+		zassert_true(a->seq < b->seq, "Retained fixes out of order");
+
+		for (uint32_t i = a->seq + 1; i < b->seq; i++) {
+			float err = geo_segment_distance_m(a->lat, a->lon, b->lat, b->lon,
+							   fixes[i].lat, fixes[i].lon);
+			worst = MAX(worst, err);
+		}
+	}
+
+	TC_PRINT("max error %d m: %zu of %zu fixes retained, worst error %d.%02d m\n",
+		 max_error_m, retained_count, fix_count, (int)worst,
+		 (int)(worst * 100) % 100);
+
+	return worst;
+}
+
+ZTEST(track_simplify, test_replay_error_bound)
+{
+	static const int32_t max_errors_m[] = {1, 5, 10, 25};
+
+	zassert_true(fix_count > 100, "NMEA recording not loaded");
+
+	for (size_t i = 0; i < ARRAY_SIZE(max_errors_m); i++) {
+		zassert_true(replay(max_errors_m[i], NULL) <= (float)max_errors_m[i],
+			     "Dropped fix further than %d m from the track", max_errors_m[i]);
+	}
+}
+
+ZTEST(track_simplify, test_replay_reported_error_bound)
+{
+	/* The defaults of the REPORT_* settings, then distance only */
+	static const struct report_policy_thresholds thresholds[] = {
+		{.distance_m = 100, .heading_deg = 20, .max_interval_s = 300},
+		{.distance_m = 25},
+	};
+	static const int32_t max_errors_m[] = {1, 10};
+	int32_t bound_m;
+
+	for (size_t t = 0; t < ARRAY_SIZE(thresholds); t++) {
+		for (size_t i = 0; i < ARRAY_SIZE(max_errors_m); i++) {
+			/* Skipped fixes are within the distance of a reported one */
+			bound_m = thresholds[t].distance_m + max_errors_m[i];
+			zassert_true(replay(max_errors_m[i], &thresholds[t]) <= (float)bound_m,
+				     "Fix further than %d m from the track", bound_m);
+		}
+	}
+}
+
+ZTEST(track_simplify, test_replay_compression)
+{
+	replay(10, NULL);
+
+	/* Stops and straight legs make up most of the drive */
+	zassert_true(retained_count * 4 <= fix_count, "Only %zu of %zu fixes dropped",
+		     fix_count - retained_count, fix_count);
+
+	replay(0, NULL);
+	zassert_equal(retained_count, fix_count, "Fixes dropped with simplification disabled");
+}
+
+ZTEST(track_simplify, test_keep_passes_through)
+{
+	struct track_point anchor = point_at(0, 0, 0);
+	struct track_point pending = point_at(0, 100, 1);
+	struct track_point heartbeat = point_at(0, 200, 2);
+	struct track_point out[2];
+
+	restart(&anchor);
+
+	/* On the line from the anchor, held back */
+	now_ms += FIX_INTERVAL_MS;
+	zassert_equal(track_simplify_push(&pending, 10, now_ms, false, out), 0);
+
+	/* Kept points flush the pending point first */
+	now_ms += FIX_INTERVAL_MS;
+	zassert_equal(track_simplify_push(&heartbeat, 10, now_ms, true, out), 2);
+	zassert_equal(out[0].seq, pending.seq);
+	zassert_equal(out[1].seq, heartbeat.seq);
+
+	/* Nothing left behind */
+	now_ms += MAX_DELAY_MS;
+	zassert_equal(track_simplify_poll(now_ms, out), 0);
+}
+
+ZTEST(track_simplify, test_time_limit)
+{
+	struct track_point anchor = point_at(0, 0, 0);
+	struct track_point pending = point_at(0, 100, 1);
+	struct track_point next = point_at(0, 200, 2);
+	struct track_point out[2];
+	int64_t start_ms;
+
+	restart(&anchor);
+
+	now_ms += FIX_INTERVAL_MS;
+	start_ms = now_ms;
+	zassert_equal(track_simplify_push(&pending, 10, now_ms, false, out), 0);
+
+	/* Released once the time limit passes, without any further point */
+	zassert_equal(track_simplify_poll(start_ms + MAX_DELAY_MS - 1, out), 0);
+	zassert_equal(track_simplify_poll(start_ms + MAX_DELAY_MS, out), 1);
+	zassert_equal(out[0].seq, pending.seq);
+
+	/* A point on the same line arriving late releases the one before it */
+	now_ms = start_ms + MAX_DELAY_MS;
+	zassert_equal(track_simplify_push(&next, 10, now_ms, false, out), 0);
+	now_ms += MAX_DELAY_MS;
+	zassert_equal(track_simplify_push(&anchor, 10, now_ms, false, out), 1);
+	zassert_equal(out[0].seq, next.seq);
+}
+
+ZTEST_SUITE(track_simplify, NULL, track_simplify_setup, NULL, NULL, NULL);